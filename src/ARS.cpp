@@ -3,6 +3,12 @@
 #include <cstdlib>
 #include <cstring>
 #include <stdlib.h>
+#include "Messages.h"
+#if _OPENMP
+#include <omp.h>
+#endif
+
+#define ARS_CHECKPOINT_MAGIC 0x41525331 // "ARS1"
 
 void ARS::Initialize(CaliParamConfigSection *caliParamConfigNew,
                      RoutingCaliParamConfigSection *routingCaliParamConfigNew,
@@ -18,34 +24,63 @@ void ARS::Initialize(CaliParamConfigSection *caliParamConfigNew,
   numParamsR = numParamsRNew;
   numParamsS = numParamsSNew;
   numParamsL = numParamsLNew;
-  numParams = numParamsWBNew + numParamsRNew + numParamsSNew + numParamsLNew;
+  // One water balance/routing/snow block per calibration gauge
+  numCaliGauges = simNew->GetNumCaliGauges();
+  numParams = (numParamsWBNew + numParamsRNew + numParamsSNew) * numCaliGauges +
+              numParamsLNew;
   sim = simNew;
 
   // Create storage arrays
   minParams = new float[numParams];
   maxParams = new float[numParams];
-  currentParams = new float[numParams];
-
-  // Stuff from CaliParamConfigSection
-  memcpy(minParams, caliParamConfig->GetParamMins(), sizeof(float) * numParamsWB);
-  memcpy(maxParams, caliParamConfig->GetParamMaxs(), sizeof(float) * numParamsWB);
-  
-  // Copy routing parameters
-  if (numParamsR > 0) {
-    memcpy(&(minParams[numParamsWB]), routingCaliParamConfig->GetParamMins(), sizeof(float) * numParamsR);
-    memcpy(&(maxParams[numParamsWB]), routingCaliParamConfig->GetParamMaxs(), sizeof(float) * numParamsR);
-  }
-  
-  // Copy snow parameters
-  if (numParamsS > 0) {
-    memcpy(&(minParams[numParamsWB + numParamsR]), snowCaliParamConfig->GetParamMins(), sizeof(float) * numParamsS);
-    memcpy(&(maxParams[numParamsWB + numParamsR]), snowCaliParamConfig->GetParamMaxs(), sizeof(float) * numParamsS);
-  }
-  
+
+  // Candidates are drawn and simulated a batch at a time, one per thread
+#if _OPENMP
+  batchSize = omp_get_max_threads();
+#else
+  batchSize = 1;
+#endif
+  batchParams = new float *[batchSize];
+  for (int b = 0; b < batchSize; b++) {
+    batchParams[b] = new float[numParams];
+  }
+  batchScores = new float[batchSize];
+  currentParams = batchParams[0];
+
+  int blockSize = numParamsWB + numParamsR + numParamsS;
+  for (int b = 0; b < numCaliGauges; b++) {
+    float *blockMins = &(minParams[b * blockSize]);
+    float *blockMaxs = &(maxParams[b * blockSize]);
+
+    // Stuff from CaliParamConfigSection
+    memcpy(blockMins, caliParamConfig->GetParamMins(),
+           sizeof(float) * numParamsWB);
+    memcpy(blockMaxs, caliParamConfig->GetParamMaxs(),
+           sizeof(float) * numParamsWB);
+
+    // Copy routing parameters
+    if (numParamsR > 0) {
+      memcpy(&(blockMins[numParamsWB]), routingCaliParamConfig->GetParamMins(),
+             sizeof(float) * numParamsR);
+      memcpy(&(blockMaxs[numParamsWB]), routingCaliParamConfig->GetParamMaxs(),
+             sizeof(float) * numParamsR);
+    }
+
+    // Copy snow parameters
+    if (numParamsS > 0) {
+      memcpy(&(blockMins[numParamsWB + numParamsR]),
+             snowCaliParamConfig->GetParamMins(), sizeof(float) * numParamsS);
+      memcpy(&(blockMaxs[numParamsWB + numParamsR]),
+             snowCaliParamConfig->GetParamMaxs(), sizeof(float) * numParamsS);
+    }
+  }
+
   // Copy lake parameters
   if (numParamsL > 0) {
-    memcpy(&(minParams[numParamsWB + numParamsR + numParamsS]), lakeCaliParamConfig->GetParamMins(), sizeof(float) * numParamsL);
-    memcpy(&(maxParams[numParamsWB + numParamsR + numParamsS]), lakeCaliParamConfig->GetParamMaxs(), sizeof(float) * numParamsL);
+    memcpy(&(minParams[blockSize * numCaliGauges]),
+           lakeCaliParamConfig->GetParamMins(), sizeof(float) * numParamsL);
+    memcpy(&(maxParams[blockSize * numCaliGauges]),
+           lakeCaliParamConfig->GetParamMaxs(), sizeof(float) * numParamsL);
   }
   goal = objectiveGoals[caliParamConfig->GetObjFunc()];
 
@@ -58,11 +93,7 @@ void ARS::Initialize(CaliParamConfigSection *caliParamConfigNew,
   // Initialize vars & RNG
   totalSets = 0;
   goodSets = 0;
-#ifdef WIN32
-  srand(time(NULL));
-#else
-  srand48(time(NULL));
-#endif
+  SeedRNG(time(NULL));
 }
 
 void ARS::CalibrateParams() {
@@ -70,111 +101,263 @@ void ARS::CalibrateParams() {
   float objScore;
   float scoreDiff = 0;
 
+  if (checkpointFile && resumeCheckpoint) {
+    if (ReadCheckpoint(&scoreDiff)) {
+      INFO_LOGF("Resuming ARS from %s with %i total sets, %i good sets",
+                checkpointFile, totalSets, goodSets);
+    } else {
+      WARNING_LOGF("Unable to resume from checkpoint %s, starting over",
+                   checkpointFile);
+    }
+  }
+
   while (goodSets < burnInSets || scoreDiff > convergenceCriteria) {
 
-    // Generate new parameters
-    for (int i = 0; i < numParams; i++) {
+    // Generate a batch of new parameters
+    for (int b = 0; b < batchSize; b++) {
+      for (int i = 0; i < numParams; i++) {
 #ifdef WIN32
-      float randVal = ((float)rand()) / RAND_MAX;
+        float randVal = ((float)rand()) / RAND_MAX;
 #else
-      float randVal = drand48(); //((float)rand()) / RAND_MAX;
+        float randVal = erand48(rngState); //((float)rand()) / RAND_MAX;
 #endif
-      currentParams[i] = minParams[i] + (maxParams[i] - minParams[i]) * randVal;
+        batchParams[b][i] =
+            minParams[i] + (maxParams[i] - minParams[i]) * randVal;
+      }
     }
 
-    objScore = sim->SimulateForCali(currentParams);
-    // printf("%f\n", objScore);
+    sim->SimulateForCaliBatch(batchParams, batchSize, batchScores);
 
-    totalSets++;
+    for (int b = 0; b < batchSize; b++) {
+      currentParams = batchParams[b];
+      objScore = batchScores[b];
+      // printf("%f\n", objScore);
 
-    if (!(totalSets % 500)) {
-      printf("Total sets %i, good sets %i!\n", totalSets, goodSets);
-    }
+      totalSets++;
 
-    if (((goal == OBJECTIVE_GOAL_MAXIMIZE) && objScore < minObjScore) ||
-        ((goal == OBJECTIVE_GOAL_MINIMIZE) && objScore > minObjScore)) {
-      continue;
-    } else {
-      // This is a good parameter set, count it towards the burn in total!
-      goodSets++;
-    }
+      if (!(totalSets % 500)) {
+        printf("Total sets %i, good sets %i!\n", totalSets, goodSets);
+      }
+
+      if (((goal == OBJECTIVE_GOAL_MAXIMIZE) && objScore < minObjScore) ||
+          ((goal == OBJECTIVE_GOAL_MINIMIZE) && objScore > minObjScore)) {
+        continue;
+      } else {
+        // This is a good parameter set, count it towards the burn in total!
+        goodSets++;
+      }
 
-    bool insertedParams = false;
-    for (std::list<ARS_INFO *>::iterator itr = topSets.begin();
-         itr != topSets.end(); itr++) {
-      ARS_INFO *current = *itr;
-      // Add this sucker here, it is a winner!
-      if (((goal == OBJECTIVE_GOAL_MAXIMIZE) && objScore > current->objScore) ||
-          ((goal == OBJECTIVE_GOAL_MINIMIZE) && objScore < current->objScore)) {
+      bool insertedParams = false;
+      for (std::list<ARS_INFO *>::iterator itr = topSets.begin();
+           itr != topSets.end(); itr++) {
+        ARS_INFO *current = *itr;
+        // Add this sucker here, it is a winner!
+        if (((goal == OBJECTIVE_GOAL_MAXIMIZE) && objScore > current->objScore) ||
+            ((goal == OBJECTIVE_GOAL_MINIMIZE) && objScore < current->objScore)) {
+          ARS_INFO *newInfo = new ARS_INFO;
+          newInfo->params = new float[numParams];
+          memcpy(newInfo->params, currentParams, sizeof(float) * numParams);
+          newInfo->objScore = objScore;
+          topSets.insert(itr, newInfo);
+          insertedParams = true;
+          break;
+        }
+      }
+
+      // Lets see if the top number of sets hasn't filled yet, if so add it to the
+      // back
+      if (!insertedParams && topSets.size() < topNum) {
         ARS_INFO *newInfo = new ARS_INFO;
         newInfo->params = new float[numParams];
         memcpy(newInfo->params, currentParams, sizeof(float) * numParams);
         newInfo->objScore = objScore;
-        topSets.insert(itr, newInfo);
+        topSets.push_back(newInfo);
         insertedParams = true;
-        break;
       }
-    }
-
-    // Lets see if the top number of sets hasn't filled yet, if so add it to the
-    // back
-    if (!insertedParams && topSets.size() < topNum) {
-      ARS_INFO *newInfo = new ARS_INFO;
-      newInfo->params = new float[numParams];
-      memcpy(newInfo->params, currentParams, sizeof(float) * numParams);
-      newInfo->objScore = objScore;
-      topSets.push_back(newInfo);
-      insertedParams = true;
-    }
-
-    // Ensure that our list of good parameter sets only contains topNum
-    if (topSets.size() > topNum) {
-      ARS_INFO *current = topSets.back();
-      delete[] current->params;
-      delete current;
-      topSets.pop_back();
-    }
-
-    // Update the min and max values!
-    if (goodSets > burnInSets && insertedParams) {
 
-      for (int i = 0; i < numParams; i++) {
-        minParams[i] = 9999;
-        maxParams[i] = 0;
+      // Ensure that our list of good parameter sets only contains topNum
+      if (topSets.size() > topNum) {
+        ARS_INFO *current = topSets.back();
+        delete[] current->params;
+        delete current;
+        topSets.pop_back();
       }
 
-      for (std::list<ARS_INFO *>::iterator itr = topSets.begin();
-           itr != topSets.end(); itr++) {
-        ARS_INFO *current = *itr;
+      // Update the min and max values!
+      if (goodSets > burnInSets && insertedParams) {
+
         for (int i = 0; i < numParams; i++) {
-          if (current->params[i] < minParams[i]) {
-            minParams[i] = current->params[i];
-          }
-          if (current->params[i] > maxParams[i]) {
-            maxParams[i] = current->params[i];
+          minParams[i] = 9999;
+          maxParams[i] = 0;
+        }
+
+        for (std::list<ARS_INFO *>::iterator itr = topSets.begin();
+             itr != topSets.end(); itr++) {
+          ARS_INFO *current = *itr;
+          for (int i = 0; i < numParams; i++) {
+            if (current->params[i] < minParams[i]) {
+              minParams[i] = current->params[i];
+            }
+            if (current->params[i] > maxParams[i]) {
+              maxParams[i] = current->params[i];
+            }
           }
         }
       }
+
+      ARS_INFO *top = topSets.front();
+      ARS_INFO *bottom = topSets.back();
+      if (insertedParams) {
+        scoreDiff = top->objScore - bottom->objScore;
+        printf("ConvC %f (%f, %f), total runs %i, good runs %i\n",
+               (top->objScore - bottom->objScore), top->objScore,
+               bottom->objScore, totalSets, goodSets);
+      }
     }
 
-    ARS_INFO *top = topSets.front();
-    ARS_INFO *bottom = topSets.back();
-    if (insertedParams) {
-      scoreDiff = top->objScore - bottom->objScore;
-      printf("ConvC %f (%f, %f), total runs %i, good runs %i\n",
-             (top->objScore - bottom->objScore), top->objScore,
-             bottom->objScore, totalSets, goodSets);
+    if (checkpointFile && !WriteCheckpoint(scoreDiff)) {
+      WARNING_LOGF("Failed to write checkpoint %s", checkpointFile);
     }
   }
 }
 
+// The checkpoint holds everything CalibrateParams carries between batches:
+// counters, the current search bounds, the ranked top sets and the RNG.
+bool ARS::WriteCheckpoint(float scoreDiff) {
+  char tmpFile[CONFIG_MAX_LEN * 2];
+  sprintf(tmpFile, "%s.tmp", checkpointFile);
+
+  FILE *file = fopen(tmpFile, "wb");
+  if (!file) {
+    return false;
+  }
+
+  int header[5];
+  header[0] = ARS_CHECKPOINT_MAGIC;
+  header[1] = numParams;
+  header[2] = totalSets;
+  header[3] = goodSets;
+  header[4] = (int)topSets.size();
+  bool ok = (fwrite(header, sizeof(int), 5, file) == 5);
+  ok = ok && (fwrite(&scoreDiff, sizeof(float), 1, file) == 1);
+  ok = ok && (fwrite(minParams, sizeof(float), numParams, file) ==
+              (size_t)numParams);
+  ok = ok && (fwrite(maxParams, sizeof(float), numParams, file) ==
+              (size_t)numParams);
+  for (std::list<ARS_INFO *>::iterator itr = topSets.begin();
+       ok && itr != topSets.end(); itr++) {
+    ARS_INFO *current = *itr;
+    ok = (fwrite(&(current->objScore), sizeof(float), 1, file) == 1) &&
+         (fwrite(current->params, sizeof(float), numParams, file) ==
+          (size_t)numParams);
+  }
+  ok = ok && WriteRNGState(file);
+  fclose(file);
+
+  // Only replace the previous checkpoint once this one is complete
+#ifdef _WIN32
+  // rename does not replace an existing file on Windows
+  if (ok) {
+    remove(checkpointFile);
+  }
+#endif
+  return ok && !rename(tmpFile, checkpointFile);
+}
+
+bool ARS::ReadCheckpoint(float *scoreDiff) {
+  FILE *file = fopen(checkpointFile, "rb");
+  if (!file) {
+    return false;
+  }
+
+  int header[5];
+  if (fread(header, sizeof(int), 5, file) != 5 ||
+      header[0] != ARS_CHECKPOINT_MAGIC || header[1] != numParams) {
+    ERROR_LOGF("Checkpoint %s does not match this calibration",
+               checkpointFile);
+    fclose(file);
+    return false;
+  }
+
+  // Read into scratch storage so a bad file leaves the fresh state intact
+  float readScoreDiff;
+  float *readMins = new float[numParams];
+  float *readMaxs = new float[numParams];
+  std::list<ARS_INFO *> readSets;
+  bool ok = (fread(&readScoreDiff, sizeof(float), 1, file) == 1);
+  ok = ok && (fread(readMins, sizeof(float), numParams, file) ==
+              (size_t)numParams);
+  ok = ok && (fread(readMaxs, sizeof(float), numParams, file) ==
+              (size_t)numParams);
+  for (int i = 0; ok && i < header[4]; i++) {
+    ARS_INFO *newInfo = new ARS_INFO;
+    newInfo->params = new float[numParams];
+    ok = (fread(&(newInfo->objScore), sizeof(float), 1, file) == 1) &&
+         (fread(newInfo->params, sizeof(float), numParams, file) ==
+          (size_t)numParams);
+    readSets.push_back(newInfo);
+  }
+  ok = ok && ReadRNGState(file);
+  fclose(file);
+
+  if (ok) {
+    *scoreDiff = readScoreDiff;
+    memcpy(minParams, readMins, sizeof(float) * numParams);
+    memcpy(maxParams, readMaxs, sizeof(float) * numParams);
+    topSets.swap(readSets);
+  } else {
+    ERROR_LOGF("Checkpoint %s is truncated", checkpointFile);
+  }
+
+  for (std::list<ARS_INFO *>::iterator itr = readSets.begin();
+       itr != readSets.end(); itr++) {
+    delete[] (*itr)->params;
+    delete *itr;
+  }
+  delete[] readMins;
+  delete[] readMaxs;
+
+  if (!ok) {
+    return false;
+  }
+
+  totalSets = header[2];
+  goodSets = header[3];
+  return true;
+}
+
+// Column name for a parameter index; with several calibration gauges the
+// per-gauge blocks are prefixed by the gauge name.
+void ARS::ParamName(int index, MODELS model, ROUTES route, char *buffer) {
+  int blockSize = numParamsWB + numParamsR + numParamsS;
+  int block = index / blockSize, offset = index % blockSize;
+  const char *name;
+  if (block >= numCaliGauges) {
+    name = lakeParamStrings[0][index - blockSize * numCaliGauges];
+    block = -1;
+  } else if (offset < numParamsWB) {
+    name = modelParamStrings[model][offset];
+  } else if (offset < numParamsWB + numParamsR) {
+    name = routeParamStrings[route][offset - numParamsWB];
+  } else {
+    name = snowParamStrings[0][offset - numParamsWB - numParamsR];
+  }
+  if (numCaliGauges > 1 && block >= 0) {
+    sprintf(buffer, "%s:%s",
+            caliParamConfig->GetCaliGauges()->at(block)->GetName(), name);
+  } else {
+    strcpy(buffer, name);
+  }
+}
+
 void ARS::WriteOutput(char *outputFile, MODELS model, ROUTES route) {
   FILE *file = fopen(outputFile, "w");
+  char name[CONFIG_MAX_LEN * 2];
 
   fprintf(file, "%s", "Rank,ObjFunc,");
   for (int i = 0; i < numParams; i++) {
-    fprintf(file, "%s%s", modelParamStrings[model][i],
-            (i != (numParams - 1)) ? "," : "\n");
+    ParamName(i, model, route, name);
+    fprintf(file, "%s%s", name, (i != (numParams - 1)) ? "," : "\n");
   }
 
   int index = 0;
@@ -196,7 +379,8 @@ void ARS::WriteOutput(char *outputFile, MODELS model, ROUTES route) {
 
   ARS_INFO *current = *(topSets.begin());
   for (int i = 0; i < numParams; i++) {
-    fprintf(file, "%s=%f\n", modelParamStrings[model][i], current->params[i]);
+    ParamName(i, model, route, name);
+    fprintf(file, "%s=%f\n", name, current->params[i]);
   }
 
   fclose(file);
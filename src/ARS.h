@@ -24,9 +24,16 @@ public:
   void WriteOutput(char *outputFile, MODELS model, ROUTES route);
 
 private:
+  bool WriteCheckpoint(float scoreDiff);
+  bool ReadCheckpoint(float *scoreDiff);
+  void ParamName(int index, MODELS model, ROUTES route, char *buffer);
+
   float *minParams;
   float *maxParams;
   float *currentParams;
+  float **batchParams;
+  float *batchScores;
+  int batchSize;
   OBJECTIVE_GOAL goal;
   std::list<ARS_INFO *> topSets;
   int numParams;
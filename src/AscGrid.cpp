@@ -66,8 +66,14 @@ LongGrid *ReadLongAscGrid(char *file) {
 }
 
 FloatGrid *ReadFloatAscGrid(char *file) {
+  return ReadFloatAscGrid(file, NULL);
+}
+
+FloatGrid *ReadFloatAscGrid(char *file, GridPool *pool) {
 
   FloatGrid *grid = NULL;
+  Grid header;
+  float noData;
 
   FILE *fileH;
 
@@ -80,64 +86,50 @@ FloatGrid *ReadFloatAscGrid(char *file) {
   // posix_fadvise(fileno(fileH), 0, 0, POSIX_FADV_WILLNEED);
   // posix_fadvise(fileno(fileH), 0, 0, POSIX_FADV_NOREUSE);
 
-  grid = new FloatGrid();
-
-  if (fscanf(fileH, "%*s %ld", &grid->numCols) != 1) {
+  if (fscanf(fileH, "%*s %ld", &header.numCols) != 1) {
     WARNING_LOGF("ASCII file %s missing number of columns", file);
-    delete grid;
     fclose(fileH);
     return NULL;
   }
-  if (fscanf(fileH, "%*s %ld", &grid->numRows) != 1) {
+  if (fscanf(fileH, "%*s %ld", &header.numRows) != 1) {
     WARNING_LOGF("ASCII file %s missing number of rows", file);
-    delete grid;
     fclose(fileH);
     return NULL;
   }
-  if (fscanf(fileH, "%*s %lf", &grid->extent.left) != 1) {
+  if (fscanf(fileH, "%*s %lf", &header.extent.left) != 1) {
     WARNING_LOGF("ASCII file %s missing lower left x", file);
-    delete grid;
     fclose(fileH);
     return NULL;
   }
-  if (fscanf(fileH, "%*s %lf", &grid->extent.bottom) != 1) {
+  if (fscanf(fileH, "%*s %lf", &header.extent.bottom) != 1) {
     WARNING_LOGF("ASCII file %s missing lower left y", file);
-    delete grid;
     fclose(fileH);
     return NULL;
   }
-  if (fscanf(fileH, "%*s %lf", &grid->cellSize) != 1) {
+  if (fscanf(fileH, "%*s %lf", &header.cellSize) != 1) {
     WARNING_LOGF("ASCII file %s missing cell size", file);
-    delete grid;
     fclose(fileH);
     return NULL;
   }
-  if (fscanf(fileH, "%*s %f", &grid->noData) != 1) {
+  if (fscanf(fileH, "%*s %f", &noData) != 1) {
     WARNING_LOGF("ASCII file %s missing no data value", file);
-    delete grid;
     fclose(fileH);
     return NULL;
   }
 
-  grid->data = new float *[grid->numRows]();
-  if (!grid->data) {
-    WARNING_LOGF("ASCII file %s too large (out of memory) with %li rows", file,
-                 grid->numRows);
-    delete grid;
+  grid = NewFloatGrid(pool, header.numCols, header.numRows);
+  if (!grid) {
+    WARNING_LOGF("ASCII file %s too large (out of memory) with %li rows and "
+                 "%li columns",
+                 file, header.numRows, header.numCols);
     fclose(fileH);
     return NULL;
   }
-
-  for (long i = 0; i < grid->numRows; i++) {
-    grid->data[i] = new float[grid->numCols];
-    if (!grid->data[i]) {
-      WARNING_LOGF("ASCII file %s too large (out of memory) with %li columns",
-                   file, grid->numCols);
-      delete grid;
-      fclose(fileH);
-      return NULL;
-    }
-  }
+  grid->extent.left = header.extent.left;
+  grid->extent.bottom = header.extent.bottom;
+  grid->cellSize = header.cellSize;
+  grid->noData = noData;
+  grid->geoSet = false;
 
   for (long row = 0; row < grid->numRows; row++) {
     for (long col = 0; col < grid->numCols; col++) {
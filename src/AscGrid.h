@@ -2,9 +2,11 @@
 #define ASC_GRID_H
 
 #include "Grid.h"
+#include "GridPool.h"
 
 LongGrid *ReadLongAscGrid(char *file);
 FloatGrid *ReadFloatAscGrid(char *file);
+FloatGrid *ReadFloatAscGrid(char *file, GridPool *pool);
 void WriteLongAscGrid(const char *file, LongGrid *grid);
 void WriteFloatAscGrid(const char *file, FloatGrid *grid);
 
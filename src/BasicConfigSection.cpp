@@ -14,6 +14,7 @@ BasicConfigSection::BasicConfigSection() {
   selfFAMSet = false;
   artist[0] = 0;
   copyright[0] = 0;
+  topoCache[0] = 0;
 }
 
 BasicConfigSection::~BasicConfigSection() {}
@@ -28,6 +29,8 @@ char *BasicConfigSection::GetArtist() { return artist; }
 
 char *BasicConfigSection::GetCopyright() { return copyright; }
 
+char *BasicConfigSection::GetTopoCache() { return topoCache; }
+
 PROJECTIONS BasicConfigSection::GetProjection() { return projection; }
 
 CONFIG_SEC_RET BasicConfigSection::ProcessKeyValue(char *name, char *value) {
@@ -91,6 +94,8 @@ CONFIG_SEC_RET BasicConfigSection::ProcessKeyValue(char *name, char *value) {
       INFO_LOGF("Valid Self FAM options are \"%s\"", "TRUE, FALSE");
       return INVALID_RESULT;
     }
+  } else if (!strcasecmp(name, "topocache")) {
+    strcpy(topoCache, value);
   } else {
     ERROR_LOGF("Unknown name-key pair \"%s\"", name);
     return INVALID_RESULT;
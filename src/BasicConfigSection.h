@@ -16,6 +16,7 @@ public:
   char *GetFAM();
   char *GetArtist();
   char *GetCopyright();
+  char *GetTopoCache();
   PROJECTIONS GetProjection();
   bool IsESRIDDM() { return esriDDM; }
   bool IsSelfFAM() { return selfFAM; }
@@ -30,6 +31,7 @@ private:
   char FAM[CONFIG_MAX_LEN];
   char artist[CONFIG_MAX_LEN];
   char copyright[CONFIG_MAX_LEN];
+  char topoCache[CONFIG_MAX_LEN];
   PROJECTIONS projection;
 };
 
@@ -2,8 +2,10 @@
 #include "AscGrid.h"
 #include "BasicConfigSection.h"
 #include "BifGrid.h"
+#include "CacheHash.h"
 #include "Defines.h"
 #include "Messages.h"
+#include "NodeIndex.h"
 #include "TifGrid.h"
 #include "LakeModel.h"
 #include <algorithm>
@@ -15,9 +17,12 @@
 #include <map>
 #include <stack>
 #include <stdlib.h>
+#if _OPENMP
+#include <omp.h>
+#endif
 
 FloatGrid *g_DEM;
-FloatGrid *g_DDM;
+ByteGrid *g_DDM;
 FloatGrid *g_FAM;
 Projection *g_Projection;
 
@@ -61,50 +66,58 @@ FLOW_DIR reverseDir[] = {FLOW_WEST,      FLOW_SOUTHWEST, FLOW_SOUTH,
                          FLOW_SOUTHEAST, FLOW_EAST,      FLOW_NORTHEAST,
                          FLOW_NORTH,     FLOW_NORTHWEST, FLOW_QTY};
 
+static FloatGrid *ReadBasicGrid(char *file) {
+  const char *ext = strrchr(file, '.');
+  if (ext && !strcasecmp(ext, ".asc")) {
+    return ReadFloatAscGrid(file);
+  } else if (ext && !strcasecmp(ext, ".bif")) {
+    return ReadFloatBifGrid(file);
+  } else {
+    return ReadFloatTifGrid(file);
+  }
+}
+
 // This function loads the basic grids and also initializes the projection!
 bool LoadBasicGrids() {
 
-  INFO_LOGF("Loading DEM: %s", g_basicConfig->GetDEM());
-  char *ext = strrchr(g_basicConfig->GetDEM(), '.');
-  if (!strcasecmp(ext, ".asc")) {
-    g_DEM = ReadFloatAscGrid(g_basicConfig->GetDEM());
-  } else if (!strcasecmp(ext, ".bif")) {
-    g_DEM = ReadFloatBifGrid(g_basicConfig->GetDEM());
-  } else {
-    g_DEM = ReadFloatTifGrid(g_basicConfig->GetDEM());
+  // The three grids are independent files, so they are read concurrently
+  const char *names[3] = {"DEM", "DDM", "FAM"};
+  char *files[3] = {g_basicConfig->GetDEM(), g_basicConfig->GetDDM(),
+                    g_basicConfig->GetFAM()};
+  FloatGrid *grids[3];
+  FloatGrid *ddm;
+  for (int i = 0; i < 3; i++) {
+    INFO_LOGF("Loading %s: %s", names[i], files[i]);
   }
+#pragma omp parallel for schedule(dynamic, 1)
+  for (int i = 0; i < 3; i++) {
+#if _OPENMP
+    double loadStart = omp_get_wtime();
+#endif
+    grids[i] = ReadBasicGrid(files[i]);
+#if _OPENMP
+    if (grids[i]) {
+      INFO_LOGF("Loaded %s in %.2fs", names[i], omp_get_wtime() - loadStart);
+    }
+#endif
+  }
+  g_DEM = grids[0];
+  ddm = grids[1];
+  g_FAM = grids[2];
+
   if (!g_DEM) {
     ERROR_LOG("Failed to load DEM!");
     return false;
   }
-
-  INFO_LOGF("Loading DDM: %s", g_basicConfig->GetDDM());
-  ext = strrchr(g_basicConfig->GetDDM(), '.');
-  if (!strcasecmp(ext, ".asc")) {
-    g_DDM = ReadFloatAscGrid(g_basicConfig->GetDDM());
-  } else if (!strcasecmp(ext, ".bif")) {
-    g_DDM = ReadFloatBifGrid(g_basicConfig->GetDDM());
-  } else {
-    g_DDM = ReadFloatTifGrid(g_basicConfig->GetDDM());
-  }
-  if (!g_DDM) {
+  if (!ddm) {
     ERROR_LOG("Failed to load DDM!");
     return false;
   }
-  if (!g_DEM->IsSpatialMatch(g_DDM)) {
+  if (!g_DEM->IsSpatialMatch(ddm)) {
     ERROR_LOG("The spatial characteristics of the DEM and DDM differ!");
     return false;
   }
 
-  INFO_LOGF("Loading FAM: %s", g_basicConfig->GetFAM());
-  ext = strrchr(g_basicConfig->GetFAM(), '.');
-  if (!strcasecmp(ext, ".asc")) {
-    g_FAM = ReadFloatAscGrid(g_basicConfig->GetFAM());
-  } else if (!strcasecmp(ext, ".bif")) {
-    g_FAM = ReadFloatBifGrid(g_basicConfig->GetFAM());
-  } else {
-    g_FAM = ReadFloatTifGrid(g_basicConfig->GetFAM());
-  }
   if (!g_FAM) {
     ERROR_LOG("Failed to load FAM!");
     return false;
@@ -115,49 +128,44 @@ bool LoadBasicGrids() {
   }
 
   if (g_basicConfig->IsESRIDDM()) {
-    if (CheckESRIDDM()) {
-      ReclassifyDDM();
+    if (CheckESRIDDM(ddm)) {
+      ReclassifyDDM(ddm);
     } else {
       ERROR_LOG("Was expecting an ESRI Drainage Direction Map and got invalid "
                 "values!");
+      delete ddm;
       return false;
     }
   } else {
-    if (!CheckSimpleDDM()) {
+    if (!CheckSimpleDDM(ddm)) {
       ERROR_LOG("Was expecting a simple Drainage Direction Map and got invalid "
                 "values!");
+      delete ddm;
       return false;
     }
   }
 
+  g_DDM = PackDDM(ddm);
+  delete ddm;
+  if (!g_DDM) {
+    ERROR_LOG("Not enough memory for the DDM!");
+    return false;
+  }
+
   FixFAM();
 
   return true;
 }
 
 void FreeBasicGridsData() {
-  if (g_DEM && g_DEM->data) {
-    for (long i = 0; i < g_DEM->numRows; i++) {
-      delete[] g_DEM->data[i];
-    }
-    delete[] g_DEM->data;
-    g_DEM->data = NULL;
+  if (g_DEM) {
+    g_DEM->FreeData();
   }
-
-  if (g_DDM && g_DDM->data) {
-    for (long i = 0; i < g_DDM->numRows; i++) {
-      delete[] g_DDM->data[i];
-    }
-    delete[] g_DDM->data;
-    g_DDM->data = NULL;
+  if (g_DDM) {
+    g_DDM->FreeData();
   }
-
-  if (g_FAM && g_FAM->data) {
-    for (long i = 0; i < g_FAM->numRows; i++) {
-      delete[] g_FAM->data[i];
-    }
-    delete[] g_FAM->data;
-    g_FAM->data = NULL;
+  if (g_FAM) {
+    g_FAM->FreeData();
   }
 }
 
@@ -636,34 +644,320 @@ void FixFlowDir(BasinConfigSection *basin, std::vector<GridNode> *nodes) {
       }
     }
     if (flowDir != g_DDM->data[node->y][node->x]) {
-      printf("Old dir %f, new dir %i\n", g_DDM->data[node->y][node->x],
+      printf("Old dir %i, new dir %i\n", (int)g_DDM->data[node->y][node->x],
              flowDir);
       g_DDM->data[node->y][node->x] = (float)(flowDir);
     }
   }
 }
 
-void CarveBasin(
-    BasinConfigSection *basin, std::vector<GridNode> *nodes,
-    std::map<GaugeConfigSection *, float *> *inParamSettings,
-    std::map<GaugeConfigSection *, float *> *outParamSettings,
-    GaugeMap *gaugeMap, float *defaultParams,
-    std::map<GaugeConfigSection *, float *> *inRouteParamSettings,
-    std::map<GaugeConfigSection *, float *> *outRouteParamSettings,
-    float *defaultRouteParams,
-    std::map<GaugeConfigSection *, float *> *inSnowParamSettings,
-    std::map<GaugeConfigSection *, float *> *outSnowParamSettings,
-    float *defaultSnowParams,
-    std::map<GaugeConfigSection *, float *> *inInundationParamSettings,
-    std::map<GaugeConfigSection *, float *> *outInundationParamSettings,
-    float *defaultInundationParams,
-    bool skipGaugeRelationships) {
+// The parameter kinds CarveBasin hands out to every gauge it reaches
+enum CARVE_PARAMS {
+  CARVE_WB,
+  CARVE_ROUTE,
+  CARVE_SNOW,
+  CARVE_INUNDATION,
+  CARVE_QTY,
+};
+
+static const char *carveParamNames[] = {"a water balance", "a routing",
+                                        "a snow", "a inundation"};
+
+struct CarveParams {
+  std::map<GaugeConfigSection *, float *> *in[CARVE_QTY];
+  std::map<GaugeConfigSection *, float *> *out[CARVE_QTY];
+  float *defaults[CARVE_QTY];
+};
+
+// Gauges in the order the walk met them, so a cached topology can replay the
+// parameter assignment and the gauge relationships without walking again.
+struct CarveEvent {
+  CarveEvent(int gaugeNew, int prevNew, bool outletNew)
+      : gauge(gaugeNew), prev(prevNew), outlet(outletNew) {}
+  int gauge, prev;
+  bool outlet;
+};
+
+static int GaugeIndex(std::vector<GaugeConfigSection *> *gauges,
+                      GaugeConfigSection *gauge) {
+  for (size_t i = 0; i < gauges->size(); i++) {
+    if (gauges->at(i) == gauge) {
+      return (int)i;
+    }
+  }
+  return -1;
+}
+
+// Independent basins take their own parameter set or the default one
+static bool AssignOutletParams(CarveParams *params,
+                               GaugeConfigSection *gauge) {
+  for (int k = 0; k < CARVE_QTY; k++) {
+    if (!params->in[k]) {
+      continue;
+    }
+    std::map<GaugeConfigSection *, float *>::iterator pitr =
+        params->in[k]->find(gauge);
+    if (pitr == params->in[k]->end() && !params->defaults[k]) {
+      ERROR_LOGF("Independent basin \"%s\" lacks %s parameter set!",
+                 gauge->GetName(), carveParamNames[k]);
+      return false;
+    }
+
+    if (pitr == params->in[k]->end()) {
+      params->out[k]->insert(std::pair<GaugeConfigSection *, float *>(
+          gauge, params->defaults[k]));
+    } else {
+      params->out[k]->insert(
+          std::pair<GaugeConfigSection *, float *>(pitr->first, pitr->second));
+    }
+  }
+  return true;
+}
+
+// Interior gauges without their own parameter set take the one of the gauge
+// downstream of them
+static void InheritParams(CarveParams *params, GaugeConfigSection *gauge,
+                          GaugeConfigSection *prevGauge) {
+  for (int k = 0; k < CARVE_QTY; k++) {
+    if (!params->in[k] || params->out[k]->count(gauge)) {
+      continue;
+    }
+    std::map<GaugeConfigSection *, float *>::iterator pitr =
+        params->in[k]->find(gauge);
+    if (pitr == params->in[k]->end()) {
+      pitr = params->out[k]->find(prevGauge);
+      if (pitr != params->out[k]->end()) {
+        params->out[k]->insert(
+            std::pair<GaugeConfigSection *, float *>(gauge, pitr->second));
+      }
+    } else {
+      params->out[k]->insert(
+          std::pair<GaugeConfigSection *, float *>(pitr->first, pitr->second));
+    }
+  }
+}
+
+// A gauge met while walking an outlet basin, node is local to the walk
+struct CarveHit {
+  CarveHit(size_t nodeNew, GaugeConfigSection *gaugeNew,
+           GaugeConfigSection *prevNew)
+      : node(nodeNew), gauge(gaugeNew), prev(prevNew) {}
+  size_t node;
+  GaugeConfigSection *gauge, *prev;
+};
+
+// One outlet basin walked on its own, its node indices start at zero
+struct OutletWalk {
+  GaugeConfigSection *outlet;
+  std::vector<GridNode> nodes;
+  std::vector<CarveHit> hits;
+  bool valid;
+};
+
+// The cell (x, y) drains into, the inverse of TestUpstream
+static bool GetDownstreamLoc(long x, long y, long *downX, long *downY) {
+  switch ((int)(g_DDM->data[y][x])) {
+  case FLOW_NORTH:
+    y--;
+    break;
+  case FLOW_NORTHEAST:
+    y--;
+    x++;
+    break;
+  case FLOW_EAST:
+    x++;
+    break;
+  case FLOW_SOUTHEAST:
+    y++;
+    x++;
+    break;
+  case FLOW_SOUTH:
+    y++;
+    break;
+  case FLOW_SOUTHWEST:
+    y++;
+    x--;
+    break;
+  case FLOW_WEST:
+    x--;
+    break;
+  case FLOW_NORTHWEST:
+    x--;
+    y--;
+    break;
+  default:
+    return false;
+  }
+
+  if (x >= 0 && y >= 0 && x < g_DDM->numCols && y < g_DDM->numRows) {
+    *downX = x;
+    *downY = y;
+    return true;
+  }
+  return false;
+}
+
+// A gauge is reached by another walk if the first gauge below it lets the
+// walk continue upstream, the rest are outlets. Sorted by descending FAM the
+// gauge below always comes first, if it does not (equal or broken FAM) this
+// returns false and the outlets have to be found one walk at a time.
+static bool
+FindOutlets(std::vector<GaugeConfigSection *> *gauges,
+            std::map<unsigned long, GaugeConfigSection *> *gaugeCMap,
+            std::vector<GaugeConfigSection *> *outlets) {
+  long numGauges = (long)gauges->size();
+  long maxSteps = g_DDM->numCols * g_DDM->numRows;
+  std::vector<GaugeConfigSection *> downGauges(numGauges, NULL);
+
+#if _OPENMP
+#pragma omp parallel for schedule(dynamic, 1)
+#endif
+  for (long i = 0; i < numGauges; i++) {
+    GridLoc *loc = gauges->at(i)->GetGridLoc();
+    long x = loc->x, y = loc->y;
+    for (long step = 0; step < maxSteps && GetDownstreamLoc(x, y, &x, &y);
+         step++) {
+      std::map<unsigned long, GaugeConfigSection *>::iterator itr =
+          gaugeCMap->find(y * g_DEM->numCols + x);
+      if (itr != gaugeCMap->end()) {
+        downGauges[i] = itr->second;
+        break;
+      }
+    }
+  }
+
+  std::map<GaugeConfigSection *, long> order;
+  for (long i = 0; i < numGauges; i++) {
+    order[gauges->at(i)] = i;
+  }
+  for (long i = 0; i < numGauges; i++) {
+    GaugeConfigSection *downGauge = downGauges[i];
+    if (!downGauge || !downGauge->ContinueUpstream()) {
+      outlets->push_back(gauges->at(i));
+    } else if (order[downGauge] >= i) {
+      outlets->clear();
+      return false;
+    }
+  }
+  return true;
+}
+
+// Walks everything upstream of the outlet down to the gauges that stop the
+// walk. Only reads the shared grids and gauges so outlets can be walked
+// concurrently; the gauges met are recorded to be applied afterwards.
+static void
+WalkOutlet(OutletWalk *walk,
+           std::map<unsigned long, GaugeConfigSection *> *gaugeCMap) {
+  GaugeConfigSection *outlet = walk->outlet;
+  GridLoc *loc = outlet->GetGridLoc();
+  walk->valid = g_DEM->data[loc->y][loc->x] != g_DEM->noData &&
+                g_FAM->data[loc->y][loc->x] != g_FAM->noData &&
+                g_FAM->data[loc->y][loc->x] >= 0;
+  if (!walk->valid) {
+    return;
+  }
+
+  // FAM gives the exact size of a basin no gauge cuts short
+  walk->nodes.reserve(g_basicConfig->IsSelfFAM() ? outlet->GetFlowAccum()
+                                                 : outlet->GetFlowAccum() + 1);
+
+  // Setup the initial node for initiating the search for upstream nodes
+  GridNode outletN = GridNode();
+  outletN.index = 0;
+  outletN.x = loc->x;
+  outletN.y = loc->y;
+  g_DEM->GetRefLoc(outletN.x, outletN.y, &outletN.refLoc);
+  outletN.downStreamNode = INVALID_DOWNSTREAM_NODE;
+  long outsideHeight = 0;
+  if (GetDownstreamHeight(outletN.x, outletN.y, &outsideHeight)) {
+    outletN.horLen =
+        g_Projection->GetLen(outletN.refLoc.x, outletN.refLoc.y,
+                             (FLOW_DIR)g_DDM->data[outletN.y][outletN.x]);
+    float DEMDiff = g_DEM->data[outletN.y][outletN.x] - outsideHeight;
+    outletN.slope = ((DEMDiff < 1.0) ? 1.0 : DEMDiff) / outletN.horLen;
+  } else {
+    outletN.horLen =
+        g_Projection->GetLen(outletN.refLoc.x, outletN.refLoc.y,
+                             FLOW_NORTH); // We assume a horizontal length
+                                          // because we know nothing further
+    outletN.slope = 1.0 / outletN.horLen; // We assume a difference in
+                                          // height of 1 meter because we
+                                          // know nothing else
+  }
+  outletN.area = g_Projection->GetArea(outletN.refLoc.x, outletN.refLoc.y);
+  outletN.contribArea = outletN.area;
+  outletN.fac = g_FAM->data[outletN.y][outletN.x];
+  walk->nodes.push_back(outletN);
+
+  std::stack<size_t> walkNodes;
+  walkNodes.push(0);
+  GridLoc nextNode;
+
+  while (!walkNodes.empty()) {
+
+    // Get the next node to check off the stack
+    size_t current = walkNodes.top();
+    walkNodes.pop();
+    GridNode *currentN = &(walk->nodes[current]);
+
+    // Store the previous gauge
+    GaugeConfigSection *prevGauge = currentN->gauge;
+
+    // Is this node actually a gauge?
+    GaugeConfigSection *nodeGauge = FindGauge(gaugeCMap, currentN);
+    bool keepGoing = true;
+    if (nodeGauge) {
+      currentN->gauge = nodeGauge;
+      keepGoing = nodeGauge->ContinueUpstream();
+      walk->hits.push_back(CarveHit(current, nodeGauge, prevGauge));
+    }
+    if (!keepGoing) {
+      continue;
+    }
+
+    // Copied out, adding nodes below may move the vector
+    GridNode downN = *currentN;
+    long currentNDEM = g_DEM->data[downN.y][downN.x];
+
+    // Lets figure out what flows into this node
+    // We compute slope here too!
+    for (int i = 1; i < FLOW_QTY; i++) {
+      if (TestUpstream(&downN, (FLOW_DIR)i, &nextNode)) {
+        GridNode nextN = GridNode();
+        nextN.index = walk->nodes.size();
+        nextN.x = nextNode.x;
+        nextN.y = nextNode.y;
+        nextN.downStreamNode = current;
+        nextN.gauge = downN.gauge;
+        nextN.fac = g_FAM->data[nextN.y][nextN.x];
+
+        // Calculate slope!
+        long nextNDEM = g_DEM->data[nextN.y][nextN.x];
+        float DEMDiff =
+            (float)(nextNDEM - currentNDEM); // Upstream (higher elevation)
+                                             // minus downstream (lower
+                                             // elevation)
+        g_DEM->GetRefLoc(nextN.x, nextN.y, &nextN.refLoc);
+        nextN.horLen =
+            g_Projection->GetLen(nextN.refLoc.x, nextN.refLoc.y, (FLOW_DIR)i);
+        nextN.slope = ((DEMDiff < 1.0) ? 1.0 : DEMDiff) / nextN.horLen;
+        nextN.area = g_Projection->GetArea(nextN.refLoc.x, nextN.refLoc.y);
+        nextN.contribArea = nextN.area;
+        walk->nodes.push_back(nextN);
+        walkNodes.push(nextN.index);
+      }
+    }
+  }
+}
+
+static bool WalkBasin(BasinConfigSection *basin, std::vector<GridNode> *nodes,
+                      GaugeMap *gaugeMap, CarveParams *params,
+                      bool skipGaugeRelationships,
+                      std::vector<CarveEvent> *events) {
 
   std::vector<GaugeConfigSection *> *gauges = basin->GetGauges();
-  std::stack<GridNode *> walkNodes;
   size_t currentNode = 0;
   size_t totalAccum = 0;
-  GridLoc nextNode;
 
   // Figure out where each gauge is at and get the flow accumulation from the
   // grid for it. Also resets the used flag to false
@@ -855,142 +1149,75 @@ void CarveBasin(
   gaugeMap->Initialize(gauges);
 
   // Here we compute which grid cells & gauges are upstream of our independent
-  // gauges
-  for (GaugeConfigSection *currentGauge = (*gauges)[0]; currentGauge != NULL;
-       currentGauge = NextUnusedGauge(gauges)) {
+  // gauges. Outlet basins do not overlap, so they are walked concurrently and
+  // then appended in outlet order with the gauges they met applied in the
+  // order a single walk would have met them.
+  std::vector<GaugeConfigSection *> outlets;
+  bool allOutlets = FindOutlets(gauges, &gaugeCMap, &outlets);
+  if (!allOutlets) {
+    INFO_LOGF("%s", "Gauge order does not follow the flow directions, "
+                    "walking one outlet basin at a time");
+  }
 
-    std::map<GaugeConfigSection *, float *>::iterator pitr =
-        inParamSettings->find(currentGauge);
-    if (pitr == inParamSettings->end() && !defaultParams) {
-      ERROR_LOGF(
-          "Independent basin \"%s\" lacks a water balance parameter set!",
-          currentGauge->GetName());
-      return;
+  while (true) {
+    if (!allOutlets) {
+      outlets.clear();
+      GaugeConfigSection *nextGauge = NextUnusedGauge(gauges);
+      if (!nextGauge) {
+        break;
+      }
+      outlets.push_back(nextGauge);
     }
 
-    if (pitr == inParamSettings->end()) {
-      outParamSettings->insert(std::pair<GaugeConfigSection *, float *>(
-          currentGauge, defaultParams));
-    } else {
-      outParamSettings->insert(
-          std::pair<GaugeConfigSection *, float *>(pitr->first, pitr->second));
+    long numOutlets = (long)outlets.size();
+    std::vector<OutletWalk> walks(numOutlets);
+    for (long i = 0; i < numOutlets; i++) {
+      walks[i].outlet = outlets[i];
     }
-
-    if (inRouteParamSettings) {
-      pitr = inRouteParamSettings->find(currentGauge);
-      if (pitr == inRouteParamSettings->end() && !defaultRouteParams) {
-        ERROR_LOGF("Independent basin \"%s\" lacks a routing parameter set!",
-                   currentGauge->GetName());
-        return;
-      }
-
-      if (pitr == inRouteParamSettings->end()) {
-        outRouteParamSettings->insert(std::pair<GaugeConfigSection *, float *>(
-            currentGauge, defaultRouteParams));
-      } else {
-        outRouteParamSettings->insert(std::pair<GaugeConfigSection *, float *>(
-            pitr->first, pitr->second));
-      }
+#if _OPENMP
+#pragma omp parallel for schedule(dynamic, 1)
+#endif
+    for (long i = 0; i < numOutlets; i++) {
+      WalkOutlet(&(walks[i]), &gaugeCMap);
     }
 
-    if (inSnowParamSettings) {
-      pitr = inSnowParamSettings->find(currentGauge);
-      if (pitr == inSnowParamSettings->end() && !defaultSnowParams) {
-        ERROR_LOGF("Independent basin \"%s\" lacks a snow parameter set!",
-                   currentGauge->GetName());
-        return;
+    for (long i = 0; i < numOutlets; i++) {
+      OutletWalk *walk = &(walks[i]);
+      GaugeConfigSection *currentGauge = walk->outlet;
+      if (!AssignOutletParams(params, currentGauge)) {
+        return false;
       }
+      events->push_back(CarveEvent(GaugeIndex(gauges, currentGauge), -1, true));
 
-      if (pitr == inSnowParamSettings->end()) {
-        outSnowParamSettings->insert(std::pair<GaugeConfigSection *, float *>(
-            currentGauge, defaultSnowParams));
+      if (g_basicConfig->IsSelfFAM()) {
+        totalAccum += currentGauge->GetFlowAccum();
       } else {
-        outSnowParamSettings->insert(std::pair<GaugeConfigSection *, float *>(
-            pitr->first, pitr->second));
+        totalAccum += (currentGauge->GetFlowAccum() + 1);
       }
-    }
-
-    if (inInundationParamSettings) {
-      pitr = inInundationParamSettings->find(currentGauge);
-      if (pitr == inInundationParamSettings->end() &&
-          !defaultInundationParams) {
-        ERROR_LOGF("Independent basin \"%s\" lacks a inundation parameter set!",
+      if (!walk->valid) {
+        ERROR_LOGF("Gauge \"%s\" is located in a no data grid cell!",
                    currentGauge->GetName());
-        return;
+        return false;
       }
 
-      if (pitr == inInundationParamSettings->end()) {
-        outInundationParamSettings->insert(
-            std::pair<GaugeConfigSection *, float *>(currentGauge,
-                                                     defaultInundationParams));
-      } else {
-        outInundationParamSettings->insert(
-            std::pair<GaugeConfigSection *, float *>(pitr->first,
-                                                     pitr->second));
+      size_t offset = currentNode;
+      nodes->resize(offset + walk->nodes.size());
+      for (size_t n = 0; n < walk->nodes.size(); n++) {
+        GridNode *node = &(nodes->at(offset + n));
+        *node = walk->nodes[n];
+        node->index += offset;
+        if (node->downStreamNode != INVALID_DOWNSTREAM_NODE) {
+          node->downStreamNode += offset;
+        }
       }
-    }
+      currentNode += walk->nodes.size();
+      std::vector<GridNode>().swap(walk->nodes);
 
-    if (g_basicConfig->IsSelfFAM()) {
-      totalAccum += currentGauge->GetFlowAccum();
-    } else {
-      totalAccum += (currentGauge->GetFlowAccum() + 1);
-    }
-    nodes->resize(totalAccum);
-    GridNode *currentN = &(*nodes)[currentNode];
-
-    // Setup the initial node for initiating the search for upstream nodes
-    currentN->index = currentNode;
-    currentNode++;
-    currentN->x = currentGauge->GetGridLoc()->x;
-    currentN->y = currentGauge->GetGridLoc()->y;
-    g_DEM->GetRefLoc(currentN->x, currentN->y, &currentN->refLoc);
-    if (g_DEM->data[currentN->y][currentN->x] == g_DEM->noData ||
-        g_FAM->data[currentN->y][currentN->x] == g_FAM->noData ||
-        g_FAM->data[currentN->y][currentN->x] < 0) {
-      ERROR_LOGF("Gauge \"%s\" is located in a no data grid cell!",
-                 currentGauge->GetName());
-      return;
-    }
-    currentN->downStreamNode = INVALID_DOWNSTREAM_NODE;
-    long outsideHeight = 0;
-    if (GetDownstreamHeight(currentN->x, currentN->y, &outsideHeight)) {
-      currentN->horLen =
-          g_Projection->GetLen(currentN->refLoc.x, currentN->refLoc.y,
-                               (FLOW_DIR)g_DDM->data[currentN->y][currentN->x]);
-      float DEMDiff = g_DEM->data[currentN->y][currentN->x] - outsideHeight;
-      currentN->slope = ((DEMDiff < 1.0) ? 1.0 : DEMDiff) / currentN->horLen;
-    } else {
-      currentN->horLen =
-          g_Projection->GetLen(currentN->refLoc.x, currentN->refLoc.y,
-                               FLOW_NORTH); // We assume a horizontal length
-                                            // because we know nothing further
-      currentN->slope = 1.0 / currentN->horLen; // We assume a difference in
-                                                // height of 1 meter because we
-                                                // know nothing else
-    }
-    currentN->area =
-        g_Projection->GetArea(currentN->refLoc.x, currentN->refLoc.y);
-    currentN->contribArea = currentN->area;
-    currentN->fac = g_FAM->data[currentN->y][currentN->x];
-    walkNodes.push(currentN);
-
-    while (!walkNodes.empty()) {
-
-      // Get the next node to check off the stack
-      currentN = walkNodes.top();
-      walkNodes.pop();
-
-      // Store the previous gauge
-      GaugeConfigSection *prevGauge = currentN->gauge;
-
-      // Is this node actually a gauge?
-      GaugeConfigSection *nodeGauge = FindGauge(&gaugeCMap, currentN);
-      bool keepGoing = true;
-      if (nodeGauge) {
-        nodeGauge->SetGridNodeIndex(currentN->index);
-        currentN->gauge = nodeGauge;
+      for (size_t h = 0; h < walk->hits.size(); h++) {
+        GaugeConfigSection *nodeGauge = walk->hits[h].gauge;
+        GaugeConfigSection *prevGauge = walk->hits[h].prev;
+        nodeGauge->SetGridNodeIndex(offset + walk->hits[h].node);
         nodeGauge->SetUsed(true);
-        keepGoing = nodeGauge->ContinueUpstream();
 
         // Add this to the gauge map which allows us to figure out upstream
         // gauges & contributions (skip if loading from state)
@@ -1002,102 +1229,19 @@ void CarveBasin(
         // Since it is not required that inParamSettings contain parameters for
         // every gauge in the basin we will in parameters from downstream gauges
         // upstream
-        pitr = inParamSettings->find(nodeGauge);
-        if (pitr == inParamSettings->end()) {
-          pitr = outParamSettings->find(prevGauge);
-          outParamSettings->insert(std::pair<GaugeConfigSection *, float *>(
-              nodeGauge, pitr->second));
-        } else {
-          outParamSettings->insert(std::pair<GaugeConfigSection *, float *>(
-              pitr->first, pitr->second));
-        }
-        if (inRouteParamSettings) {
-          pitr = inRouteParamSettings->find(nodeGauge);
-          if (pitr == inRouteParamSettings->end()) {
-            pitr = outRouteParamSettings->find(prevGauge);
-            outRouteParamSettings->insert(
-                std::pair<GaugeConfigSection *, float *>(nodeGauge,
-                                                         pitr->second));
-          } else {
-            outRouteParamSettings->insert(
-                std::pair<GaugeConfigSection *, float *>(pitr->first,
-                                                         pitr->second));
-          }
-        }
-
-        if (inSnowParamSettings) {
-          pitr = inSnowParamSettings->find(nodeGauge);
-          if (pitr == inSnowParamSettings->end()) {
-            pitr = outSnowParamSettings->find(prevGauge);
-            outSnowParamSettings->insert(
-                std::pair<GaugeConfigSection *, float *>(nodeGauge,
-                                                         pitr->second));
-          } else {
-            outSnowParamSettings->insert(
-                std::pair<GaugeConfigSection *, float *>(pitr->first,
-                                                         pitr->second));
-          }
-        }
-
-        if (inInundationParamSettings) {
-          pitr = inInundationParamSettings->find(nodeGauge);
-          if (pitr == inInundationParamSettings->end()) {
-            pitr = outInundationParamSettings->find(prevGauge);
-            outInundationParamSettings->insert(
-                std::pair<GaugeConfigSection *, float *>(nodeGauge,
-                                                         pitr->second));
-          } else {
-            outInundationParamSettings->insert(
-                std::pair<GaugeConfigSection *, float *>(pitr->first,
-                                                         pitr->second));
-          }
-        }
+        InheritParams(params, nodeGauge, prevGauge);
+        events->push_back(CarveEvent(GaugeIndex(gauges, nodeGauge),
+                                     GaugeIndex(gauges, prevGauge), false));
       }
 
-      long currentNDEM = g_DEM->data[currentN->y][currentN->x];
-
-      // Lets figure out what flows into this node
-      // We compute slope here too!
-      if (keepGoing) {
-        for (int i = 1; i < FLOW_QTY; i++) {
-          if (TestUpstream(currentN, (FLOW_DIR)i, &nextNode)) {
-            GridNode *nextN = &(*nodes)[currentNode];
-            nextN->index = currentNode;
-            currentNode++;
-            nextN->x = nextNode.x;
-            nextN->y = nextNode.y;
-            nextN->downStreamNode = currentN->index;
-            nextN->gauge = currentN->gauge;
-            nextN->fac = g_FAM->data[nextN->y][nextN->x];
-
-            // Calculate slope!
-            long nextNDEM = g_DEM->data[nextN->y][nextN->x];
-            float DEMDiff =
-                (float)(nextNDEM - currentNDEM); // Upstream (higher elevation)
-                                                 // minus downstream (lower
-                                                 // elevation)
-            g_DEM->GetRefLoc(nextN->x, nextN->y, &nextN->refLoc);
-            nextN->horLen = g_Projection->GetLen(nextN->refLoc.x,
-                                                 nextN->refLoc.y, (FLOW_DIR)i);
-            nextN->slope = ((DEMDiff < 1.0) ? 1.0 : DEMDiff) / nextN->horLen;
-            nextN->area =
-                g_Projection->GetArea(nextN->refLoc.x, nextN->refLoc.y);
-            nextN->contribArea = nextN->area;
-            // printf("Pushing node %i %i (%i, %i) from %i %i (%i, %i) %i %i\n",
-            // nextN->x, nextN->y, g_DDM->data[nextN->y][nextN->x],
-            // g_FAM->data[nextN->y][nextN->x], currentN->x, currentN->y,
-            // g_DDM->data[currentN->y][currentN->x],
-            // g_FAM->data[currentN->y][currentN->x], currentNode,
-            // nodes->size());
-            walkNodes.push(nextN);
-          }
-        }
-      }
+      INFO_LOGF("Walked %lu (out of %lu) nodes for %s!",
+                (unsigned long)currentNode, (unsigned long)totalAccum,
+                currentGauge->GetName());
     }
 
-    INFO_LOGF("Walked %lu (out of %lu) nodes for %s!",
-              (unsigned long)currentNode, (unsigned long)totalAccum,
-              currentGauge->GetName());
+    if (allOutlets) {
+      break;
+    }
   }
 
   nodes->resize(currentNode);
@@ -1121,6 +1265,400 @@ void CarveBasin(
   fclose(fp);
   fclose(fp2);
   */
+  return true;
+}
+
+#define TOPO_CACHE_MAGIC 0x544f5032 // "TOP2", nodes in ReorderNodes order
+
+struct TopoGauge {
+  long x, y, flowAccum, gridNodeIndex;
+  float lat, lon;
+  int used;
+};
+
+struct TopoNode {
+  long x, y, fac, gauge;
+  unsigned long downStreamNode;
+  float refX, refY, slope, area, contribArea, horLen;
+};
+
+// Rows are hashed in parallel and then combined in order
+template <typename GridType>
+static void HashGrid(unsigned long long *hash, GridType *grid) {
+  HashBytes(hash, &(grid->numCols), sizeof(grid->numCols));
+  HashBytes(hash, &(grid->numRows), sizeof(grid->numRows));
+  HashBytes(hash, &(grid->cellSize), sizeof(grid->cellSize));
+  HashBytes(hash, &(grid->extent.left), sizeof(grid->extent.left));
+  HashBytes(hash, &(grid->extent.bottom), sizeof(grid->extent.bottom));
+  HashBytes(hash, &(grid->noData), sizeof(grid->noData));
+  std::vector<unsigned long long> rowHashes(grid->numRows,
+                                            CACHE_HASH_BASIS);
+#pragma omp parallel for schedule(static)
+  for (long row = 0; row < grid->numRows; row++) {
+    HashBytes(&(rowHashes[row]), grid->data[row],
+              sizeof(grid->noData) * grid->numCols);
+  }
+  HashBytes(hash, &(rowHashes[0]),
+            sizeof(unsigned long long) * rowHashes.size());
+}
+
+// The basic grids as loaded (after FixFAM) and the projection
+void HashBasicGrids(unsigned long long *hash) {
+  HashGrid(hash, g_DEM);
+  HashGrid(hash, g_DDM);
+  HashGrid(hash, g_FAM);
+  int projection = (int)g_basicConfig->GetProjection();
+  bool selfFAM = g_basicConfig->IsSelfFAM();
+  HashBytes(hash, &projection, sizeof(projection));
+  HashBytes(hash, &selfFAM, sizeof(selfFAM));
+}
+
+// Everything the walk depends on: the basic grids and each gauge's location
+// settings
+static unsigned long long TopologyKey(BasinConfigSection *basin) {
+  unsigned long long hash = CACHE_HASH_BASIS;
+  HashBasicGrids(&hash);
+
+  std::vector<GaugeConfigSection *> *gauges = basin->GetGauges();
+  for (size_t i = 0; i < gauges->size(); i++) {
+    GaugeConfigSection *gauge = gauges->at(i);
+    float lat = gauge->GetLat(), lon = gauge->GetLon();
+    float obsFlowAccum = gauge->GetObsFlowAccum();
+    bool flags[3] = {gauge->NeedsProjecting(), gauge->HasObsFlowAccum(),
+                     gauge->ContinueUpstream()};
+    HashString(&hash, gauge->GetName());
+    HashBytes(&hash, flags, sizeof(flags));
+    if (flags[0]) {
+      HashBytes(&hash, &lat, sizeof(lat));
+      HashBytes(&hash, &lon, sizeof(lon));
+    } else {
+      HashBytes(&hash, &(gauge->GetGridLoc()->x), sizeof(long));
+      HashBytes(&hash, &(gauge->GetGridLoc()->y), sizeof(long));
+    }
+    if (flags[1]) {
+      HashBytes(&hash, &obsFlowAccum, sizeof(obsFlowAccum));
+    }
+  }
+  return hash;
+}
+
+static bool SaveTopology(const char *file, unsigned long long key,
+                         std::vector<GaugeConfigSection *> *gauges,
+                         std::vector<GridNode> *nodes,
+                         std::vector<CarveEvent> *events) {
+  char tmpFile[CONFIG_MAX_LEN * 2];
+  sprintf(tmpFile, "%s.tmp", file);
+  FILE *fp = fopen(tmpFile, "wb");
+  if (!fp) {
+    WARNING_LOGF("Failed to write topology cache %s", tmpFile);
+    return false;
+  }
+
+  int header[3] = {TOPO_CACHE_MAGIC, (int)gauges->size(), (int)events->size()};
+  unsigned long numNodes = nodes->size();
+  bool ok = (fwrite(header, sizeof(int), 3, fp) == 3 &&
+             fwrite(&key, sizeof(key), 1, fp) == 1 &&
+             fwrite(&numNodes, sizeof(numNodes), 1, fp) == 1);
+
+  for (size_t i = 0; ok && i < gauges->size(); i++) {
+    GaugeConfigSection *gauge = gauges->at(i);
+    TopoGauge rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.x = gauge->GetGridLoc()->x;
+    rec.y = gauge->GetGridLoc()->y;
+    rec.flowAccum = gauge->GetFlowAccum();
+    rec.gridNodeIndex = gauge->GetGridNodeIndex();
+    rec.lat = gauge->GetLat();
+    rec.lon = gauge->GetLon();
+    rec.used = gauge->GetUsed();
+    int nameLen = (int)strlen(gauge->GetName());
+    ok = (fwrite(&nameLen, sizeof(int), 1, fp) == 1 &&
+          fwrite(gauge->GetName(), 1, nameLen, fp) == (size_t)nameLen &&
+          fwrite(&rec, sizeof(rec), 1, fp) == 1);
+  }
+
+  for (size_t i = 0; ok && i < events->size(); i++) {
+    int rec[3] = {events->at(i).gauge, events->at(i).prev,
+                  events->at(i).outlet};
+    ok = (fwrite(rec, sizeof(int), 3, fp) == 3);
+  }
+
+  std::map<GaugeConfigSection *, long> gaugeIndices;
+  for (size_t i = 0; i < gauges->size(); i++) {
+    gaugeIndices[gauges->at(i)] = (long)i;
+  }
+  std::vector<TopoNode> recs(numNodes);
+  for (unsigned long i = 0; i < numNodes; i++) {
+    GridNode *node = &(nodes->at(i));
+    TopoNode *rec = &(recs[i]);
+    memset(rec, 0, sizeof(TopoNode));
+    rec->x = node->x;
+    rec->y = node->y;
+    rec->fac = node->fac;
+    std::map<GaugeConfigSection *, long>::iterator gitr =
+        gaugeIndices.find(node->gauge);
+    rec->gauge = (gitr != gaugeIndices.end()) ? gitr->second : -1;
+    rec->downStreamNode = node->downStreamNode;
+    rec->refX = node->refLoc.x;
+    rec->refY = node->refLoc.y;
+    rec->slope = node->slope;
+    rec->area = node->area;
+    rec->contribArea = node->contribArea;
+    rec->horLen = node->horLen;
+  }
+  if (ok && numNodes > 0) {
+    ok = (fwrite(&(recs[0]), sizeof(TopoNode), numNodes, fp) == numNodes);
+  }
+
+  if (fclose(fp) != 0 || !ok) {
+    WARNING_LOGF("Failed to write topology cache %s", tmpFile);
+    remove(tmpFile);
+    return false;
+  }
+  // Only replace a previous cache once this one is complete
+#ifdef _WIN32
+  // rename does not replace an existing file on Windows
+  remove(file);
+#endif
+  if (rename(tmpFile, file) != 0) {
+    WARNING_LOGF("Failed to move topology cache into place at %s", file);
+    remove(tmpFile);
+    return false;
+  }
+  INFO_LOGF("Saved basin topology (%lu nodes) to %s", numNodes, file);
+  return true;
+}
+
+// Restores what WalkBasin would have produced. Returns false, leaving every
+// output untouched, if the file is missing, stale or unreadable.
+static bool LoadTopology(const char *file, unsigned long long key,
+                         BasinConfigSection *basin,
+                         std::vector<GridNode> *nodes, GaugeMap *gaugeMap,
+                         CarveParams *params, bool skipGaugeRelationships) {
+  FILE *fp = fopen(file, "rb");
+  if (!fp) {
+    return false;
+  }
+
+  int header[3];
+  unsigned long long fileKey;
+  unsigned long numNodes;
+  if (fread(header, sizeof(int), 3, fp) != 3 || header[0] != TOPO_CACHE_MAGIC ||
+      fread(&fileKey, sizeof(fileKey), 1, fp) != 1 || fileKey != key ||
+      fread(&numNodes, sizeof(numNodes), 1, fp) != 1) {
+    fclose(fp);
+    return false;
+  }
+
+  std::vector<GaugeConfigSection *> *basinGauges = basin->GetGauges();
+  std::vector<GaugeConfigSection *> gauges(header[1]);
+  std::vector<TopoGauge> gaugeRecs(header[1]);
+  bool ok = true;
+  for (int i = 0; ok && i < header[1]; i++) {
+    int nameLen;
+    char name[CONFIG_MAX_LEN];
+    ok = (fread(&nameLen, sizeof(int), 1, fp) == 1 && nameLen >= 0 &&
+          nameLen < CONFIG_MAX_LEN &&
+          fread(name, 1, nameLen, fp) == (size_t)nameLen &&
+          fread(&(gaugeRecs[i]), sizeof(TopoGauge), 1, fp) == 1);
+    if (ok) {
+      name[nameLen] = 0;
+      gauges[i] = NULL;
+      for (size_t j = 0; j < basinGauges->size(); j++) {
+        if (!strcasecmp(basinGauges->at(j)->GetName(), name)) {
+          gauges[i] = basinGauges->at(j);
+          break;
+        }
+      }
+      ok = (gauges[i] != NULL);
+    }
+  }
+
+  std::vector<CarveEvent> events;
+  for (int i = 0; ok && i < header[2]; i++) {
+    int rec[3];
+    ok = (fread(rec, sizeof(int), 3, fp) == 3 && rec[0] >= 0 &&
+          rec[0] < header[1] && rec[1] < header[1]);
+    if (ok) {
+      events.push_back(CarveEvent(rec[0], rec[1], rec[2] != 0));
+    }
+  }
+
+  std::vector<TopoNode> recs(numNodes);
+  if (ok && numNodes > 0) {
+    ok = (fread(&(recs[0]), sizeof(TopoNode), numNodes, fp) == numNodes);
+  }
+  fclose(fp);
+  if (!ok) {
+    WARNING_LOGF("Ignoring unreadable topology cache %s", file);
+    return false;
+  }
+
+  // Same gauge order and state as after the walk
+  *basinGauges = gauges;
+  for (int i = 0; i < header[1]; i++) {
+    GaugeConfigSection *gauge = gauges[i];
+    TopoGauge *rec = &(gaugeRecs[i]);
+    gauge->GetGridLoc()->x = rec->x;
+    gauge->GetGridLoc()->y = rec->y;
+    gauge->SetLat(rec->lat);
+    gauge->SetLon(rec->lon);
+    gauge->SetFlowAccum(rec->flowAccum);
+    gauge->SetGridNodeIndex(rec->gridNodeIndex);
+    gauge->SetUsed(rec->used != 0);
+  }
+
+  gaugeMap->Initialize(basinGauges);
+  for (size_t i = 0; i < events.size(); i++) {
+    GaugeConfigSection *gauge = gauges[events[i].gauge];
+    GaugeConfigSection *prevGauge =
+        (events[i].prev >= 0) ? gauges[events[i].prev] : NULL;
+    if (events[i].outlet) {
+      if (!AssignOutletParams(params, gauge)) {
+        return true;
+      }
+      continue;
+    }
+    if (!skipGaugeRelationships) {
+      gaugeMap->AddUpstreamGauge(prevGauge, gauge);
+    }
+    InheritParams(params, gauge, prevGauge);
+  }
+
+  nodes->assign(numNodes, GridNode());
+  for (unsigned long i = 0; i < numNodes; i++) {
+    GridNode *node = &(nodes->at(i));
+    TopoNode *rec = &(recs[i]);
+    node->index = i;
+    node->x = rec->x;
+    node->y = rec->y;
+    node->fac = rec->fac;
+    node->gauge = (rec->gauge >= 0) ? gauges[rec->gauge] : NULL;
+    node->downStreamNode = rec->downStreamNode;
+    node->refLoc.x = rec->refX;
+    node->refLoc.y = rec->refY;
+    node->slope = rec->slope;
+    node->area = rec->area;
+    node->contribArea = rec->contribArea;
+    node->horLen = rec->horLen;
+  }
+
+  INFO_LOGF("Loaded basin topology (%lu nodes) from %s", numNodes, file);
+  return true;
+}
+
+// With TOPOCACHE set in [Basic] the carved network is stored per basin and
+// reused while the grids, projection and gauges stay the same.
+// The walk numbers a node's upstream neighbors when the node comes off the
+// stack, so a node can end up far from its downstream node and routing's
+// scatter into it misses cache. This renumbers the nodes in pre-order: each
+// sub-basin is one contiguous run that starts at its outlet, so downstream
+// indices stay below upstream ones. Outlets and siblings keep their relative
+// order, so every node still receives its upstream contributions in the same
+// sequence and the results do not change.
+static void ReorderNodes(std::vector<GridNode> *nodes,
+                         std::vector<GaugeConfigSection *> *gauges) {
+  size_t numNodes = nodes->size();
+  if (numNodes == 0) {
+    return;
+  }
+
+  std::vector<unsigned long> firstUp, upNodes, roots;
+  NodeIndex::BuildUpstream(nodes, &firstUp, &upNodes);
+  for (size_t i = 0; i < numNodes; i++) {
+    if (nodes->at(i).downStreamNode == INVALID_DOWNSTREAM_NODE) {
+      roots.push_back(i);
+    }
+  }
+
+  std::vector<unsigned long> newIndex(numNodes), order;
+  order.reserve(numNodes);
+  std::stack<unsigned long> walk;
+  for (size_t r = 0; r < roots.size(); r++) {
+    walk.push(roots[r]);
+    while (!walk.empty()) {
+      unsigned long current = walk.top();
+      walk.pop();
+      newIndex[current] = order.size();
+      order.push_back(current);
+      for (unsigned long u = firstUp[current + 1]; u > firstUp[current]; u--) {
+        walk.push(upNodes[u - 1]);
+      }
+    }
+  }
+
+  std::vector<GridNode> reordered(numNodes);
+  for (size_t i = 0; i < numNodes; i++) {
+    GridNode *node = &(reordered[i]);
+    *node = nodes->at(order[i]);
+    node->index = i;
+    if (node->downStreamNode != INVALID_DOWNSTREAM_NODE) {
+      node->downStreamNode = newIndex[node->downStreamNode];
+    }
+  }
+  nodes->swap(reordered);
+
+  for (size_t i = 0; i < gauges->size(); i++) {
+    GaugeConfigSection *gauge = gauges->at(i);
+    long index = gauge->GetGridNodeIndex();
+    if (gauge->GetUsed() && index >= 0 && (size_t)index < numNodes) {
+      gauge->SetGridNodeIndex(newIndex[index]);
+    }
+  }
+}
+
+void CarveBasin(
+    BasinConfigSection *basin, std::vector<GridNode> *nodes,
+    std::map<GaugeConfigSection *, float *> *inParamSettings,
+    std::map<GaugeConfigSection *, float *> *outParamSettings,
+    GaugeMap *gaugeMap, float *defaultParams,
+    std::map<GaugeConfigSection *, float *> *inRouteParamSettings,
+    std::map<GaugeConfigSection *, float *> *outRouteParamSettings,
+    float *defaultRouteParams,
+    std::map<GaugeConfigSection *, float *> *inSnowParamSettings,
+    std::map<GaugeConfigSection *, float *> *outSnowParamSettings,
+    float *defaultSnowParams,
+    std::map<GaugeConfigSection *, float *> *inInundationParamSettings,
+    std::map<GaugeConfigSection *, float *> *outInundationParamSettings,
+    float *defaultInundationParams,
+    bool skipGaugeRelationships) {
+
+  CarveParams params;
+  params.in[CARVE_WB] = inParamSettings;
+  params.out[CARVE_WB] = outParamSettings;
+  params.defaults[CARVE_WB] = defaultParams;
+  params.in[CARVE_ROUTE] = inRouteParamSettings;
+  params.out[CARVE_ROUTE] = outRouteParamSettings;
+  params.defaults[CARVE_ROUTE] = defaultRouteParams;
+  params.in[CARVE_SNOW] = inSnowParamSettings;
+  params.out[CARVE_SNOW] = outSnowParamSettings;
+  params.defaults[CARVE_SNOW] = defaultSnowParams;
+  params.in[CARVE_INUNDATION] = inInundationParamSettings;
+  params.out[CARVE_INUNDATION] = outInundationParamSettings;
+  params.defaults[CARVE_INUNDATION] = defaultInundationParams;
+
+  char *cacheDir = g_basicConfig->GetTopoCache();
+  char cacheFile[CONFIG_MAX_LEN * 2];
+  unsigned long long key = 0;
+  if (cacheDir[0]) {
+    key = TopologyKey(basin);
+    sprintf(cacheFile, "%s/topology.%016llx.bin", cacheDir, key);
+    if (LoadTopology(cacheFile, key, basin, nodes, gaugeMap, &params,
+                     skipGaugeRelationships)) {
+      return;
+    }
+  }
+
+  std::vector<CarveEvent> events;
+  if (!WalkBasin(basin, nodes, gaugeMap, &params, skipGaugeRelationships,
+                 &events)) {
+    return;
+  }
+  ReorderNodes(nodes, basin->GetGauges());
+
+  if (cacheDir[0]) {
+    SaveTopology(cacheFile, key, basin->GetGauges(), nodes, &events);
+  }
 }
 
 void CarveLakeParameters(BasinConfigSection *basin, std::vector<GridNode> *nodes) {
@@ -1369,15 +1907,19 @@ bool SortByFlowAccumFS(FAMSearch *fs1, FAMSearch *fs2) {
   return fs1->fa > fs2->fa;
 }
 
-bool CheckESRIDDM() {
-  for (long row = 0; row < g_DDM->numRows; row++) {
-    for (long col = 0; col < g_DDM->numCols; col++) {
-      if (g_DDM->data[row][col] == g_DDM->noData) {
+// The whole-grid passes below work row by row in parallel. The checks scan
+// every row and report the first bad cell in raster order.
+bool CheckESRIDDM(FloatGrid *ddm) {
+  long badRow = ddm->numRows, badCol = 0;
+#pragma omp parallel for schedule(static)
+  for (long row = 0; row < ddm->numRows; row++) {
+    for (long col = 0; col < ddm->numCols; col++) {
+      if (ddm->data[row][col] == ddm->noData) {
         continue;
       }
-      switch ((int)(g_DDM->data[row][col])) {
+      switch ((int)(ddm->data[row][col])) {
       case 0:
-        g_DDM->data[row][col] = g_DDM->noData;
+        ddm->data[row][col] = ddm->noData;
       case 1:
       case 2:
       case 4:
@@ -1388,24 +1930,38 @@ bool CheckESRIDDM() {
       case 128:
         continue;
       default:
-        ERROR_LOGF("Bad DDM value %i at (%li, %li) %f",
-                   (int)(g_DDM->data[row][col]), col, row, g_DDM->noData);
-        return false;
+#pragma omp critical(ddm_check)
+        {
+          if (row < badRow) {
+            badRow = row;
+            badCol = col;
+          }
+        }
+        col = ddm->numCols;
+        break;
       }
     }
   }
+  if (badRow < ddm->numRows) {
+    ERROR_LOGF("Bad DDM value %i at (%li, %li) %f",
+               (int)(ddm->data[badRow][badCol]), badCol, badRow,
+               ddm->noData);
+    return false;
+  }
   return true;
 }
 
-bool CheckSimpleDDM() {
-  for (long row = 0; row < g_DDM->numRows; row++) {
-    for (long col = 0; col < g_DDM->numCols; col++) {
-      if (g_DDM->data[row][col] == g_DDM->noData) {
+bool CheckSimpleDDM(FloatGrid *ddm) {
+  bool valid = true;
+#pragma omp parallel for schedule(static) reduction(&& : valid)
+  for (long row = 0; row < ddm->numRows; row++) {
+    for (long col = 0; col < ddm->numCols; col++) {
+      if (ddm->data[row][col] == ddm->noData) {
         continue;
       }
-      switch ((int)(g_DDM->data[row][col])) {
+      switch ((int)(ddm->data[row][col])) {
       case 0:
-        g_DDM->data[row][col] = g_DDM->noData;
+        ddm->data[row][col] = ddm->noData;
       case 1:
       case 2:
       case 3:
@@ -1416,50 +1972,87 @@ bool CheckSimpleDDM() {
       case 8:
         continue;
       default:
-        return false;
+        valid = false;
+        col = ddm->numCols;
+        break;
       }
     }
   }
-  return true;
+  return valid;
 }
 
-void ReclassifyDDM() {
+void ReclassifyDDM(FloatGrid *ddm) {
 
-  for (long row = 0; row < g_DDM->numRows; row++) {
-    for (long col = 0; col < g_DDM->numCols; col++) {
-      switch ((int)(g_DDM->data[row][col])) {
+#pragma omp parallel for schedule(static)
+  for (long row = 0; row < ddm->numRows; row++) {
+    for (long col = 0; col < ddm->numCols; col++) {
+      switch ((int)(ddm->data[row][col])) {
       case 64:
-        g_DDM->data[row][col] = FLOW_NORTH;
+        ddm->data[row][col] = FLOW_NORTH;
         break;
       case 128:
-        g_DDM->data[row][col] = FLOW_NORTHEAST;
+        ddm->data[row][col] = FLOW_NORTHEAST;
         break;
       case 1:
-        g_DDM->data[row][col] = FLOW_EAST;
+        ddm->data[row][col] = FLOW_EAST;
         break;
       case 2:
-        g_DDM->data[row][col] = FLOW_SOUTHEAST;
+        ddm->data[row][col] = FLOW_SOUTHEAST;
         break;
       case 4:
-        g_DDM->data[row][col] = FLOW_SOUTH;
+        ddm->data[row][col] = FLOW_SOUTH;
         break;
       case 8:
-        g_DDM->data[row][col] = FLOW_SOUTHWEST;
+        ddm->data[row][col] = FLOW_SOUTHWEST;
         break;
       case 16:
-        g_DDM->data[row][col] = FLOW_WEST;
+        ddm->data[row][col] = FLOW_WEST;
         break;
       case 32:
-        g_DDM->data[row][col] = FLOW_NORTHWEST;
+        ddm->data[row][col] = FLOW_NORTHWEST;
         break;
       }
     }
   }
 }
 
+// Flow directions are small integers, so the DDM is kept one byte per cell.
+// Anything that is not a direction code becomes DDM_NODATA.
+ByteGrid *PackDDM(FloatGrid *ddm) {
+  ByteGrid *packed = new ByteGrid();
+  packed->numCols = ddm->numCols;
+  packed->numRows = ddm->numRows;
+  packed->extent = ddm->extent;
+  packed->cellSize = ddm->cellSize;
+  packed->modelType = ddm->modelType;
+  packed->geographicType = ddm->geographicType;
+  packed->geodeticDatum = ddm->geodeticDatum;
+  packed->geoSet = ddm->geoSet;
+  packed->noData = DDM_NODATA;
+  if (!packed->Allocate()) {
+    delete packed;
+    return NULL;
+  }
+
+#pragma omp parallel for schedule(static)
+  for (long row = 0; row < ddm->numRows; row++) {
+    for (long col = 0; col < ddm->numCols; col++) {
+      float value = ddm->data[row][col];
+      if (value == ddm->noData || !(value >= 0.0f && value < DDM_NODATA) ||
+          value != floorf(value)) {
+        packed->data[row][col] = DDM_NODATA;
+      } else {
+        packed->data[row][col] = (unsigned char)value;
+      }
+    }
+  }
+  return packed;
+}
+
 void FixFAM() {
   // GridLoc locN;
 
+#pragma omp parallel for schedule(static)
   for (long row = 0; row < g_DEM->numRows; row++) {
     for (long col = 0; col < g_DEM->numCols; col++) {
       if (g_DEM->data[row][col] == g_DEM->noData ||
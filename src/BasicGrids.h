@@ -11,6 +11,8 @@
 
 bool LoadBasicGrids();
 void FreeBasicGridsData();
+// Folds the loaded DEM, DDM and FAM and the projection into a cache key
+void HashBasicGrids(unsigned long long *hash);
 void ClipBasicGrids(long x, long y, long search, const char *output);
 void ClipBasicGrids(BasinConfigSection *basin, std::vector<GridNode> *nodes,
                     const char *name, const char *output);
@@ -35,12 +37,15 @@ void CarveBasin(
 // Function to carve lake parameters from lake data to grid nodes
 void CarveLakeParameters(BasinConfigSection *basin, std::vector<GridNode> *nodes);
 void MakeBasic();
-void ReclassifyDDM();
-bool CheckESRIDDM();
-bool CheckSimpleDDM();
+void ReclassifyDDM(FloatGrid *ddm);
+bool CheckESRIDDM(FloatGrid *ddm);
+bool CheckSimpleDDM(FloatGrid *ddm);
+ByteGrid *PackDDM(FloatGrid *ddm);
+
+#define DDM_NODATA 255
 
 extern FloatGrid *g_DEM;
-extern FloatGrid *g_DDM;
+extern ByteGrid *g_DDM;
 extern FloatGrid *g_FAM;
 extern Projection *g_Projection;
 
@@ -5,6 +5,7 @@
 #include "LakeConfigSection.h"
 #include "LakeModel.h"
 #include "Messages.h"
+#include "TimeVar.h"
 #include <algorithm>
 #include <cstdio>
 #include <cstdlib>
@@ -198,8 +199,11 @@ static bool ReadLakesFromCSV(const std::string& filename, std::vector<LakeInfo>&
   return true;
 }
 
-// Helper function to read engineered discharge from CSV file
-static bool ReadEngineeredDischargeFromCSV(const std::string& filename, std::map<std::string, double>& engineeredDischarge) {
+// Helper function to read engineered discharge from CSV file. Every row is
+// kept, keyed by lake and then by time, so the lakes can line the series up
+// with the simulation steps once. Timestamps are YYYYMMDD-HHMMSS, anything
+// between the digits (e.g. YYYYMMDD_HHMM) is ignored.
+static bool ReadEngineeredDischargeFromCSV(const std::string& filename, std::map<std::string, std::map<time_t, double> >& engineeredDischarge) {
   // Check if directory exists
   std::string dirPath = filename;
   size_t lastSlash = dirPath.find_last_of("/\\");
@@ -238,25 +242,45 @@ static bool ReadEngineeredDischargeFromCSV(const std::string& filename, std::map
     
     // Read lake names from header
     while (std::getline(ss, token, ',')) {
+      token.erase(0, token.find_first_not_of(" \t\r\n"));
+      token.erase(token.find_last_not_of(" \t\r\n") + 1);
       lakeNames.push_back(token);
     }
   }
 
-  // Read first data line (we'll use the first timestamp for now)
-  if (std::getline(file, line)) {
+  size_t numValues = 0;
+  while (std::getline(file, line)) {
     std::stringstream ss(line);
     std::string token;
 
-    // Skip timestamp
-    if (!std::getline(ss, token, ',')) return false;
+    if (!std::getline(ss, token, ',')) continue;
+    char digits[CONFIG_MAX_LEN];
+    size_t numDigits = 0;
+    for (size_t i = 0; i < token.size() && numDigits < CONFIG_MAX_LEN - 1; i++) {
+      if (isdigit((unsigned char)token[i])) {
+        digits[numDigits++] = token[i];
+      }
+    }
+    digits[numDigits] = 0;
+    TimeVar time;
+    if (numDigits < 8 || !time.LoadTime(digits)) {
+      if (token.find_first_not_of(" \t\r\n") != std::string::npos) {
+        WARNING_LOGF("Skipping engineered discharge row with bad timestamp '%s'", token.c_str());
+      }
+      continue;
+    }
 
-    // Parse discharge values for each lake
+    // Parse discharge values for each lake, an empty cell means no value
     int lakeIndex = 0;
     while (std::getline(ss, token, ',') && lakeIndex < (int)lakeNames.size()) {
-      double discharge = atof(token.c_str());
-      if (discharge != 0.0 || token == "0" || token == "0.0") {
-        engineeredDischarge[lakeNames[lakeIndex]] = discharge;
-      } else {
+      token.erase(0, token.find_first_not_of(" \t\r\n"));
+      token.erase(token.find_last_not_of(" \t\r\n") + 1);
+      char *end = NULL;
+      double discharge = strtod(token.c_str(), &end);
+      if (!token.empty() && *end == 0) {
+        engineeredDischarge[lakeNames[lakeIndex]][time.currentTimeSec] = discharge;
+        numValues++;
+      } else if (!token.empty()) {
         WARNING_LOGF("Failed to parse discharge value '%s' for lake '%s'", token.c_str(), lakeNames[lakeIndex].c_str());
       }
       lakeIndex++;
@@ -264,7 +288,7 @@ static bool ReadEngineeredDischargeFromCSV(const std::string& filename, std::map
   }
 
   file.close();
-  INFO_LOGF("Successfully loaded %lu engineered discharge values from %s", (unsigned long)engineeredDischarge.size(), filename.c_str());
+  INFO_LOGF("Successfully loaded %lu engineered discharge values for %lu lakes from %s", (unsigned long)numValues, (unsigned long)engineeredDischarge.size(), filename.c_str());
   return true;
 }
 
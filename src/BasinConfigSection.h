@@ -6,6 +6,7 @@
 #include "GaugeConfigSection.h"
 #include <map>
 #include <string>
+#include <time.h>
 #include <vector>
 
 // Forward declaration
@@ -20,7 +21,10 @@ public:
   char *GetName() { return name; }
   std::vector<GaugeConfigSection *> *GetGauges() { return &gauges; }
   std::vector<LakeInfo> *GetLakes() { return &lakes; }
-  std::map<std::string, double> *GetEngineeredDischarge() { return &engineeredDischarge; }
+  // Engineered discharge (m^3/s) by lake name and time
+  std::map<std::string, std::map<time_t, double> > *GetEngineeredDischarge() {
+    return &engineeredDischarge;
+  }
   CONFIG_SEC_RET ProcessKeyValue(char *name, char *value);
   CONFIG_SEC_RET ValidateSection();
 
@@ -31,7 +35,7 @@ private:
   char name[CONFIG_MAX_LEN];
   std::vector<GaugeConfigSection *> gauges;
   std::vector<LakeInfo> lakes;
-  std::map<std::string, double> engineeredDischarge;
+  std::map<std::string, std::map<time_t, double> > engineeredDischarge;
 };
 
 extern std::map<std::string, BasinConfigSection *> g_basinConfigs;
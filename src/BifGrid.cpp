@@ -4,6 +4,10 @@
 #include <fcntl.h>
 
 FloatGrid *ReadFloatBifGrid(char *file) {
+  return ReadFloatBifGrid(file, NULL);
+}
+
+FloatGrid *ReadFloatBifGrid(char *file, GridPool *pool) {
 
   BifHeader header;
   FloatGrid *grid = NULL;
@@ -18,48 +22,36 @@ FloatGrid *ReadFloatBifGrid(char *file) {
   // posix_fadvise(fileno(fileH), 0, 0, POSIX_FADV_WILLNEED);
   // posix_fadvise(fileno(fileH), 0, 0, POSIX_FADV_NOREUSE);
 
-  grid = new FloatGrid();
-
   if (fread(&header, sizeof(BifHeader), 1, fileH) != 1) {
     WARNING_LOGF("BIF file %s missing header", file);
     fclose(fileH);
-    delete grid;
     return NULL;
   }
 
-  grid->numCols = header.ncols;
-  grid->numRows = header.nrows;
+  grid = NewFloatGrid(pool, header.ncols, header.nrows);
+  if (!grid) {
+    WARNING_LOGF("BIF file %s too large (out of memory) with %i rows and "
+                 "%i columns",
+                 file, header.nrows, header.ncols);
+    fclose(fileH);
+    return NULL;
+  }
   grid->cellSize = header.cellsize;
   grid->extent.bottom = header.yllcor;
   grid->extent.left = header.xllcor;
   grid->noData = header.nodata; // Previously left uninitialized; required so
                                 // readers can detect missing cells in BIF grids.
-
-  grid->data = new float *[grid->numRows]();
-  if (!grid->data) {
-    WARNING_LOGF("BIF file %s too large (out of memory) with %li rows", file,
-                 grid->numRows);
-    delete grid;
+  grid->geoSet = false;
+
+  // The file is row-major like the grid, so it is read in one go
+  if (fread(grid->backingStore, sizeof(float),
+            (size_t)grid->numCols * grid->numRows,
+            fileH) != (size_t)grid->numCols * grid->numRows) {
+    WARNING_LOGF("BIF file %s corrupt?", file);
+    FreeFloatGrid(pool, grid);
     fclose(fileH);
     return NULL;
   }
-  for (long i = 0; i < grid->numRows; i++) {
-    grid->data[i] = new float[grid->numCols];
-    if (!grid->data[i]) {
-      WARNING_LOGF("BIF file %s too large (out of memory) with %li columns",
-                   file, grid->numCols);
-      delete grid;
-      fclose(fileH);
-      return NULL;
-    }
-    if (fread(grid->data[i], sizeof(float), grid->numCols, fileH) !=
-        (size_t)grid->numCols) {
-      WARNING_LOGF("BIF file %s corrupt?", file);
-      delete grid;
-      fclose(fileH);
-      return NULL;
-    }
-  }
 
   // Fill in the rest of the BoundingBox
   grid->extent.top = grid->extent.bottom + grid->numRows * grid->cellSize;
@@ -2,6 +2,7 @@
 #define BIF_GRID_H
 
 #include "Grid.h"
+#include "GridPool.h"
 
 #pragma pack(push)
 #pragma pack(1)
@@ -17,5 +18,6 @@ struct BifHeader {
 #pragma pack(pop)
 
 FloatGrid *ReadFloatBifGrid(char *file);
+FloatGrid *ReadFloatBifGrid(char *file, GridPool *pool);
 
 #endif
@@ -33,6 +33,7 @@ bool CRESTModel::InitializeModel(
     GridNode *node = &nodes->at(i);
     node->modelIndex = i;
   }
+  heldPrecip.assign(numNodes, 0.0);
 
   InitializeParameters(paramSettings, paramGrids);
 
@@ -111,6 +112,7 @@ bool CRESTModel::WaterBalance(float stepHours,
                               std::vector<float> *groundwater) {
 
   size_t numNodes = nodes->size();
+  numIdle = 0;
 
 #if _OPENMP
   //#pragma omp parallel for
@@ -119,9 +121,32 @@ bool CRESTModel::WaterBalance(float stepHours,
   for (size_t i = 0; i < numNodes; i++) {
     GridNode *node = &nodes->at(i);
     CRESTGridNode *cNode = &(crestNodes[i]);
-    WaterBalanceInt(node, cNode, stepHours, precip->at(i), pet->at(i),
-                    &(fastFlow->at(i)), &(slowFlow->at(i)),
-                    &(baseFlow->at(i)));
+    float precipIn = precip->at(i);
+
+    // A cell with no more rain than the threshold and no soil water to lose
+    // is skipped and its rain kept for later. With a zero threshold these
+    // are exactly the cells the step leaves as they are.
+    double held = heldPrecip[i] + (double)(precipIn * stepHours);
+    double adjPET =
+        (double)(pet->at(i) * stepHours) * cNode->params[PARAM_CREST_KE];
+    double sm = cNode->states[STATE_CREST_SM];
+    if (held >= 0.0 && held <= idleThreshold && adjPET >= 0.0 && sm >= 0.0 &&
+        sm <= cNode->params[PARAM_CREST_WM] &&
+        (sm <= idleThreshold || adjPET == 0.0)) {
+      heldPrecip[i] = held;
+      cNode->excess[CREST_LAYER_OVERLAND] = 0.0;
+      cNode->excess[CREST_LAYER_INTERFLOW] = 0.0;
+      cNode->actET = 0.0;
+      numIdle++;
+    } else {
+      if (heldPrecip[i] != 0.0) {
+        precipIn += heldPrecip[i] / stepHours;
+        heldPrecip[i] = 0.0;
+      }
+      WaterBalanceInt(node, cNode, stepHours, precipIn, pet->at(i),
+                      &(fastFlow->at(i)), &(slowFlow->at(i)),
+                      &(baseFlow->at(i)));
+    }
     soilMoisture->at(i) =
         cNode->states[STATE_CREST_SM] * 100.0 / cNode->params[PARAM_CREST_WM];
   }
@@ -54,6 +54,7 @@ private:
 
   std::vector<GridNode> *nodes;
   std::vector<CRESTGridNode> crestNodes;
+  std::vector<double> heldPrecip; // mm of rain idle cells have not used yet
 };
 
 #endif
@@ -0,0 +1,21 @@
+#ifndef CACHE_HASH_H
+#define CACHE_HASH_H
+
+#include <cstring>
+
+// 64-bit FNV-1a, used to key the on-disk caches on what they were built from
+#define CACHE_HASH_BASIS 14695981039346656037ULL
+
+inline void HashBytes(unsigned long long *hash, const void *data, size_t len) {
+  const unsigned char *bytes = (const unsigned char *)data;
+  for (size_t i = 0; i < len; i++) {
+    *hash = (*hash ^ bytes[i]) * 1099511628211ULL;
+  }
+}
+
+// Includes the terminator so consecutive strings cannot run together
+inline void HashString(unsigned long long *hash, const char *str) {
+  HashBytes(hash, str, strlen(str) + 1);
+}
+
+#endif
@@ -29,6 +29,14 @@ CaliParamConfigSection::CaliParamConfigSection(char *nameVal, MODELS modelVal) {
 
   // DREAM defaults
   dream_ndraw = 10000;
+  dream_surrogate = false;
+  dream_surrogateExplore = 0.1;
+  dream_workers = 0;
+
+  // Per-pixel defaults
+  pixel_warmStart = false;
+  pixel_spreadTol = 0.0;
+  pixel_clusters = 0;
 }
 
 CaliParamConfigSection::~CaliParamConfigSection() {
@@ -54,6 +62,25 @@ CONFIG_SEC_RET CaliParamConfigSection::ProcessKeyValue(char *name,
     }
 
     gauge = itr->second;
+  } else if (!strcasecmp(name, "cali_gauges")) {
+    caliGauges.clear();
+    for (char *part = strtok(value, "|"); part != NULL;
+         part = strtok(NULL, "|")) {
+      TOLOWER(part);
+      std::map<std::string, GaugeConfigSection *>::iterator itr =
+          g_gaugeConfigs.find(part);
+      if (itr == g_gaugeConfigs.end()) {
+        ERROR_LOGF("Unknown gauge \"%s\" in cali_gauges!", part);
+        return INVALID_RESULT;
+      }
+      caliGauges.push_back(itr->second);
+    }
+  } else if (!strcasecmp(name, "cali_weights")) {
+    caliWeights.clear();
+    for (char *part = strtok(value, "|"); part != NULL;
+         part = strtok(NULL, "|")) {
+      caliWeights.push_back(atof(part));
+    }
   } else if (!strcasecmp(name, "objective")) {
     for (int i = 0; i < OBJECTIVE_QTY; i++) {
       if (!strcasecmp(value, objectiveStrings[i])) {
@@ -80,6 +107,59 @@ CONFIG_SEC_RET CaliParamConfigSection::ProcessKeyValue(char *name,
   } else if (!strcasecmp(name, "dream_ndraw")) {
     dream_ndraw = atoi(value);
     return VALID_RESULT;
+  } else if (!strcasecmp(name, "dream_surrogate")) {
+    if (!strcasecmp(value, "true")) {
+      dream_surrogate = true;
+    } else if (!strcasecmp(value, "false")) {
+      dream_surrogate = false;
+    } else {
+      ERROR_LOGF("Invalid dream_surrogate value \"%s\"! Must be 'true' or "
+                 "'false'",
+                 value);
+      return INVALID_RESULT;
+    }
+    return VALID_RESULT;
+  } else if (!strcasecmp(name, "dream_surrogate_explore")) {
+    dream_surrogateExplore = atof(value);
+    if (dream_surrogateExplore < 0.0 || dream_surrogateExplore > 1.0) {
+      ERROR_LOGF("dream_surrogate_explore must be between 0 and 1, got %s",
+                 value);
+      return INVALID_RESULT;
+    }
+    return VALID_RESULT;
+  } else if (!strcasecmp(name, "dream_workers")) {
+    dream_workers = atoi(value);
+    if (dream_workers < 0) {
+      ERROR_LOGF("dream_workers must not be negative, got %s", value);
+      return INVALID_RESULT;
+    }
+    return VALID_RESULT;
+  } else if (!strcasecmp(name, "pixel_warmstart")) {
+    if (!strcasecmp(value, "true")) {
+      pixel_warmStart = true;
+    } else if (!strcasecmp(value, "false")) {
+      pixel_warmStart = false;
+    } else {
+      ERROR_LOGF("Invalid pixel_warmstart value \"%s\"! Must be 'true' or "
+                 "'false'",
+                 value);
+      return INVALID_RESULT;
+    }
+    return VALID_RESULT;
+  } else if (!strcasecmp(name, "pixel_spread_tol")) {
+    pixel_spreadTol = atof(value);
+    if (pixel_spreadTol < 0.0) {
+      ERROR_LOGF("pixel_spread_tol must not be negative, got %s", value);
+      return INVALID_RESULT;
+    }
+    return VALID_RESULT;
+  } else if (!strcasecmp(name, "pixel_clusters")) {
+    pixel_clusters = atoi(value);
+    if (pixel_clusters < 0) {
+      ERROR_LOGF("pixel_clusters must not be negative, got %s", value);
+      return INVALID_RESULT;
+    }
+    return VALID_RESULT;
   } else {
     if (!gauge) {
       ERROR_LOGF("Got parameter %s without a gauge being set!", name);
@@ -132,6 +212,20 @@ CONFIG_SEC_RET CaliParamConfigSection::ValidateSection() {
     return INVALID_RESULT;
   }
 
+  if (caliGauges.empty()) {
+    caliGauges.push_back(gauge);
+  } else if (caliGauges[0] != gauge) {
+    ERROR_LOG("The first of cali_gauges must be the calibration gauge!");
+    return INVALID_RESULT;
+  }
+  if (caliWeights.empty()) {
+    caliWeights.resize(caliGauges.size(), 1.0);
+  } else if (caliWeights.size() != caliGauges.size()) {
+    ERROR_LOGF("cali_weights has %d values but there are %d cali_gauges!",
+               (int)caliWeights.size(), (int)caliGauges.size());
+    return INVALID_RESULT;
+  }
+
   for (int i = 0; i < numParams; i++) {
     if (!paramsSet[i]) {
       ERROR_LOGF(
@@ -7,6 +7,7 @@
 #include "Model.h"
 #include "ObjectiveFunc.h"
 #include <map>
+#include <vector>
 
 class CaliParamConfigSection : public ConfigSection {
 
@@ -16,6 +17,11 @@ public:
 
   OBJECTIVES GetObjFunc() { return objective; }
   GaugeConfigSection *GetGauge() { return gauge; }
+  // Gauges scored together in one simulation pass, each with its own
+  // parameter block. Just the calibration gauge unless cali_gauges is set.
+  std::vector<GaugeConfigSection *> *GetCaliGauges() { return &caliGauges; }
+  std::vector<float> *GetCaliWeights() { return &caliWeights; }
+  int GetNumCaliGauges() { return (int)caliGauges.size(); }
   float *GetParamMins() { return modelParamMins; }
   float *GetParamMaxs() { return modelParamMaxs; }
   float *GetParamInits() { return modelParamInits; }
@@ -28,6 +34,14 @@ public:
 
   // DREAM
   int DREAMGetNDraw() { return dream_ndraw; }
+  bool DREAMUseSurrogate() { return dream_surrogate; }
+  float DREAMGetSurrogateExplore() { return dream_surrogateExplore; }
+  int DREAMGetWorkers() { return dream_workers; }
+
+  // Per-pixel DE (STYLE_CALI_DREAM_PIXEL)
+  bool PixelWarmStart() { return pixel_warmStart; }
+  float PixelGetSpreadTol() { return pixel_spreadTol; }
+  int PixelGetClusters() { return pixel_clusters; }
 
   char *GetName();
   CONFIG_SEC_RET ProcessKeyValue(char *name, char *value);
@@ -41,6 +55,8 @@ private:
   MODELS model;
   OBJECTIVES objective;
   GaugeConfigSection *gauge;
+  std::vector<GaugeConfigSection *> caliGauges;
+  std::vector<float> caliWeights;
   float *modelParamMins;
   float *modelParamMaxs;
   float *modelParamInits;
@@ -50,6 +66,12 @@ private:
   float ars_convergenceCriteria;
   int ars_burnInSets;
   int dream_ndraw;
+  bool dream_surrogate;
+  float dream_surrogateExplore;
+  int dream_workers;
+  bool pixel_warmStart;
+  float pixel_spreadTol;
+  int pixel_clusters;
 };
 
 extern std::map<std::string, CaliParamConfigSection *> g_caliParamConfigs[];
@@ -0,0 +1,406 @@
+#include "CaliWorkerPool.h"
+#include "Messages.h"
+#include "Simulator.h"
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#ifndef WIN32
+#include <poll.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+#if _OPENMP
+#include <omp.h>
+#endif
+
+// A parameter set that takes down this many workers is given up on
+#define MAX_TASK_CRASHES 2
+
+#ifndef WIN32
+static bool ReadFull(int fd, void *buffer, size_t len) {
+  char *pos = (char *)buffer;
+  while (len > 0) {
+    ssize_t got = read(fd, pos, len);
+    if (got < 0 && errno == EINTR) {
+      continue;
+    }
+    if (got <= 0) {
+      return false;
+    }
+    pos += got;
+    len -= got;
+  }
+  return true;
+}
+
+static bool WriteFull(int fd, const void *buffer, size_t len) {
+  const char *pos = (const char *)buffer;
+  while (len > 0) {
+    ssize_t put = write(fd, pos, len);
+    if (put < 0 && errno == EINTR) {
+      continue;
+    }
+    if (put <= 0) {
+      return false;
+    }
+    pos += put;
+    len -= put;
+  }
+  return true;
+}
+#endif
+
+CaliWorkerPool::CaliWorkerPool() {
+  sim = NULL;
+  numParams = 0;
+  numRestarts = 0;
+#ifndef WIN32
+  pipeActionSaved = false;
+#endif
+}
+
+CaliWorkerPool::~CaliWorkerPool() { Stop(); }
+
+bool CaliWorkerPool::Start(Simulator *simNew, int numWorkersNew,
+                           int numParamsNew) {
+#ifdef WIN32
+  (void)simNew;
+  (void)numWorkersNew;
+  (void)numParamsNew;
+  WARNING_LOGF("%s", "Calibration worker processes are not supported on "
+                     "Windows, running in-process");
+  return false;
+#else
+  sim = simNew;
+  numParams = numParamsNew;
+  numRestarts = 0;
+
+  // A dead worker must show up as a failed write, not kill the parent.
+  // Only while the pool runs, the rest of the process keeps its handler.
+  if (!pipeActionSaved) {
+    struct sigaction ignore;
+    memset(&ignore, 0, sizeof(ignore));
+    ignore.sa_handler = SIG_IGN;
+    sigemptyset(&ignore.sa_mask);
+    pipeActionSaved = (sigaction(SIGPIPE, &ignore, &oldPipeAction) == 0);
+  }
+  ReadNodeCpus();
+
+  workers.resize(numWorkersNew);
+  for (int i = 0; i < numWorkersNew; i++) {
+    workers[i].pid = -1;
+    workers[i].toWorker = -1;
+    workers[i].fromWorker = -1;
+    workers[i].task = -1;
+  }
+  for (int i = 0; i < numWorkersNew; i++) {
+    if (!Spawn(i)) {
+      Stop();
+      return false;
+    }
+  }
+
+  if (nodeCpus.size() > 1) {
+    INFO_LOGF("Started %i calibration workers across %i NUMA nodes",
+              numWorkersNew, (int)nodeCpus.size());
+  } else {
+    INFO_LOGF("Started %i calibration workers", numWorkersNew);
+  }
+  return true;
+#endif
+}
+
+void CaliWorkerPool::Stop() {
+#ifndef WIN32
+  // Closing the request pipe is the signal to exit
+  for (size_t i = 0; i < workers.size(); i++) {
+    if (workers[i].toWorker >= 0) {
+      close(workers[i].toWorker);
+      workers[i].toWorker = -1;
+    }
+  }
+  for (size_t i = 0; i < workers.size(); i++) {
+    if (workers[i].pid > 0) {
+      waitpid((pid_t)workers[i].pid, NULL, 0);
+    }
+    if (workers[i].fromWorker >= 0) {
+      close(workers[i].fromWorker);
+    }
+  }
+  if (pipeActionSaved) {
+    sigaction(SIGPIPE, &oldPipeAction, NULL);
+    pipeActionSaved = false;
+  }
+#endif
+  workers.clear();
+}
+
+void CaliWorkerPool::Evaluate(float **params, int count, float *scores) {
+#ifdef WIN32
+  (void)params;
+  (void)count;
+  (void)scores;
+#else
+  std::vector<int> crashes(count, 0);
+  std::vector<int> retry;
+  int next = 0, remaining = count;
+  int numWorkers = (int)workers.size();
+
+  while (remaining > 0) {
+    // Hand a parameter set to every idle worker
+    for (int w = 0; w < numWorkers; w++) {
+      Worker *worker = &(workers[w]);
+      if (worker->task >= 0 || worker->pid <= 0) {
+        continue;
+      }
+      int task;
+      if (!retry.empty()) {
+        task = retry.back();
+        retry.pop_back();
+      } else if (next < count) {
+        task = next++;
+      } else {
+        break;
+      }
+      worker->task = task;
+      if (!WriteFull(worker->toWorker, &task, sizeof(int)) ||
+          !WriteFull(worker->toWorker, params[task],
+                     sizeof(float) * numParams)) {
+        // Treated like a crash below once poll reports the hang up
+        continue;
+      }
+    }
+
+    std::vector<struct pollfd> fds;
+    std::vector<int> fdWorkers;
+    for (int w = 0; w < numWorkers; w++) {
+      if (workers[w].task >= 0) {
+        struct pollfd pfd;
+        pfd.fd = workers[w].fromWorker;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        fds.push_back(pfd);
+        fdWorkers.push_back(w);
+      }
+    }
+    if (fds.empty()) {
+      // Every worker is gone, finish the rest in this process
+      ERROR_LOGF("%s", "No calibration workers left, continuing in-process");
+      while (!retry.empty()) {
+        scores[retry.back()] = sim->SimulateForCali(params[retry.back()]);
+        retry.pop_back();
+        remaining--;
+      }
+      for (; next < count; next++) {
+        scores[next] = sim->SimulateForCali(params[next]);
+        remaining--;
+      }
+      break;
+    }
+    if (poll(&(fds[0]), fds.size(), -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      ERROR_LOGF("Waiting on calibration workers failed: %s", strerror(errno));
+      break;
+    }
+
+    for (size_t f = 0; f < fds.size(); f++) {
+      if (!fds[f].revents) {
+        continue;
+      }
+      int w = fdWorkers[f];
+      int task = workers[w].task, index;
+      float score;
+      if (ReadFull(workers[w].fromWorker, &index, sizeof(int)) &&
+          ReadFull(workers[w].fromWorker, &score, sizeof(float)) &&
+          index == task) {
+        scores[task] = score;
+        workers[w].task = -1;
+        remaining--;
+        continue;
+      }
+
+      crashes[task]++;
+      if (crashes[task] >= MAX_TASK_CRASHES) {
+        WARNING_LOGF("Parameter set %i crashed %i workers, giving up on it",
+                     task, crashes[task]);
+        scores[task] = std::numeric_limits<float>::quiet_NaN();
+        remaining--;
+      } else {
+        retry.push_back(task);
+      }
+      Reap(w);
+      if (Spawn(w)) {
+        numRestarts++;
+        WARNING_LOGF("Calibration worker %i died, restarted it", w);
+      } else {
+        ERROR_LOGF("Calibration worker %i died and could not be restarted", w);
+      }
+    }
+  }
+#endif
+}
+
+bool CaliWorkerPool::Spawn(int index) {
+#ifdef WIN32
+  (void)index;
+  return false;
+#else
+  int request[2], reply[2];
+  if (pipe(request) != 0) {
+    ERROR_LOGF("Failed to create worker pipe: %s", strerror(errno));
+    return false;
+  }
+  if (pipe(reply) != 0) {
+    ERROR_LOGF("Failed to create worker pipe: %s", strerror(errno));
+    close(request[0]);
+    close(request[1]);
+    return false;
+  }
+
+  // Anything still buffered would otherwise be printed twice
+  fflush(stdout);
+  fflush(stderr);
+  pid_t pid = fork();
+  if (pid < 0) {
+    ERROR_LOGF("Failed to fork calibration worker: %s", strerror(errno));
+    close(request[0]);
+    close(request[1]);
+    close(reply[0]);
+    close(reply[1]);
+    return false;
+  }
+
+  if (pid == 0) {
+    // The other workers' pipe ends would keep them from seeing EOF
+    for (size_t i = 0; i < workers.size(); i++) {
+      if (workers[i].toWorker >= 0) {
+        close(workers[i].toWorker);
+      }
+      if (workers[i].fromWorker >= 0) {
+        close(workers[i].fromWorker);
+      }
+    }
+    close(request[1]);
+    close(reply[0]);
+    BindToNode(index);
+    WorkerLoop(request[0], reply[1]);
+    _exit(0);
+  }
+
+  close(request[0]);
+  close(reply[1]);
+  workers[index].pid = pid;
+  workers[index].toWorker = request[1];
+  workers[index].fromWorker = reply[0];
+  workers[index].task = -1;
+  return true;
+#endif
+}
+
+void CaliWorkerPool::Reap(int index) {
+#ifdef WIN32
+  (void)index;
+#else
+  Worker *worker = &(workers[index]);
+  close(worker->toWorker);
+  close(worker->fromWorker);
+  if (worker->pid > 0) {
+    kill((pid_t)worker->pid, SIGKILL);
+    waitpid((pid_t)worker->pid, NULL, 0);
+  }
+  worker->pid = -1;
+  worker->toWorker = -1;
+  worker->fromWorker = -1;
+  worker->task = -1;
+#endif
+}
+
+// Runs in the child: one SimulateForCali at a time until the parent closes
+// the request pipe. Workers are single threaded, the pool is the parallelism.
+void CaliWorkerPool::WorkerLoop(int inFd, int outFd) {
+#ifdef WIN32
+  (void)inFd;
+  (void)outFd;
+#else
+#if _OPENMP
+  omp_set_num_threads(1);
+#endif
+  std::vector<float> params(numParams);
+  int index;
+  while (ReadFull(inFd, &index, sizeof(int)) &&
+         ReadFull(inFd, &(params[0]), sizeof(float) * numParams)) {
+    float score = sim->SimulateForCali(&(params[0]));
+    if (!WriteFull(outFd, &index, sizeof(int)) ||
+        !WriteFull(outFd, &score, sizeof(float))) {
+      break;
+    }
+  }
+#endif
+}
+
+// Reads the CPU list of every NUMA node, e.g. "0-15,32-47"
+void CaliWorkerPool::ReadNodeCpus() {
+  nodeCpus.clear();
+#ifdef __linux__
+  for (int node = 0;; node++) {
+    char path[128], list[4096];
+    sprintf(path, "/sys/devices/system/node/node%i/cpulist", node);
+    FILE *file = fopen(path, "r");
+    if (!file) {
+      break;
+    }
+    std::vector<int> cpus;
+    if (fgets(list, sizeof(list), file)) {
+      char *range = strtok(list, ",\n");
+      while (range) {
+        int first, last;
+        int fields = sscanf(range, "%i-%i", &first, &last);
+        if (fields == 1) {
+          last = first;
+        }
+        if (fields >= 1) {
+          for (int cpu = first; cpu <= last; cpu++) {
+            cpus.push_back(cpu);
+          }
+        }
+        range = strtok(NULL, ",\n");
+      }
+    }
+    fclose(file);
+    if (!cpus.empty()) {
+      nodeCpus.push_back(cpus);
+    }
+  }
+#endif
+}
+
+// Worker i runs on node i % nodes. The model state it allocates per
+// evaluation is then first touched, and so placed, on that node.
+void CaliWorkerPool::BindToNode(int index) {
+#ifdef __linux__
+  if (nodeCpus.size() < 2) {
+    return;
+  }
+  std::vector<int> &cpus = nodeCpus[index % nodeCpus.size()];
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (size_t i = 0; i < cpus.size(); i++) {
+    if (cpus[i] < CPU_SETSIZE) {
+      CPU_SET(cpus[i], &set);
+    }
+  }
+  if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+    WARNING_LOGF("Failed to bind calibration worker %i to its NUMA node",
+                 index);
+  }
+#else
+  (void)index;
+#endif
+}
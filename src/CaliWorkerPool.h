@@ -0,0 +1,52 @@
+#ifndef CALI_WORKER_POOL_H
+#define CALI_WORKER_POOL_H
+
+#include <vector>
+#ifndef WIN32
+#include <signal.h>
+#endif
+
+class Simulator;
+
+// Scores calibration parameter sets in forked worker processes. The pool is
+// started after the forcings are preloaded, so every worker reads the
+// parent's forcing pages (shared copy-on-write, never written) instead of
+// holding its own copy. Each worker has a request and a reply pipe; a worker
+// that dies is replaced and its parameter set handed out again. On Linux
+// hosts with several NUMA nodes the workers are spread across the nodes.
+class CaliWorkerPool {
+public:
+  CaliWorkerPool();
+  ~CaliWorkerPool();
+  bool Start(Simulator *simNew, int numWorkersNew, int numParamsNew);
+  void Stop();
+  // Parameter sets that keep crashing workers score NaN
+  void Evaluate(float **params, int count, float *scores);
+  int GetNumWorkers() { return (int)workers.size(); }
+  int GetNumRestarts() { return numRestarts; }
+
+private:
+  struct Worker {
+    long pid;
+    int toWorker, fromWorker;
+    int task; // parameter set being scored, -1 when idle
+  };
+
+  bool Spawn(int index);
+  void Reap(int index);
+  void WorkerLoop(int inFd, int outFd);
+  void ReadNodeCpus();
+  void BindToNode(int index);
+
+  Simulator *sim;
+  int numParams, numRestarts;
+  std::vector<Worker> workers;
+  std::vector<std::vector<int> > nodeCpus;
+#ifndef WIN32
+  // SIGPIPE disposition to put back once the pool is stopped
+  struct sigaction oldPipeAction;
+  bool pipeActionSaved;
+#endif
+};
+
+#endif
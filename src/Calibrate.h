@@ -5,9 +5,15 @@
 #include "ObjectiveFunc.h"
 #include "Simulator.h"
 #include "LakeCaliParamConfigSection.h"
+#include <cstdio>
+#include <stdlib.h>
 
 class Calibrate {
 public:
+  Calibrate()
+      : checkpointFile(NULL), resumeCheckpoint(false), numCaliGauges(1) {
+    SeedRNG(0);
+  }
   virtual void
   Initialize(CaliParamConfigSection *caliParamConfigNew,
              RoutingCaliParamConfigSection *routingCaliParamConfigNew,
@@ -17,9 +23,41 @@ public:
              Simulator *simNew) = 0;
   virtual void CalibrateParams() = 0;
 
+  // Periodically write the optimizer state to file, optionally picking up
+  // from a previous checkpoint there before starting.
+  void SetCheckpoint(const char *file, bool resume) {
+    checkpointFile = (file && file[0]) ? file : NULL;
+    resumeCheckpoint = resume;
+  }
+  // Length of a candidate parameter set, known once Initialize has run
+  int GetNumParams() { return numParams; }
+
+  // Each optimizer draws from its own erand48 stream so that several can
+  // run side by side without sharing the process wide drand48 state
+  void SeedRNG(unsigned long seed) {
+#ifdef WIN32
+    srand(seed);
+#endif
+    rngState[0] = 0x330E;
+    rngState[1] = (unsigned short)(seed & 0xFFFF);
+    rngState[2] = (unsigned short)((seed >> 16) & 0xFFFF);
+  }
+
 protected:
+  // The erand48 state is the only RNG state the optimizers carry
+  bool WriteRNGState(FILE *file) {
+    return (fwrite(rngState, sizeof(unsigned short), 3, file) == 3);
+  }
+  bool ReadRNGState(FILE *file) {
+    return (fread(rngState, sizeof(unsigned short), 3, file) == 3);
+  }
+
+  const char *checkpointFile;
+  bool resumeCheckpoint;
+  unsigned short rngState[3];
   Simulator *sim;
   int numParams, numParamsWB, numParamsR, numParamsS, numParamsL;
+  int numCaliGauges;
   CaliParamConfigSection *caliParamConfig;
   RoutingCaliParamConfigSection *routingCaliParamConfig;
   SnowCaliParamConfigSection *snowCaliParamConfig;
@@ -1,7 +1,7 @@
-#include <algorithm>
-#include <cmath>
 #include <cstdio>
 #include <cstring>
+#include <new>
+#include <vector>
 
 #include "AscGrid.h"
 #include "BasicGrids.h"
@@ -9,16 +9,11 @@
 #include "Messages.h"
 #include "TifGrid.h"
 
-struct DEMNode {
-  long x;
-  long y;
-  float dem;
-};
-
 static int ComputeFlowAcc(char *flowAccFile);
-static bool SortByHeight(DEMNode *d1, DEMNode *d2);
+static bool DrainsInto(long x, long y, long dx, long dy);
+static int CountUpstream(long x, long y);
+static float SumUpstream(long x, long y);
 static bool GetDownstreamNode(long x, long y, long *downX, long *downY);
-static bool FlowsInto(DEMNode *d1, DEMNode *d2);
 
 int ProcessDEM(int mode, char *demFile, char *flowDirFile, char *flowAccFile) {
   if (mode == 0) {
@@ -51,34 +46,44 @@ int ProcessDEM(int mode, char *demFile, char *flowDirFile, char *flowAccFile) {
     }
 
     INFO_LOGF("Loading DDM: %s", flowDirFile);
+    FloatGrid *ddm;
     ext = strrchr(flowDirFile, '.');
     if (!strcasecmp(ext, ".asc")) {
-      g_DDM = ReadFloatAscGrid(flowDirFile);
+      ddm = ReadFloatAscGrid(flowDirFile);
     } else {
-      g_DDM = ReadFloatTifGrid(flowDirFile);
+      ddm = ReadFloatTifGrid(flowDirFile);
     }
-    if (!g_DDM) {
+    if (!ddm) {
       ERROR_LOG("Failed to load DDM!");
       return 2;
     }
-    if (!g_DEM->IsSpatialMatch(g_DDM)) {
+    if (!g_DEM->IsSpatialMatch(ddm)) {
       ERROR_LOG("The spatial characteristics of the DEM and DDM differ!");
       return 2;
     }
 
-    if (CheckESRIDDM()) {
-      ReclassifyDDM();
+    if (CheckESRIDDM(ddm)) {
+      ReclassifyDDM(ddm);
+    }
+    g_DDM = PackDDM(ddm);
+    delete ddm;
+    if (!g_DDM) {
+      ERROR_LOG("Not enough memory for the DDM!");
+      return 2;
     }
 
-    ComputeFlowAcc(flowAccFile);
+    return ComputeFlowAcc(flowAccFile);
   }
 
   return 0;
 }
 
+// Flow accumulation in topological order of the DDM: a cell is done once
+// every cell draining into it is, starting from the cells nothing drains
+// into. Each frontier is processed in parallel and every cell sums its
+// upstream neighbors itself in a fixed order, so the result does not depend
+// on the number of threads. Elevation is not used.
 int ComputeFlowAcc(char *flowAccFile) {
-  std::vector<DEMNode *> nodes;
-
   g_FAM = new FloatGrid;
   g_FAM->extent.left = g_DEM->extent.left;
   g_FAM->extent.bottom = g_DEM->extent.bottom;
@@ -89,49 +94,85 @@ int ComputeFlowAcc(char *flowAccFile) {
   g_FAM->cellSize = g_DEM->cellSize;
   g_FAM->noData = g_DEM->noData;
 
-  g_FAM->data = new float *[g_FAM->numRows];
-  for (long i = 0; i < g_FAM->numRows; i++) {
-    g_FAM->data[i] = new float[g_FAM->numCols];
+  if (!g_FAM->Allocate()) {
+    ERROR_LOG("Not enough memory for the flow accumulation grid!");
+    return 2;
   }
 
-  // Grid is setup! Copy over no data values everywhere
-  for (long row = 0; row < g_FAM->numRows; row++) {
-    for (long col = 0; col < g_FAM->numCols; col++) {
-      g_FAM->data[row][col] = g_FAM->noData;
-    }
+  long numCols = g_DEM->numCols, numRows = g_DEM->numRows;
+  std::vector<unsigned char> inDegree;
+  try {
+    inDegree.resize(numCols * numRows);
+  } catch (std::bad_alloc &) {
+    ERROR_LOG("Not enough memory for the flow accumulation grid!");
+    return 2;
   }
 
-  for (long row = 0; row < g_DEM->numRows; row++) {
-    for (long col = 0; col < g_DEM->numCols; col++) {
+  // Count how many cells drain into each cell, no data stays no data
+  long numValid = 0;
+#if _OPENMP
+#pragma omp parallel for reduction(+ : numValid)
+#endif
+  for (long row = 0; row < numRows; row++) {
+    for (long col = 0; col < numCols; col++) {
+      g_FAM->data[row][col] = g_FAM->noData;
       if (g_DEM->data[row][col] != g_DEM->noData) {
-        DEMNode *node = new DEMNode;
-        node->x = col;
-        node->y = row;
-        node->dem = g_DEM->data[row][col];
-        nodes.push_back(node);
+        inDegree[row * numCols + col] = (unsigned char)CountUpstream(col, row);
+        numValid++;
       }
     }
   }
 
-  std::stable_sort(nodes.begin(), nodes.end(), SortByHeight);
-
-  for (std::vector<DEMNode *>::iterator itr = nodes.begin(); itr != nodes.end();
-       itr++) {
-    DEMNode *node = *(itr);
-    if (g_FAM->data[node->y][node->x] == g_FAM->noData) {
-      g_FAM->data[node->y][node->x] = 0;
+  std::vector<long> frontier, next;
+  for (long row = 0; row < numRows; row++) {
+    for (long col = 0; col < numCols; col++) {
+      if (g_DEM->data[row][col] != g_DEM->noData &&
+          inDegree[row * numCols + col] == 0) {
+        frontier.push_back(row * numCols + col);
+      }
     }
-    long downX, downY;
-    if (GetDownstreamNode(node->x, node->y, &downX, &downY)) {
-      if (g_FAM->data[downY][downX] == g_FAM->noData) {
-        g_FAM->data[downY][downX] = 0;
+  }
+
+  long numDone = 0;
+  while (!frontier.empty()) {
+    long count = (long)frontier.size();
+    numDone += count;
+    next.clear();
+#if _OPENMP
+#pragma omp parallel if (count > 4096)
+#endif
+    {
+      std::vector<long> ready;
+#if _OPENMP
+#pragma omp for schedule(static)
+#endif
+      for (long i = 0; i < count; i++) {
+        long x = frontier[i] % numCols, y = frontier[i] / numCols;
+        g_FAM->data[y][x] = SumUpstream(x, y);
+        long downX, downY;
+        if (GetDownstreamNode(x, y, &downX, &downY)) {
+          unsigned char left;
+#if _OPENMP
+#pragma omp atomic capture
+#endif
+          left = --inDegree[downY * numCols + downX];
+          if (left == 0) {
+            ready.push_back(downY * numCols + downX);
+          }
+        }
       }
-      g_FAM->data[downY][downX] =
-          g_FAM->data[downY][downX] + g_FAM->data[node->y][node->x] + 1;
-      // printf("Processing node z %f, current fac %f, down (%f) is %f (%f)\n",
-      // node->dem, g_FAM->data[node->y][node->x], g_DDM->data[node->y][node->x],
-      // g_FAM->data[downY][downX], g_DEM->data[downY][downX]);
+#if _OPENMP
+#pragma omp critical(fam_frontier)
+#endif
+      next.insert(next.end(), ready.begin(), ready.end());
     }
+    frontier.swap(next);
+  }
+
+  if (numDone < numValid) {
+    WARNING_LOGF("%li cells are on flow direction loops and were left as no "
+                 "data",
+                 numValid - numDone);
   }
 
   WriteFloatTifGrid(flowAccFile, g_FAM);
@@ -139,6 +180,46 @@ int ComputeFlowAcc(char *flowAccFile) {
   return 0;
 }
 
+// Direction a neighbor at (x + dx, y + dy) points in when it drains into
+// (x, y), indexed by [dy + 1][dx + 1]
+static const int intoDirs[3][3] = {
+    {FLOW_SOUTHEAST, FLOW_SOUTH, FLOW_SOUTHWEST},
+    {FLOW_EAST, FLOW_QTY, FLOW_WEST},
+    {FLOW_NORTHEAST, FLOW_NORTH, FLOW_NORTHWEST}};
+
+// True if the valid cell (x + dx, y + dy) drains into (x, y)
+bool DrainsInto(long x, long y, long dx, long dy) {
+  long fromX = x + dx, fromY = y + dy;
+  return fromX >= 0 && fromY >= 0 && fromX < g_DEM->numCols &&
+         fromY < g_DEM->numRows &&
+         g_DDM->data[fromY][fromX] == intoDirs[dy + 1][dx + 1] &&
+         g_DEM->data[fromY][fromX] != g_DEM->noData;
+}
+
+int CountUpstream(long x, long y) {
+  int count = 0;
+  for (long dy = -1; dy <= 1; dy++) {
+    for (long dx = -1; dx <= 1; dx++) {
+      if ((dx || dy) && DrainsInto(x, y, dx, dy)) {
+        count++;
+      }
+    }
+  }
+  return count;
+}
+
+float SumUpstream(long x, long y) {
+  float sum = 0;
+  for (long dy = -1; dy <= 1; dy++) {
+    for (long dx = -1; dx <= 1; dx++) {
+      if ((dx || dy) && DrainsInto(x, y, dx, dy)) {
+        sum += g_FAM->data[y + dy][x + dx] + 1;
+      }
+    }
+  }
+  return sum;
+}
+
 bool GetDownstreamNode(long x, long y, long *downX, long *downY) {
   long nextX = x;
   long nextY = y;
@@ -185,50 +266,3 @@ bool GetDownstreamNode(long x, long y, long *downX, long *downY) {
 
   return false;
 }
-
-bool SortByHeight(DEMNode *d1, DEMNode *d2) {
-  if ((d1->x == 115 && d1->y == 55) || (d2->x == 115 && d2->y == 55)) {
-    printf("Sorting %i %i (%f) to %i %i (%f)\n", (int)d1->x, (int)d1->y,
-           d1->dem, (int)d2->x, (int)d2->y, d2->dem);
-  }
-  if (d1->x == d2->x && d1->y == d2->y) {
-    return false;
-  }
-  if (fabsf(d1->dem - d2->dem) < 0.10) {
-    return FlowsInto(d1, d2);
-  } else {
-    return d1->dem > d2->dem;
-  }
-}
-
-bool FlowsInto(DEMNode *d1, DEMNode *d2) {
-  long downX, downY;
-  long curX = d1->x, curY = d1->y;
-  bool print = false;
-  if ((d1->x == 115 && d1->y == 55) || (d2->x == 115 && d2->y == 55)) {
-    print = true;
-  }
-  if (print) {
-    printf("Comparing %i %i (%f) to %i %i (%f)\n", (int)curX, (int)curY,
-           d1->dem, (int)d2->x, (int)d2->y, d2->dem);
-  }
-  while (GetDownstreamNode(curX, curY, &downX, &downY)) {
-    if (d2->x == downX && d2->y == downY) {
-      if (print) {
-        printf("true\n");
-      }
-      return true;
-    } else if (fabsf(d1->dem - g_DEM->data[downY][downX]) > 0.10) {
-      if (print) {
-        printf("false\n");
-      }
-      return false;
-    }
-    curX = downX;
-    curY = downY;
-  }
-  if (print) {
-    printf("false2\n");
-  }
-  return false;
-}
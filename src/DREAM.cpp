@@ -1,4 +1,5 @@
 #include "Messages.h"
+#include <cfloat>
 #include <cmath>
 #include <cstdio>
 #include <cstdlib>
@@ -10,6 +11,19 @@
 #endif
 #include "DREAM.h"
 
+#define DREAM_CHECKPOINT_MAGIC 0x44524d32 // "DRM2"
+
+// Proposals the surrogate expects to be accepted with less than this
+// probability are not simulated (unless picked for exploration)
+#define SURROGATE_ALPHA_CUTOFF 0.01
+#define SURROGATE_MAX_POINTS 300
+
+#ifdef WIN32
+#define SURROGATE_UNIFORM(rng) (((float)rand()) / RAND_MAX)
+#else
+#define SURROGATE_UNIFORM(rng) (erand48(rng))
+#endif
+
 void DREAM::Initialize(CaliParamConfigSection *caliParamConfigNew,
                        RoutingCaliParamConfigSection *routingCaliParamConfigNew,
                        SnowCaliParamConfigSection *snowCaliParamConfigNew,
@@ -24,7 +38,10 @@ void DREAM::Initialize(CaliParamConfigSection *caliParamConfigNew,
   numParamsR = numParamsRNew;
   numParamsS = numParamsSNew;
   numParamsL = numParamsLNew;
-  numParams = numParamsWBNew + numParamsRNew + numParamsSNew + numParamsLNew;
+  // One water balance/routing/snow block per calibration gauge
+  numCaliGauges = simNew->GetNumCaliGauges();
+  numParams = (numParamsWBNew + numParamsRNew + numParamsSNew) * numCaliGauges +
+              numParamsLNew;
   sim = simNew;
   isEnsemble = false;
 
@@ -42,11 +59,7 @@ void DREAM::Initialize(CaliParamConfigSection *caliParamConfigNew,
    // Initialize vars & RNG
    totalSets = 0;
    goodSets = 0;*/
-#ifdef WIN32
-  srand(time(NULL));
-#else
-  srand48(time(NULL));
-#endif
+  SeedRNG(time(NULL));
 
   minParams = new float[numParams];
   maxParams = new float[numParams];
@@ -56,29 +69,35 @@ void DREAM::Initialize(CaliParamConfigSection *caliParamConfigNew,
 
   // Stuff from CaliParamConfigSection
 
-  memcpy(minParams, caliParamConfig->GetParamMins(),
-         sizeof(float) * numParamsWB);
-  memcpy(maxParams, caliParamConfig->GetParamMaxs(),
-         sizeof(float) * numParamsWB);
-  memcpy(&(minParams[numParamsWB]), routingCaliParamConfig->GetParamMins(),
-         sizeof(float) * numParamsR);
-  memcpy(&(maxParams[numParamsWB]), routingCaliParamConfig->GetParamMaxs(),
-         sizeof(float) * numParamsR);
-  if (numParamsS > 0) {
-    memcpy(&(minParams[numParamsWB + numParamsR]),
-           snowCaliParamConfig->GetParamMins(), sizeof(float) * numParamsS);
-    memcpy(&(maxParams[numParamsWB + numParamsR]),
-           snowCaliParamConfig->GetParamMaxs(), sizeof(float) * numParamsS);
+  int blockSize = numParamsWB + numParamsR + numParamsS;
+  for (int b = 0; b < numCaliGauges; b++) {
+    float *blockMins = &(minParams[b * blockSize]);
+    float *blockMaxs = &(maxParams[b * blockSize]);
+    memcpy(blockMins, caliParamConfig->GetParamMins(),
+           sizeof(float) * numParamsWB);
+    memcpy(blockMaxs, caliParamConfig->GetParamMaxs(),
+           sizeof(float) * numParamsWB);
+    memcpy(&(blockMins[numParamsWB]), routingCaliParamConfig->GetParamMins(),
+           sizeof(float) * numParamsR);
+    memcpy(&(blockMaxs[numParamsWB]), routingCaliParamConfig->GetParamMaxs(),
+           sizeof(float) * numParamsR);
+    if (numParamsS > 0) {
+      memcpy(&(blockMins[numParamsWB + numParamsR]),
+             snowCaliParamConfig->GetParamMins(), sizeof(float) * numParamsS);
+      memcpy(&(blockMaxs[numParamsWB + numParamsR]),
+             snowCaliParamConfig->GetParamMaxs(), sizeof(float) * numParamsS);
+    }
   }
   if (numParamsL > 0) {
-    memcpy(&(minParams[numParamsWB + numParamsR + numParamsS]),
+    memcpy(&(minParams[blockSize * numCaliGauges]),
            lakeCaliParamConfig->GetParamMins(), sizeof(float) * numParamsL);
-    memcpy(&(maxParams[numParamsWB + numParamsR + numParamsS]),
+    memcpy(&(maxParams[blockSize * numCaliGauges]),
            lakeCaliParamConfig->GetParamMaxs(), sizeof(float) * numParamsL);
   }
 
   // srand48(0);
   pointerMCMC = new DREAM_Parameters();
+  pointerMCMC->rng = rngState;
   pointerInput = new Model_Input();
 
   // DREAM Parameters
@@ -107,6 +126,18 @@ void DREAM::Initialize(CaliParamConfigSection *caliParamConfigNew,
       numParams; // Number of Parameters = Dimension of the problem
   pointerInput->ParRangeMin = minParams;
   pointerInput->ParRangeMax = maxParams;
+
+  useSurrogate = caliParamConfig->DREAMUseSurrogate();
+  surrogateExplore = caliParamConfig->DREAMGetSurrogateExplore();
+  surrogate.Initialize(numParams, minParams, maxParams, SURROGATE_MAX_POINTS);
+  surrogateSkip = new bool[pointerMCMC->seq];
+  surrogateExplored = new bool[pointerMCMC->seq];
+  memset(surrogateSkip, 0, sizeof(bool) * pointerMCMC->seq);
+  memset(surrogateExplored, 0, sizeof(bool) * pointerMCMC->seq);
+  if (useSurrogate) {
+    INFO_LOGF("Pre-screening proposals with a surrogate (exploration %f)",
+              surrogateExplore);
+  }
 }
 
 void DREAM::Initialize(CaliParamConfigSection *caliParamConfigNew,
@@ -118,15 +149,13 @@ void DREAM::Initialize(CaliParamConfigSection *caliParamConfigNew,
   ensSims = ensSimsNew;
   paramsPerSim = paramsPerSimNew;
   isEnsemble = true;
+  numCaliGauges = 1;
 
   // Stuff from CaliParamConfigSection
   goal = objectiveGoals[caliParamConfig->GetObjFunc()];
-#ifdef WIN32
-  srand(time(NULL));
-#else
-  srand48(time(NULL));
-#endif
+  SeedRNG(time(NULL));
   pointerMCMC = new DREAM_Parameters();
+  pointerMCMC->rng = rngState;
   pointerInput = new Model_Input();
   // DREAM Parameters
   pointerMCMC->n = numParams;
@@ -149,6 +178,13 @@ void DREAM::Initialize(CaliParamConfigSection *caliParamConfigNew,
   pointerInput->nPar = numParams;
   pointerInput->ParRangeMin = paramMins;
   pointerInput->ParRangeMax = paramMaxs;
+
+  // The rank histogram objective is not screened
+  useSurrogate = false;
+  surrogateSkip = new bool[pointerMCMC->seq];
+  surrogateExplored = new bool[pointerMCMC->seq];
+  memset(surrogateSkip, 0, sizeof(bool) * pointerMCMC->seq);
+  memset(surrogateExplored, 0, sizeof(bool) * pointerMCMC->seq);
 }
 
 void DREAM::CalibrateParams() {
@@ -185,6 +221,11 @@ void DREAM::CalibrateParams() {
   //------Initialize Variables: Call InitVar
   //routine-------------------------------//
   InitVar(pointerMCMC, &pointerRUNvar, &pointerOutput);
+  allocSteps = pointerMCMC->steps;
+  surrogateSimulated = 0;
+  surrogateScreened = 0;
+  surrogateExploredCount = 0;
+  surrogateExploredAccepted = 0;
   //------Check for Successful Memory
   //Allocation-----------------------------------//
   MEMORYCHECK(pointerRUNvar, "at dream.c: Memory Allocation for DREAM struct "
@@ -214,69 +255,97 @@ void DREAM::CalibrateParams() {
               "at dream.c: Memory Allocation for DREAM run variable "
               "Table_JumpRate not successfull\n");
 
-  //------Step 1: Sample s points in the parameter
-  //space---------------------------//  if Extra.InitPopulation = 'LHS_BASED'
-  // Latin hypercube sampling when indicated
-  allocate2D(&x, pointerMCMC->seq, pointerInput->nPar);
-  LHSU(&x, pointerInput->nPar, pointerInput->ParRangeMax,
-       pointerInput->ParRangeMin, pointerMCMC->seq);
-
-  // Step 2: Calculate posterior density associated with each value in x
-  allocate2D(&p, pointerMCMC->seq, 2);
-  // printf(" 0 allocating memory ...\n");
-  MEMORYCHECK(
-      p,
-      "at dream.c: Memory Allocation for DREAM variable p not successfull\n");
-  log_p = (float *)malloc(pointerMCMC->seq * sizeof(float));
-  // printf(" 1 allocating memory ...\n");
-  MEMORYCHECK(log_p, "at dream.c: Memory Allocation for DREAM variable log_p "
-                     "not successfull\n");
-  // printf(" 2 allocating memory ...\n");                   
-  CompDensity(p, log_p, x, pointerMCMC, pointerInput, 3);
-  // printf(" 3 allocating memory ...\n");
-  // Save the initial population, density and log density in one matrix X
+  // X holds the current population, density and log density of each chain
   allocate2D(&X, pointerMCMC->seq, pointerMCMC->n + 2);
-  // printf(" 4 allocating memory ...\n");
   MEMORYCHECK(
       X,
       "at dream.c: Memory Allocation for DREAM variable X not successfull\n");
-  for (i = 0; i < pointerMCMC->seq; i++) {
-    for (j = 0; j < pointerMCMC->n; j++) {
-      X[i][j] = x[i][j];
-    }
-    X[i][pointerInput->nPar] = p[i][0];
-    X[i][pointerInput->nPar + 1] = log_p[i];
-  }
-  // printf(" 5 allocating memory ...\n");
-  // Then initialize the sequences
-  // if save in memory = Yes
-  // printf("Start initializing sequences...\n");
-  InitSequences(X, pointerRUNvar->Sequences, pointerMCMC);
-
-  // Reduced sample collection if reduced_sample_collection = Yes
-  // iloc_2 = 0;
-
-  // Save N_CR in memory and initialize delta_tot
-  pointerOutput->CR[0][0] = pointerRUNvar->Iter;
-  for (i = 1; i < pointerMCMC->nCR + 1; i++) {
-    pointerOutput->CR[0][i] = pointerRUNvar->pCR[0][i - 1];
-  }
   delta_tot = (float *)malloc(pointerMCMC->nCR * sizeof(float));
   MEMORYCHECK(delta_tot, "at dream.c: Memory Allocation for DREAM variable "
                          "delta_tot not successfull\n");
-  for (i = 0; i < pointerMCMC->nCR; i++) {
-    delta_tot[i] = 0.0;
-  }
 
-  // Save history log density of individual chains
-  pointerRUNvar->hist_logp[0][0] = pointerRUNvar->Iter;
-  for (i = 1; i < pointerMCMC->seq + 1; i++) {
-    pointerRUNvar->hist_logp[0][i] = X[i - 1][pointerMCMC->n + 1];
+  // Pick up where a previous run left off if asked to
+  bool resumed = false;
+  if (checkpointFile && resumeCheckpoint) {
+    resumed = ReadCheckpoint(pointerOutput, X, delta_tot, &converged);
+    if (resumed) {
+      INFO_LOGF("Resuming DREAM from %s after %i simulations", checkpointFile,
+                pointerRUNvar->Iter);
+      if (useSurrogate && !surrogate.IsReady()) {
+        for (i = 0; i < pointerMCMC->seq; i++) {
+          surrogate.AddPoint(X[i], X[i][pointerInput->nPar]);
+        }
+        surrogate.Fit();
+      }
+    } else {
+      WARNING_LOGF("Unable to resume from checkpoint %s, starting over",
+                   checkpointFile);
+    }
   }
-  // Compute the R-statistic
-  pointerOutput->R_stat[0][0] = pointerRUNvar->Iter;
-  Gelman(pointerOutput->R_stat, 0, pointerRUNvar->Sequences,
-         pointerRUNvar->iloc, pointerMCMC->n, pointerMCMC->seq, 0);
+
+  if (!resumed) {
+    //------Step 1: Sample s points in the parameter
+    //space---------------------------//  if Extra.InitPopulation = 'LHS_BASED'
+    // Latin hypercube sampling when indicated
+    allocate2D(&x, pointerMCMC->seq, pointerInput->nPar);
+    LHSU(&x, pointerInput->nPar, pointerInput->ParRangeMax,
+         pointerInput->ParRangeMin, pointerMCMC->seq, rngState);
+
+    // Step 2: Calculate posterior density associated with each value in x
+    allocate2D(&p, pointerMCMC->seq, 2);
+    // printf(" 0 allocating memory ...\n");
+    MEMORYCHECK(
+        p,
+        "at dream.c: Memory Allocation for DREAM variable p not successfull\n");
+    log_p = (float *)malloc(pointerMCMC->seq * sizeof(float));
+    // printf(" 1 allocating memory ...\n");
+    MEMORYCHECK(log_p, "at dream.c: Memory Allocation for DREAM variable log_p "
+                       "not successfull\n");
+    // printf(" 2 allocating memory ...\n");                   
+    CompDensity(p, log_p, x, pointerMCMC, pointerInput, 3);
+    if (useSurrogate) {
+      for (i = 0; i < pointerMCMC->seq; i++) {
+        surrogate.AddPoint(x[i], p[i][0]);
+      }
+      surrogate.Fit();
+    }
+    // printf(" 3 allocating memory ...\n");
+    // Save the initial population, density and log density in one matrix X
+    for (i = 0; i < pointerMCMC->seq; i++) {
+      for (j = 0; j < pointerMCMC->n; j++) {
+        X[i][j] = x[i][j];
+      }
+      X[i][pointerInput->nPar] = p[i][0];
+      X[i][pointerInput->nPar + 1] = log_p[i];
+    }
+    // printf(" 5 allocating memory ...\n");
+    // Then initialize the sequences
+    // if save in memory = Yes
+    // printf("Start initializing sequences...\n");
+    InitSequences(X, pointerRUNvar->Sequences, pointerMCMC);
+
+    // Reduced sample collection if reduced_sample_collection = Yes
+    // iloc_2 = 0;
+
+    // Save N_CR in memory and initialize delta_tot
+    pointerOutput->CR[0][0] = pointerRUNvar->Iter;
+    for (i = 1; i < pointerMCMC->nCR + 1; i++) {
+      pointerOutput->CR[0][i] = pointerRUNvar->pCR[0][i - 1];
+    }
+    for (i = 0; i < pointerMCMC->nCR; i++) {
+      delta_tot[i] = 0.0;
+    }
+
+    // Save history log density of individual chains
+    pointerRUNvar->hist_logp[0][0] = pointerRUNvar->Iter;
+    for (i = 1; i < pointerMCMC->seq + 1; i++) {
+      pointerRUNvar->hist_logp[0][i] = X[i - 1][pointerMCMC->n + 1];
+    }
+    // Compute the R-statistic
+    pointerOutput->R_stat[0][0] = pointerRUNvar->Iter;
+    Gelman(pointerOutput->R_stat, 0, pointerRUNvar->Sequences,
+           pointerRUNvar->iloc, pointerMCMC->n, pointerMCMC->seq, 0);
+  } // if (!resumed)
 
   // printf("preparing allocate variables \n");
   // Allocate Variables
@@ -345,13 +414,26 @@ void DREAM::CalibrateParams() {
       offde(x_new, x_old, X, pointerRUNvar->CR, pointerMCMC,
             pointerRUNvar->Table_JumpRate, pointerInput, "Reflect", R2, "No");
 
+      // Let the surrogate weed out proposals that are bound to be rejected
+      if (useSurrogate) {
+        ScreenProposals(x_new, p_old);
+      }
+
       // Now compute the likelihood of the new points
       CompDensity(p_xnew, log_p_xnew, x_new, pointerMCMC, pointerInput, 3);
 
-      // Now apply the acceptance/rejectance rule for the chain itself
+      // Now apply the acceptance/rejectance rule for the chain itself. metrop
+      // only flags accepted chains, so clear last generation's flags first.
+      for (i = 0; i < pointerMCMC->seq; i++) {
+        accept[i] = 0.0;
+      }
       metrop(newgen, alpha12, accept, x_new, p_xnew, log_p_xnew, x_old, p_old,
              log_p_old, pointerInput, pointerMCMC, 3);
 
+      if (useSurrogate) {
+        UpdateSurrogate(x_new, p_xnew, accept);
+      }
+
       // Check whether we do delayed rejection or not
       // If DR = "Yes", then do compute several things. For this implementation
       // of DREAM,  We skipped said computations (i.e. DR = "No")
@@ -490,8 +572,20 @@ void DREAM::CalibrateParams() {
     if (converged) {
       INFO_LOGF("%s", "DREAM has converged on a solution!");
     }
+    if (useSurrogate) {
+      INFO_LOGF("Surrogate: %i simulated, %i screened out, %i explored (%i of "
+                "those accepted)",
+                surrogateSimulated, surrogateScreened, surrogateExploredCount,
+                surrogateExploredAccepted);
+    }
+
     // Update the Teller
     pointerRUNvar->teller = pointerRUNvar->teller + 1;
+
+    if (checkpointFile &&
+        !WriteCheckpoint(pointerOutput, X, delta_tot, converged)) {
+      WARNING_LOGF("Failed to write checkpoint %s", checkpointFile);
+    }
   } // while (pointerRUNvar->Iter < pointerMCMC->ndraw)
 
   // Deallocate preallocated memory here
@@ -570,34 +664,40 @@ void DREAM::CalibrateParams() {
 }
 
 void DREAM::WriteOutput(char *outputFile, MODELS model, ROUTES route,
-                        SNOWS snow) {
+                        SNOWS snow, float *bestParamsOut) {
   FILE *file = fopen(outputFile, "w");
   int i;
   float **ParSet;
   float *bestParams = new float[pointerMCMC->n];
-
-  for (i = 0; i < numModelParams[model]; i++) {
-    fprintf(file, "%s%s", (i == 0) ? "" : ",", modelParamStrings[model][i]);
-  }
-  int endi = numModelParams[model] + numRouteParams[route];
-  for (i = numModelParams[model]; i < endi; i++) {
-    fprintf(file, ",%s", routeParamStrings[route][i - numModelParams[model]]);
-  }
-
-  if (snow != SNOW_QTY) {
-    int starti = numModelParams[model] + numRouteParams[route];
-    int endi =
-        numModelParams[model] + numRouteParams[route] + numSnowParams[snow];
-    for (i = starti; i < endi; i++) {
-      fprintf(file, ",%s", snowParamStrings[snow][i - starti]);
+  int numWB = numModelParams[model], numR = numRouteParams[route];
+  int numS = (snow != SNOW_QTY) ? numSnowParams[snow] : 0;
+  int blockSize = numWB + numR + numS;
+  std::vector<GaugeConfigSection *> *caliGauges =
+      caliParamConfig->GetCaliGauges();
+
+  // With several calibration gauges each column is prefixed by its gauge
+  for (int b = 0; b < numCaliGauges; b++) {
+    char prefix[CONFIG_MAX_LEN + 1];
+    if (numCaliGauges > 1) {
+      sprintf(prefix, "%s:", caliGauges->at(b)->GetName());
+    } else {
+      prefix[0] = 0;
+    }
+    for (i = 0; i < numWB; i++) {
+      fprintf(file, "%s%s%s", (b == 0 && i == 0) ? "" : ",", prefix,
+              modelParamStrings[model][i]);
+    }
+    for (i = 0; i < numR; i++) {
+      fprintf(file, ",%s%s", prefix, routeParamStrings[route][i]);
+    }
+    for (i = 0; i < numS; i++) {
+      fprintf(file, ",%s%s", prefix, snowParamStrings[snow][i]);
     }
   }
 
   if (numParamsL > 0) {
-    int starti = numModelParams[model] + numRouteParams[route] + numParamsS;
-    int endi = numModelParams[model] + numRouteParams[route] + numParamsS + numParamsL;
-    for (i = starti; i < endi; i++) {
-      fprintf(file, ",%s", lakeParamStrings[0][i - starti]);
+    for (i = 0; i < numParamsL; i++) {
+      fprintf(file, ",%s", lakeParamStrings[0][i]);
     }
   }
 
@@ -619,38 +719,56 @@ void DREAM::WriteOutput(char *outputFile, MODELS model, ROUTES route,
    free(pointerRUNvar->Sequences);*/
   deallocate2D(&ParSet, post_Sequences * pointerMCMC->seq);
   // free(pointerRUNvar);
+
+  // Parameter blocks in the same gauge=/key=value form the param sets use
   fprintf(file, "[WaterBalance]\n");
-  for (i = 0; i < numModelParams[model]; i++) {
-    fprintf(file, "%s=%f\n", modelParamStrings[model][i], bestParams[i]);
+  for (int b = 0; b < numCaliGauges; b++) {
+    if (numCaliGauges > 1) {
+      fprintf(file, "gauge=%s\n", caliGauges->at(b)->GetName());
+    }
+    for (i = 0; i < numWB; i++) {
+      fprintf(file, "%s=%f\n", modelParamStrings[model][i],
+              bestParams[b * blockSize + i]);
+    }
   }
   fprintf(file, "[Routing]\n");
-  endi = numModelParams[model] + numRouteParams[route];
-  for (i = numModelParams[model]; i < endi; i++) {
-    fprintf(file, "%s=%f\n",
-            routeParamStrings[route][i - numModelParams[model]], bestParams[i]);
+  for (int b = 0; b < numCaliGauges; b++) {
+    if (numCaliGauges > 1) {
+      fprintf(file, "gauge=%s\n", caliGauges->at(b)->GetName());
+    }
+    for (i = 0; i < numR; i++) {
+      fprintf(file, "%s=%f\n", routeParamStrings[route][i],
+              bestParams[b * blockSize + numWB + i]);
+    }
   }
 
   if (snow != SNOW_QTY) {
     fprintf(file, "[Snow]\n");
-    int starti = numModelParams[model] + numRouteParams[route];
-    int endi =
-        numModelParams[model] + numRouteParams[route] + numSnowParams[snow];
-    for (i = starti; i < endi; i++) {
-      fprintf(file, "%s=%f\n", snowParamStrings[snow][i - starti],
-              bestParams[i]);
+    for (int b = 0; b < numCaliGauges; b++) {
+      if (numCaliGauges > 1) {
+        fprintf(file, "gauge=%s\n", caliGauges->at(b)->GetName());
+      }
+      for (i = 0; i < numS; i++) {
+        fprintf(file, "%s=%f\n", snowParamStrings[snow][i],
+                bestParams[b * blockSize + numWB + numR + i]);
+      }
     }
   }
 
   if (numParamsL > 0) {
     fprintf(file, "[Lake]\n");
-    int starti = numModelParams[model] + numRouteParams[route] + numParamsS;
-    int endi = numModelParams[model] + numRouteParams[route] + numParamsS + numParamsL;
-    for (i = starti; i < endi; i++) {
-      fprintf(file, "%s=%f\n", lakeParamStrings[0][i - starti],
-              bestParams[i]);
+    int starti = blockSize * numCaliGauges;
+    for (i = 0; i < numParamsL; i++) {
+      fprintf(file, "%s=%f\n", lakeParamStrings[0][i],
+              bestParams[starti + i]);
     }
   }
   fclose(file);
+
+  if (bestParamsOut) {
+    memcpy(bestParamsOut, bestParams, sizeof(float) * pointerMCMC->n);
+  }
+  delete[] bestParams;
 }
 
 void DREAM::CompDensity(float **p, float *log_p, float **x,
@@ -663,40 +781,78 @@ void DREAM::CompDensity(float **p, float *log_p, float **x,
 
   //#pragma omp parallel for private(objScore, i)
   if (!isEnsemble) {
-#if _OPENMP
-#pragma omp parallel for
-#endif
+    // Run the whole population through the simulator in lockstep, leaving
+    // out anything the surrogate screened
+    float *scores = new float[count];
+    float **runParams = new float *[count];
+    float *runScores = new float[count];
+    int numRun = 0;
     for (i = 0; i < count; i++) {
-      float score = sim->SimulateForCali(&(x[i][0]));
+      if (!surrogateSkip[i]) {
+        runParams[numRun] = x[i];
+        numRun++;
+      }
+    }
+    sim->SimulateForCaliBatch(runParams, numRun, runScores);
+    numRun = 0;
+    for (i = 0; i < count; i++) {
+      if (!surrogateSkip[i]) {
+        scores[i] = runScores[numRun];
+        numRun++;
+      }
+    }
+    delete[] runParams;
+    delete[] runScores;
+
+    for (i = 0; i < count; i++) {
+      // Screened out, or a parameter set the worker pool gave up on
+      if (surrogateSkip[i] || scores[i] != scores[i]) {
+        // Guarantees metrop rejects the proposal
+        p[i][0] = -FLT_MAX;
+        p[i][1] = i;
+        log_p[i] = -FLT_MAX;
+        continue;
+      }
+      float score = scores[i];
       objScore = ((goal == OBJECTIVE_GOAL_MINIMIZE) ? -1.0 : 1.0f) * score;
-#if _OPENMP
-      printf("%i (%i) %f\n", i, omp_get_thread_num(), score);
-#endif
       p[i][0] = objScore;
       p[i][1] = i;
       log_p[i] = 0.5 * objScore;
     }
+    delete[] scores;
   } else {
     // Ensemble calculate RHRE
     int numEns = (int)ensSims->size();
     int numObs = (int)ensSims->at(0).GetNumSteps();
     float *obsVals = ensSims->at(0).GetObsTS();
-    float *dischargeVals[numEns];
-    float currentDischargeSet[numEns];
-    int bin_tally[numEns + 1];
+    float **dischargeVals = new float *[count * numEns];
+    int *paramOffsets = new int[numEns];
 
-    for (i = 0; i < count; i++) {
-      int paramIndex = 0;
+    paramOffsets[0] = 0;
+    for (int j = 1; j < numEns; j++) {
+      paramOffsets[j] = paramOffsets[j - 1] + paramsPerSim->at(j - 1);
+    }
 
-      for (int z = 0; z < numEns + 1; z++) {
-        bin_tally[z] = 0;
-      }
+    // Every chain x member pair is an independent simulation. Member run times
+    // differ, so hand them out one at a time to whichever thread is free.
+    int numTasks = count * numEns;
+#if _OPENMP
+#pragma omp parallel for schedule(dynamic, 1)
+#endif
+    for (int task = 0; task < numTasks; task++) {
+      int chain = task / numEns, member = task % numEns;
+      dischargeVals[task] = ensSims->at(member).SimulateForCaliTS(
+          &(x[chain][paramOffsets[member]]));
+    }
 
-      for (int j = 0; j < numEns; j++) {
-        dischargeVals[j] =
-            ensSims->at(j).SimulateForCaliTS(&(x[i][paramIndex]));
-        paramIndex += paramsPerSim->at(j);
-      }
+    // Rank histogram of the observations within each chain's ensemble
+#if _OPENMP
+#pragma omp parallel for
+#endif
+    for (i = 0; i < count; i++) {
+      float **chainVals = &(dischargeVals[i * numEns]);
+      std::vector<float> currentDischargeSet(numEns);
+      std::vector<int> bin_tally(numEns + 1, 0);
 
       for (int j = 0; j < numObs; j++) {
         for (int k = 0; k < numEns; k++) {
@@ -704,26 +860,19 @@ void DREAM::CompDensity(float **p, float *log_p, float **x,
         }
 
         for (int k = 0; k < numEns; k++) {
-          float cVal = dischargeVals[k][j];
-          // printf("d%i: %f\n", k, cVal);
+          float cVal = chainVals[k][j];
           for (int z = numEns - 1; z >= 0; z--) {
-            // printf("test %f, %f, %i\n", cVal, currentDischargeSet[z], z);
             if (cVal >= currentDischargeSet[z]) {
               float tempVal = currentDischargeSet[z];
               currentDischargeSet[z] = cVal;
-              // printf("dSet%i: %f\n", k, cVal);
               cVal = tempVal;
               if (cVal == -9999) {
                 break;
               }
             }
           }
-          // currentDischargeSet[k] = dischargeVals[k][j];
         }
 
-        // printf("d: %f %f %f\n", currentDischargeSet[0],
-        // currentDischargeSet[1], currentDischargeSet[2]);
-
         float obsVal = obsVals[j];
         int bin;
         for (bin = numEns - 1; bin >= 0; bin--) {
@@ -741,21 +890,229 @@ void DREAM::CompDensity(float **p, float *log_p, float **x,
           distMax = bin_tally[z];
         }
       }
-      // printf("t: %i %i %i %i\n", bin_tally[0], bin_tally[1], bin_tally[2],
-      // bin_tally[3]);
       distMax /= ((float)(numObs));
-      objScore = fabs((distMax - distExpected) / distExpected) * 100.0;
-      // printf("%f %f %f %f\n", distExpected, distMax, objScore,
-      // (float)(numObs));
-      p[i][0] = -1 * objScore;
+      float chainScore = fabs((distMax - distExpected) / distExpected) * 100.0;
+      p[i][0] = -1 * chainScore;
       p[i][1] = i;
-      log_p[i] = -0.5 * objScore;
+      log_p[i] = -0.5 * chainScore;
 
       for (int j = 0; j < numEns; j++) {
-        delete[] dischargeVals[j];
+        delete[] chainVals[j];
       }
     }
 
+    delete[] dischargeVals;
+    delete[] paramOffsets;
     delete[] obsVals;
   }
 }
+
+// Predicts each proposal's density and works out the Metropolis acceptance
+// probability it would get (the SSE form used by metrop option 3). Unlikely
+// proposals are skipped, except for a random exploration fraction that is
+// simulated anyway so we can measure how often the screen is wrong.
+void DREAM::ScreenProposals(float **x_new, float *p_old) {
+  memset(surrogateSkip, 0, sizeof(bool) * pointerMCMC->seq);
+  memset(surrogateExplored, 0, sizeof(bool) * pointerMCMC->seq);
+  if (!surrogate.IsReady()) {
+    return;
+  }
+
+  float expt = -1.0 * (float)(pointerInput->MaxT) *
+               ((1 + pointerMCMC->Gamma) / 2);
+  for (int i = 0; i < pointerMCMC->seq; i++) {
+    float predicted = surrogate.Predict(x_new[i]);
+    float ratio = (predicted - 1.0) / (p_old[i] - 1.0);
+    if (!(ratio > 0.0) || powf(ratio, expt) >= SURROGATE_ALPHA_CUTOFF) {
+      continue;
+    }
+    if (SURROGATE_UNIFORM(rngState) < surrogateExplore) {
+      surrogateExplored[i] = true;
+      surrogateExploredCount++;
+    } else {
+      surrogateSkip[i] = true;
+      surrogateScreened++;
+    }
+  }
+}
+
+// Adds the newly simulated proposals to the training window and refits
+void DREAM::UpdateSurrogate(float **x_new, float **p_xnew, float *accept) {
+  for (int i = 0; i < pointerMCMC->seq; i++) {
+    if (surrogateSkip[i]) {
+      continue;
+    }
+    surrogateSimulated++;
+    if (surrogateExplored[i] && accept[i] > 0.0) {
+      surrogateExploredAccepted++;
+    }
+    if (p_xnew[i][0] == -FLT_MAX) {
+      continue; // failed evaluation, nothing to learn from
+    }
+    surrogate.AddPoint(x_new[i], p_xnew[i][0]);
+  }
+  surrogate.Fit();
+}
+
+static bool WriteRows(FILE *file, float **rows, int numRows, int numCols) {
+  for (int i = 0; i < numRows; i++) {
+    if (fwrite(rows[i], sizeof(float), numCols, file) != (size_t)numCols) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool ReadRows(FILE *file, float **rows, int numRows, int numCols) {
+  for (int i = 0; i < numRows; i++) {
+    if (fread(rows[i], sizeof(float), numCols, file) != (size_t)numCols) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Writes the full sampler state at the end of an outer DREAM iteration. The
+// array sizes mirror the allocations made in InitVar.
+bool DREAM::WriteCheckpoint(struct DREAM_Output *pointerOutput, float **X,
+                            float *delta_tot, bool converged) {
+  char tmpFile[CONFIG_MAX_LEN * 2];
+  sprintf(tmpFile, "%s.tmp", checkpointFile);
+
+  FILE *file = fopen(tmpFile, "wb");
+  if (!file) {
+    return false;
+  }
+
+  int n = pointerMCMC->n, seq = pointerMCMC->seq, nCR = pointerMCMC->nCR;
+  int nelem = pointerRUNvar->Nelem;
+  int statRows = floorf(nelem / allocSteps) + 10;
+  int header[14];
+  header[0] = DREAM_CHECKPOINT_MAGIC;
+  header[1] = n;
+  header[2] = seq;
+  header[3] = (int)pointerMCMC->ndraw;
+  header[4] = nCR;
+  header[5] = (int)pointerRUNvar->Iter;
+  header[6] = pointerRUNvar->counter;
+  header[7] = pointerRUNvar->teller;
+  header[8] = pointerRUNvar->new_teller;
+  header[9] = pointerRUNvar->iloc;
+  header[10] = pointerMCMC->steps;
+  header[11] = converged ? 1 : 0;
+  header[12] = useSurrogate ? surrogate.GetNumPoints() : 0;
+  header[13] = surrogate.GetNextSlot();
+
+  bool ok = (fwrite(header, sizeof(int), 14, file) == 14);
+  ok = ok && WriteRows(file, X, seq, n + 2);
+  ok = ok && (fwrite(delta_tot, sizeof(float), nCR, file) == (size_t)nCR);
+  ok = ok && WriteRows(file, pointerRUNvar->hist_logp, nelem - 1 + 20, seq + 1);
+  ok = ok && WriteRows(file, pointerRUNvar->pCR, 1, nCR);
+  ok = ok && WriteRows(file, pointerRUNvar->CR, seq, allocSteps);
+  ok = ok && (fwrite(pointerRUNvar->lCR, sizeof(float), nCR, file) ==
+              (size_t)nCR);
+  for (int i = 0; ok && i < pointerRUNvar->iloc; i++) {
+    ok = WriteRows(file, pointerRUNvar->Sequences[i], n + 2, seq);
+  }
+  ok = ok && WriteRows(file, pointerOutput->AR, nelem + 10, 2);
+  ok = ok && WriteRows(file, pointerOutput->R_stat, statRows, n + 1);
+  ok = ok && WriteRows(file, pointerOutput->CR, statRows, nCR + 1);
+  ok = ok && WriteRows(file, pointerOutput->outlier,
+                       (int)(pointerMCMC->ndraw + 1), 2);
+  ok = ok && WriteRNGState(file);
+  if (useSurrogate) {
+    ok = ok && surrogate.Write(file);
+  }
+  fclose(file);
+
+  // Only replace the previous checkpoint once this one is complete
+#ifdef _WIN32
+  // rename does not replace an existing file on Windows
+  if (ok) {
+    remove(checkpointFile);
+  }
+#endif
+  return ok && !rename(tmpFile, checkpointFile);
+}
+
+bool DREAM::ReadCheckpoint(struct DREAM_Output *pointerOutput, float **X,
+                           float *delta_tot, bool *converged) {
+  FILE *file = fopen(checkpointFile, "rb");
+  if (!file) {
+    return false;
+  }
+
+  int n = pointerMCMC->n, seq = pointerMCMC->seq, nCR = pointerMCMC->nCR;
+  int nelem = pointerRUNvar->Nelem;
+  int statRows = floorf(nelem / allocSteps) + 10;
+  int header[14];
+  if (fread(header, sizeof(int), 14, file) != 14 ||
+      header[0] != DREAM_CHECKPOINT_MAGIC || header[1] != n ||
+      header[2] != seq || header[3] != (int)pointerMCMC->ndraw ||
+      header[4] != nCR || header[9] > floorf(1.25 * (float)nelem) ||
+      header[12] > SURROGATE_MAX_POINTS) {
+    ERROR_LOGF("Checkpoint %s does not match this calibration",
+               checkpointFile);
+    fclose(file);
+    return false;
+  }
+
+  // Check the size up front so a truncated file is rejected before any of
+  // the freshly initialized sampler state gets overwritten
+  long expected = (long)(seq * (n + 2) + nCR + (nelem - 1 + 20) * (seq + 1) +
+                         nCR + seq * allocSteps + nCR +
+                         header[9] * (n + 2) * seq + (nelem + 10) * 2 +
+                         statRows * (n + 1) + statRows * (nCR + 1) +
+                         (pointerMCMC->ndraw + 1) * 2) *
+                  (long)sizeof(float);
+  expected += 3 * sizeof(unsigned short);
+  expected += (long)header[12] * (n + 1) * sizeof(double);
+  long start = ftell(file);
+  fseek(file, 0, SEEK_END);
+  if (ftell(file) - start != expected) {
+    ERROR_LOGF("Checkpoint %s is truncated", checkpointFile);
+    fclose(file);
+    return false;
+  }
+  fseek(file, start, SEEK_SET);
+
+  bool ok = ReadRows(file, X, seq, n + 2);
+  ok = ok && (fread(delta_tot, sizeof(float), nCR, file) == (size_t)nCR);
+  ok = ok && ReadRows(file, pointerRUNvar->hist_logp, nelem - 1 + 20, seq + 1);
+  ok = ok && ReadRows(file, pointerRUNvar->pCR, 1, nCR);
+  ok = ok && ReadRows(file, pointerRUNvar->CR, seq, allocSteps);
+  ok = ok && (fread(pointerRUNvar->lCR, sizeof(float), nCR, file) ==
+              (size_t)nCR);
+  for (int i = 0; ok && i < header[9]; i++) {
+    ok = ReadRows(file, pointerRUNvar->Sequences[i], n + 2, seq);
+  }
+  ok = ok && ReadRows(file, pointerOutput->AR, nelem + 10, 2);
+  ok = ok && ReadRows(file, pointerOutput->R_stat, statRows, n + 1);
+  ok = ok && ReadRows(file, pointerOutput->CR, statRows, nCR + 1);
+  ok = ok && ReadRows(file, pointerOutput->outlier,
+                      (int)(pointerMCMC->ndraw + 1), 2);
+  ok = ok && ReadRNGState(file);
+  // A checkpoint written with the surrogate off has no window to restore,
+  // CalibrateParams then trains one on the restored population
+  if (useSurrogate) {
+    ok = ok && surrogate.Read(file, header[12], header[13]);
+  } else if (header[12] > 0) {
+    ok = ok && !fseek(file, (long)header[12] * (n + 1) * sizeof(double),
+                      SEEK_CUR);
+  }
+  fclose(file);
+
+  if (!ok) {
+    ERROR_LOGF("Failed to read checkpoint %s", checkpointFile);
+    return false;
+  }
+
+  pointerRUNvar->Iter = header[5];
+  pointerRUNvar->counter = header[6];
+  pointerRUNvar->teller = header[7];
+  pointerRUNvar->new_teller = header[8];
+  pointerRUNvar->iloc = header[9];
+  pointerMCMC->steps = header[10];
+  *converged = (header[11] != 0);
+  return true;
+}
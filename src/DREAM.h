@@ -7,6 +7,7 @@
 #include "dream_variables.h"
 #include "misc_functions.h"
 #include "LakeCaliParamConfigSection.h"
+#include "RBFSurrogate.h"
 
 class DREAM : public Calibrate {
 public:
@@ -21,12 +22,20 @@ public:
                   std::vector<Simulator> *ensSimsNew,
                   std::vector<int> *paramsPerSimNew);
   void CalibrateParams();
-  void WriteOutput(char *outputFile, MODELS model, ROUTES route, SNOWS snow);
+  // bestParamsOut, if given, receives the best parameter set written out
+  void WriteOutput(char *outputFile, MODELS model, ROUTES route, SNOWS snow,
+                   float *bestParamsOut = NULL);
 
 private:
   void CompDensity(float **p, float *log_p, float **x,
                    struct DREAM_Parameters *MCMC, struct Model_Input *Input,
                    int option);
+  void ScreenProposals(float **x_new, float *p_old);
+  void UpdateSurrogate(float **x_new, float **p_xnew, float *accept);
+  bool WriteCheckpoint(struct DREAM_Output *pointerOutput, float **X,
+                       float *delta_tot, bool converged);
+  bool ReadCheckpoint(struct DREAM_Output *pointerOutput, float **X,
+                      float *delta_tot, bool *converged);
 
   float *minParams;
   float *maxParams;
@@ -45,6 +54,15 @@ private:
   Simulator *sim;
 
   int post_Sequences;
+
+  // Optional surrogate pre-screening of proposals
+  bool useSurrogate;
+  float surrogateExplore;
+  RBFSurrogate surrogate;
+  bool *surrogateSkip, *surrogateExplored;
+  int surrogateSimulated, surrogateScreened, surrogateExploredCount,
+      surrogateExploredAccepted;
+  int allocSteps;
   struct DREAM_Variables *pointerRUNvar;
 };
 
@@ -3,6 +3,8 @@
 #include "BasicConfigSection.h"
 #include "BasicGrids.h"
 #include "BasinConfigSection.h"
+#include "CacheHash.h"
+#include "CaliWorkerPool.h"
 #include "DREAM.h"
 #include "EnsTaskConfigSection.h"
 #include "ExecuteConfigSection.h"
@@ -21,8 +23,12 @@
 #include "TaskConfigSection.h"
 #include "TempConfigSection.h"
 #include "TimeVar.h"
+#include <algorithm>
+#include <cmath>
 #include <cstdio>
 #include <cstring>
+#include <ctime>
+#include <list>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <string>
@@ -46,6 +52,7 @@ static void ExecuteSimulationRP(TaskConfigSection *task);
 static void ExecuteCalibrationARS(TaskConfigSection *task);
 static void ExecuteCalibrationDREAM(TaskConfigSection *task);
 static void ExecuteCalibrationDREAMPixel(TaskConfigSection *task);
+static void ExecuteCalibrationCascade(TaskConfigSection *task);
 static void ExecuteCalibrationDREAMEns(EnsTaskConfigSection *task);
 static void ExecuteClipBasin(TaskConfigSection *task);
 static void ExecuteClipGauge(TaskConfigSection *task);
@@ -120,6 +127,9 @@ void ExecuteTasks() {
     case STYLE_CALI_DREAM_PIXEL:
       ExecuteCalibrationDREAMPixel(task);
       break;
+    case STYLE_CALI_CASCADE:
+      ExecuteCalibrationCascade(task);
+      break;
     case STYLE_CLIP_BASIN:
       ExecuteClipBasin(task);
       break;
@@ -211,6 +221,7 @@ void ExecuteCalibrationARS(TaskConfigSection *task) {
                  task->GetSnowCaliParamSec(), task->GetLakeCaliParamSec(),
                  numModelParams[task->GetModel()],
                  numRouteParams[task->GetRouting()], numSnow, numLake, &sim);
+  ars.SetCheckpoint(task->GetCheckpointFile(), task->ResumeCheckpoint());
   ars.CalibrateParams();
 
   sprintf(buffer, "%s/cali_ars.%s.%s.csv", task->GetOutput(),
@@ -243,7 +254,25 @@ void ExecuteCalibrationDREAM(TaskConfigSection *task) {
                    task->GetSnowCaliParamSec(), task->GetLakeCaliParamSec(),
                    numModelParams[task->GetModel()],
                    numRouteParams[task->GetRouting()], numSnow, numLake, &sim);
+  dream.SetCheckpoint(task->GetCheckpointFile(), task->ResumeCheckpoint());
+
+  // Workers are forked only now so they share the preloaded forcings
+  CaliWorkerPool workerPool;
+  int numWorkers = task->GetCaliParamSec()->DREAMGetWorkers();
+  if (numWorkers > 0 &&
+      workerPool.Start(&sim, numWorkers, dream.GetNumParams())) {
+    sim.SetWorkerPool(&workerPool);
+  }
+
   dream.CalibrateParams();
+  if (workerPool.GetNumWorkers() > 0) {
+    if (workerPool.GetNumRestarts() > 0) {
+      WARNING_LOGF("Calibration workers were restarted %i times",
+                   workerPool.GetNumRestarts());
+    }
+    sim.SetWorkerPool(NULL);
+    workerPool.Stop();
+  }
 
   sprintf(buffer, "%s/cali_dream.%s.%s.csv", task->GetOutput(),
           task->GetCaliParamSec()->GetGauge()->GetName(),
@@ -261,14 +290,466 @@ void ExecuteCalibrationDREAMPixel(TaskConfigSection *task) {
   char buffer[CONFIG_MAX_LEN * 2];
 
   sim.Initialize(task);
-  sprintf(buffer, "%s/%s", task->GetOutput(), "califorcings.bin");
-  sim.PreloadForcings(buffer, true);
+  // A node-major cache from an earlier run replaces the preloaded forcings
+  sprintf(buffer, "%s/%s", task->GetOutput(), "pixelforcings.bin");
+  if (!sim.LoadPixelForcings(buffer, task)) {
+    sprintf(buffer, "%s/%s", task->GetOutput(), "califorcings.bin");
+    sim.PreloadForcings(buffer, true);
+  }
 
   INFO_LOGF("%s", "Precip loaded! Beginning per-pixel calibration.");
 
   sim.CalibratePerPixel(task);
 }
 
+#define CASCADE_CACHE_MAGIC 0x43534332 // "CSC2"
+
+// What every stage of a task is built from: the basic grids and the forcing
+// sources. Hashing the grids is not free, so this is done once.
+static unsigned long long CascadeSourceKey(TaskConfigSection *task) {
+  unsigned long long hash = CACHE_HASH_BASIS;
+  HashBasicGrids(&hash);
+  Simulator::HashForcingSources(task, &hash);
+  return hash;
+}
+
+// The gauge's observation file is hashed whole, a corrected record has to
+// recalibrate the stage
+static void HashObservations(unsigned long long *hash,
+                             GaugeConfigSection *gauge) {
+  HashString(hash, gauge->GetObservationFile());
+  FILE *fp = fopen(gauge->GetObservationFile(), "rb");
+  if (!fp) {
+    return;
+  }
+  char buffer[65536];
+  size_t count;
+  while ((count = fread(buffer, 1, sizeof(buffer), fp)) > 0) {
+    HashBytes(hash, buffer, count);
+  }
+  fclose(fp);
+}
+
+// Everything a stage's result depends on: the task's sources, the gauge's
+// observations, the run period, the models and objective, the parameter
+// ranges searched and the outflow fed in at each of its boundaries.
+static unsigned long long
+CascadeKey(TaskConfigSection *task, unsigned long long sourceKey,
+           GaugeConfigSection *gauge, int numWB, int numR, int numSnow,
+           int numLake, std::vector<std::vector<float> *> *inflows) {
+  unsigned long long hash = sourceKey;
+  HashString(&hash, gauge->GetName());
+  HashObservations(&hash, gauge);
+  time_t times[3] = {task->GetTimeBegin()->currentTimeSec,
+                     task->GetTimeWarmEnd()->currentTimeSec,
+                     task->GetTimeEnd()->currentTimeSec};
+  HashBytes(&hash, times, sizeof(times));
+  unsigned long stepSeconds = task->GetTimeStep()->GetTimeInSec();
+  HashBytes(&hash, &stepSeconds, sizeof(stepSeconds));
+  int setup[5] = {task->GetModel(), task->GetRouting(), task->GetSnow(),
+                  task->GetCaliParamSec()->GetObjFunc(),
+                  task->GetCaliParamSec()->DREAMGetNDraw()};
+  HashBytes(&hash, setup, sizeof(setup));
+
+  HashBytes(&hash, task->GetCaliParamSec()->GetParamMins(),
+            sizeof(float) * numWB);
+  HashBytes(&hash, task->GetCaliParamSec()->GetParamMaxs(),
+            sizeof(float) * numWB);
+  HashBytes(&hash, task->GetRoutingCaliParamSec()->GetParamMins(),
+            sizeof(float) * numR);
+  HashBytes(&hash, task->GetRoutingCaliParamSec()->GetParamMaxs(),
+            sizeof(float) * numR);
+  if (numSnow > 0) {
+    HashBytes(&hash, task->GetSnowCaliParamSec()->GetParamMins(),
+              sizeof(float) * numSnow);
+    HashBytes(&hash, task->GetSnowCaliParamSec()->GetParamMaxs(),
+              sizeof(float) * numSnow);
+  }
+  if (numLake > 0) {
+    HashBytes(&hash, task->GetLakeCaliParamSec()->GetParamMins(),
+              sizeof(float) * numLake);
+    HashBytes(&hash, task->GetLakeCaliParamSec()->GetParamMaxs(),
+              sizeof(float) * numLake);
+  }
+
+  for (size_t b = 0; b < inflows->size(); b++) {
+    std::vector<float> *series = inflows->at(b);
+    HashBytes(&hash, &(series->at(0)), sizeof(float) * series->size());
+  }
+  return hash;
+}
+
+// A finished cascade stage: its best parameters and the gauge discharge for
+// every time step of the run, warm up included.
+static bool WriteCascadeCache(const char *file, unsigned long long key,
+                              std::vector<float> *params,
+                              std::vector<float> *series) {
+  char tmpFile[CONFIG_MAX_LEN * 2 + 4];
+  sprintf(tmpFile, "%s.tmp", file);
+  FILE *fp = fopen(tmpFile, "wb");
+  if (!fp) {
+    ERROR_LOGF("Failed to open cascade cache file \"%s\" for writing!",
+               tmpFile);
+    return false;
+  }
+
+  int header[3] = {CASCADE_CACHE_MAGIC, (int)params->size(),
+                   (int)series->size()};
+  bool ok = (fwrite(header, sizeof(int), 3, fp) == 3 &&
+             fwrite(&key, sizeof(key), 1, fp) == 1 &&
+             fwrite(&(params->at(0)), sizeof(float), params->size(), fp) ==
+                 params->size() &&
+             fwrite(&(series->at(0)), sizeof(float), series->size(), fp) ==
+                 series->size());
+  ok = (fclose(fp) == 0) && ok;
+#ifdef _WIN32
+  // rename does not replace an existing file on Windows
+  if (ok) {
+    remove(file);
+  }
+#endif
+  if (!ok || rename(tmpFile, file) != 0) {
+    ERROR_LOGF("Failed to write cascade cache file \"%s\"!", file);
+    remove(tmpFile);
+    return false;
+  }
+  return true;
+}
+
+static bool ReadCascadeCache(const char *file, unsigned long long key,
+                             int numParams, size_t numSteps,
+                             std::vector<float> *params,
+                             std::vector<float> *series) {
+  FILE *fp = fopen(file, "rb");
+  if (!fp) {
+    return false;
+  }
+
+  int header[3];
+  unsigned long long fileKey;
+  bool ok = (fread(header, sizeof(int), 3, fp) == 3 &&
+             header[0] == CASCADE_CACHE_MAGIC && header[1] == numParams &&
+             header[2] == (int)numSteps &&
+             fread(&fileKey, sizeof(fileKey), 1, fp) == 1 && fileKey == key);
+  if (ok) {
+    params->resize(numParams);
+    series->resize(numSteps);
+    ok = (fread(&(params->at(0)), sizeof(float), numParams, fp) ==
+              (size_t)numParams &&
+          fread(&(series->at(0)), sizeof(float), numSteps, fp) == numSteps);
+  }
+  fclose(fp);
+
+  if (!ok) {
+    WARNING_LOGF("Ignoring cascade cache file \"%s\", it does not match this "
+                 "task",
+                 file);
+  }
+  return ok;
+}
+
+// Runs the whole basin once with every stage's best parameters. Apart from
+// interflow that the uncut run leaks past a boundary gauge, the calibration
+// gauge's discharge should be what its cascade stage produced.
+static void CheckCascadeOutflow(TaskConfigSection *task,
+                                std::vector<GaugeConfigSection *> *caliGauges,
+                                std::vector<std::vector<float> > *stageParams,
+                                std::vector<std::vector<float> > *outflows,
+                                int blockSize) {
+  GaugeConfigSection *outlet = task->GetCaliParamSec()->GetGauge();
+  std::vector<GaugeConfigSection *>::iterator itr =
+      std::find(caliGauges->begin(), caliGauges->end(), outlet);
+  if (itr == caliGauges->end()) {
+    return;
+  }
+  std::vector<float> *cascadeQ = &(outflows->at(itr - caliGauges->begin()));
+
+  // One parameter block per calibration gauge, then the shared lake block
+  std::vector<float> params;
+  for (size_t s = 0; s < caliGauges->size(); s++) {
+    params.insert(params.end(), stageParams->at(s).begin(),
+                  stageParams->at(s).begin() + blockSize);
+  }
+  params.insert(params.end(), stageParams->back().begin() + blockSize,
+                stageParams->back().end());
+
+  Simulator sim;
+  char buffer[CONFIG_MAX_LEN * 2];
+  if (!sim.Initialize(task)) {
+    WARNING_LOGF("%s", "Failed to set up the uncut run, the cascade is not "
+                       "checked");
+    return;
+  }
+  sprintf(buffer, "%s/%s", task->GetOutput(), "califorcings.bin");
+  sim.PreloadForcings(buffer, true);
+  std::vector<float> uncutQ;
+  sim.SimulateForCali(&(params[0]), &uncutQ);
+
+  float maxDiff = 0.0, peak = 0.0;
+  for (size_t i = 0; i < uncutQ.size() && i < cascadeQ->size(); i++) {
+    maxDiff = std::max(maxDiff, fabsf(uncutQ[i] - cascadeQ->at(i)));
+    peak = std::max(peak, fabsf(uncutQ[i]));
+  }
+  float relDiff = (peak > 0.0) ? maxDiff / peak : maxDiff;
+  if (uncutQ.size() != cascadeQ->size() || relDiff > 0.01) {
+    WARNING_LOGF("Cascade outflow at gauge %s differs from an uncut run by up "
+                 "to %f cms (peak %f cms)",
+                 outlet->GetName(), maxDiff, peak);
+  } else {
+    INFO_LOGF("Cascade outflow at gauge %s matches an uncut run to within %f "
+              "cms (peak %f cms)",
+              outlet->GetName(), maxDiff, peak);
+  }
+}
+
+static bool IsInList(std::vector<GaugeConfigSection *> *list,
+                     GaugeConfigSection *gauge) {
+  return (list &&
+          std::find(list->begin(), list->end(), gauge) != list->end());
+}
+
+// Calibrates the cali_gauges of a task one sub-basin at a time, headwaters
+// first. A stage only simulates the area between its gauge and the calibrated
+// gauges directly upstream of it, whose recorded best-parameter outflow is
+// fed in where the carve was cut off. Stages on the same level of the gauge
+// tree are independent and run concurrently.
+void ExecuteCalibrationCascade(TaskConfigSection *task) {
+  std::map<GaugeConfigSection *, float *> fullParamSettings, *paramSettings,
+      fullRouteParamSettings, *routeParamSettings;
+  std::vector<GridNode> nodes;
+  GaugeMap gaugeMap;
+  char buffer[CONFIG_MAX_LEN * 2];
+
+  // Carve the whole basin once to find out how the calibration gauges nest
+  paramSettings = task->GetParamsSec()->GetParamSettings();
+  float *defaultParams = NULL, *defaultRouteParams = NULL;
+  GaugeConfigSection *gs = task->GetDefaultGauge();
+  std::map<GaugeConfigSection *, float *>::iterator pitr =
+      paramSettings->find(gs);
+  if (pitr != paramSettings->end()) {
+    defaultParams = pitr->second;
+  }
+  routeParamSettings = task->GetRoutingParamsSec()->GetParamSettings();
+  pitr = routeParamSettings->find(gs);
+  if (pitr != routeParamSettings->end()) {
+    defaultRouteParams = pitr->second;
+  }
+
+  CarveBasin(task->GetBasinSec(), &nodes, paramSettings, &fullParamSettings,
+             &gaugeMap, defaultParams, routeParamSettings,
+             &fullRouteParamSettings, defaultRouteParams, NULL, NULL, NULL,
+             NULL, NULL, NULL);
+
+  std::vector<GaugeConfigSection *> caliGauges =
+      *(task->GetCaliParamSec()->GetCaliGauges());
+  size_t numStages = caliGauges.size();
+  std::vector<std::vector<GaugeConfigSection *> *> upstream(numStages);
+  for (size_t s = 0; s < numStages; s++) {
+    upstream[s] = gaugeMap.GetUpstreamGauges(caliGauges[s]);
+    if (!upstream[s]) {
+      ERROR_LOGF("Calibration gauge \"%s\" is not in the basin!",
+                 caliGauges[s]->GetName());
+      return;
+    }
+  }
+
+  // The boundaries of a stage are the calibration gauges directly upstream of
+  // it, i.e. not upstream of another calibration gauge that is
+  std::vector<std::vector<size_t> > boundaries(numStages);
+  for (size_t s = 0; s < numStages; s++) {
+    for (size_t u = 0; u < numStages; u++) {
+      if (u == s || !IsInList(upstream[s], caliGauges[u])) {
+        continue;
+      }
+      bool direct = true;
+      for (size_t v = 0; v < numStages && direct; v++) {
+        if (v != u && v != s && IsInList(upstream[s], caliGauges[v]) &&
+            IsInList(upstream[v], caliGauges[u])) {
+          direct = false;
+        }
+      }
+      if (direct) {
+        boundaries[s].push_back(u);
+      }
+    }
+  }
+
+  // Headwater stages are level 0, every other stage runs one level after the
+  // last of its boundaries
+  std::vector<int> levels(numStages, -1);
+  int numLevels = 0;
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (size_t s = 0; s < numStages; s++) {
+      if (levels[s] >= 0) {
+        continue;
+      }
+      int level = 0;
+      for (size_t b = 0; b < boundaries[s].size() && level >= 0; b++) {
+        int boundaryLevel = levels[boundaries[s][b]];
+        level = (boundaryLevel < 0) ? -1 : std::max(level, boundaryLevel + 1);
+      }
+      if (level >= 0) {
+        levels[s] = level;
+        numLevels = std::max(numLevels, level + 1);
+        changed = true;
+      }
+    }
+  }
+
+  // Each stage carves its gauge plus whatever gauges lie in its own
+  // incremental area, down to and including its boundaries
+  std::vector<std::vector<GaugeConfigSection *> > stageGauges(numStages);
+  for (size_t s = 0; s < numStages; s++) {
+    stageGauges[s].push_back(caliGauges[s]);
+    for (size_t i = 0; i < upstream[s]->size(); i++) {
+      GaugeConfigSection *gauge = upstream[s]->at(i);
+      bool inside = true;
+      for (size_t b = 0; b < boundaries[s].size() && inside; b++) {
+        inside = !IsInList(upstream[boundaries[s][b]], gauge);
+      }
+      if (inside) {
+        stageGauges[s].push_back(gauge);
+      }
+    }
+  }
+
+  int numSnow = 0;
+  if (task->GetSnow() != SNOW_QTY) {
+    numSnow = numSnowParams[task->GetSnow()];
+  }
+  int numLake = 0;
+  if (task->IsLakeModuleEnabled() && task->GetLakeCaliParamSec()) {
+    numLake = numLakeParams[0]; // Assuming lake parameters are the same for all lake types
+  }
+  int numWB = numModelParams[task->GetModel()];
+  int numR = numRouteParams[task->GetRouting()];
+  int numStageParams = numWB + numR + numSnow + numLake;
+
+  size_t numSteps = 0;
+  TimeVar stepTime = *(task->GetTimeBegin());
+  for (stepTime.Increment(task->GetTimeStep());
+       stepTime <= *(task->GetTimeEnd());
+       stepTime.Increment(task->GetTimeStep())) {
+    numSteps++;
+  }
+
+  std::vector<std::vector<float> > outflows(numStages), stageParams(numStages);
+  std::vector<unsigned long long> stageKeys(numStages);
+  unsigned long long sourceKey = CascadeSourceKey(task);
+  for (int level = 0; level < numLevels; level++) {
+    std::vector<size_t> pending;
+    std::vector<Simulator *> sims;
+    std::list<Simulator> stageSims;
+    std::list<TaskConfigSection> stageTasks;
+    std::list<BasinConfigSection> stageBasins;
+    bool failed = false;
+
+    // Stages are set up one at a time since carving touches the gauges
+    for (size_t s = 0; s < numStages && !failed; s++) {
+      if (levels[s] != level) {
+        continue;
+      }
+      GaugeConfigSection *gauge = caliGauges[s];
+      std::vector<std::vector<float> *> inflows;
+      for (size_t b = 0; b < boundaries[s].size(); b++) {
+        inflows.push_back(&(outflows[boundaries[s][b]]));
+      }
+      stageKeys[s] = CascadeKey(task, sourceKey, gauge, numWB, numR, numSnow,
+                                numLake, &inflows);
+      sprintf(buffer, "%s/cascade.%s.bin", task->GetOutput(), gauge->GetName());
+      if (ReadCascadeCache(buffer, stageKeys[s], numStageParams, numSteps,
+                           &(stageParams[s]), &(outflows[s]))) {
+        INFO_LOGF("Using the cached outflow for gauge %s", gauge->GetName());
+        continue;
+      }
+
+      stageBasins.push_back(*(task->GetBasinSec()));
+      BasinConfigSection *stageBasin = &(stageBasins.back());
+      *(stageBasin->GetGauges()) = stageGauges[s];
+      stageTasks.push_back(*task);
+      TaskConfigSection *stageTask = &(stageTasks.back());
+      stageTask->SetBasinSec(stageBasin);
+      stageSims.push_back(Simulator());
+      Simulator *sim = &(stageSims.back());
+      sim->SetCaliGauge(gauge);
+      sims.push_back(sim);
+
+      // Stop the carve at the boundaries, the upstream stages stand in there
+      std::vector<bool> continueUpstream(boundaries[s].size());
+      for (size_t b = 0; b < boundaries[s].size(); b++) {
+        GaugeConfigSection *boundary = caliGauges[boundaries[s][b]];
+        continueUpstream[b] = boundary->ContinueUpstream();
+        boundary->SetContinueUpstream(false);
+      }
+      bool initialized = sim->Initialize(stageTask);
+      for (size_t b = 0; b < boundaries[s].size(); b++) {
+        GaugeConfigSection *boundary = caliGauges[boundaries[s][b]];
+        boundary->SetContinueUpstream(continueUpstream[b]);
+        if (initialized) {
+          sim->AddCascadeInflow(boundary, &(outflows[boundaries[s][b]]));
+        }
+      }
+      if (!initialized) {
+        ERROR_LOGF("Failed to set up the cascade stage for gauge %s",
+                   gauge->GetName());
+        failed = true;
+        break;
+      }
+
+      INFO_LOGF("Cascade level %i: gauge %s with %lu upstream boundaries",
+                level, gauge->GetName(),
+                (unsigned long)boundaries[s].size());
+      sprintf(buffer, "%s/califorcings.%s.bin", task->GetOutput(),
+              gauge->GetName());
+      sim->PreloadForcings(buffer, true);
+      pending.push_back(s);
+    }
+
+    // Each stage's DREAM has its own random stream, offset by the stage so
+    // stages started in the same second do not draw the same proposals
+    int numPending = failed ? 0 : (int)pending.size();
+#if _OPENMP
+#pragma omp parallel for schedule(dynamic, 1)
+#endif
+    for (int p = 0; p < numPending; p++) {
+      size_t s = pending[p];
+      GaugeConfigSection *gauge = caliGauges[s];
+      char stageBuffer[CONFIG_MAX_LEN * 2];
+      std::vector<float> *bestParams = &(stageParams[s]);
+      bestParams->resize(numStageParams);
+
+      DREAM dream;
+      dream.Initialize(task->GetCaliParamSec(), task->GetRoutingCaliParamSec(),
+                       task->GetSnowCaliParamSec(), task->GetLakeCaliParamSec(),
+                       numWB, numR, numSnow, numLake, sims[p]);
+      dream.SeedRNG((unsigned long)time(NULL) + (unsigned long)s);
+      dream.CalibrateParams();
+
+      sprintf(stageBuffer, "%s/cali_dream.%s.%s.csv", task->GetOutput(),
+              gauge->GetName(), modelStrings[task->GetModel()]);
+      dream.WriteOutput(stageBuffer, task->GetModel(), task->GetRouting(),
+                        task->GetSnow(), &(bestParams->at(0)));
+
+      // Freeze this stage's outflow for the stages downstream of it
+      sims[p]->SimulateForCali(&(bestParams->at(0)), &(outflows[s]));
+      sprintf(stageBuffer, "%s/cascade.%s.bin", task->GetOutput(),
+              gauge->GetName());
+      WriteCascadeCache(stageBuffer, stageKeys[s], bestParams,
+                        &(outflows[s]));
+    }
+
+    if (failed) {
+      return;
+    }
+  }
+
+  if (numLevels > 1) {
+    CheckCascadeOutflow(task, &caliGauges, &stageParams, &outflows,
+                        numWB + numR + numSnow);
+  }
+}
+
 void ExecuteCalibrationDREAMEns(EnsTaskConfigSection *task) {
 
   char buffer[CONFIG_MAX_LEN * 2];
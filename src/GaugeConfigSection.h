@@ -24,6 +24,7 @@ public:
   bool WantDA() { return wantDA; }
   bool WantCO() { return wantCO; }
   bool ContinueUpstream() { return continueUpstream; }
+  void SetContinueUpstream(bool newVal) { continueUpstream = newVal; }
   long GetFlowAccum() { return flowAccum; }
   bool HasObsFlowAccum() { return obsFlowAccumSet; }
   float GetObsFlowAccum() { return obsFlowAccum; }
@@ -32,6 +33,7 @@ public:
   float GetObserved(TimeVar *currentTime, float diff);
   void SetObservedValue(char *timeBuffer, float dataValue);
   void LoadTS();
+  char *GetObservationFile() { return observation; }
   void SetGridNodeIndex(long newVal) { gridNodeIndex = newVal; }
   void SetLat(float newVal) { lat = newVal; }
   void SetLon(float newVal) { lon = newVal; }
@@ -5,6 +5,14 @@
 #include <sstream>
 #include <algorithm>
 #include <cctype>
+#if _OPENMP
+#include <omp.h>
+#endif
+
+// Most nodes summed as one unit of work. The sums do not depend on the
+// number of threads, and a gauge with no more nodes than this is summed in
+// the same order as a plain loop over the nodes.
+#define GAUGE_CHUNK_SIZE 65536
 
 void GaugeMap::Initialize(std::vector<GaugeConfigSection *> *newGauges) {
   // Copy the list of gauges over to internal storage
@@ -14,111 +22,185 @@ void GaugeMap::Initialize(std::vector<GaugeConfigSection *> *newGauges) {
 
   // Resize the outer vector in the tree that contains all of the interior
   // gauges
+  gaugeTree.clear();
   gaugeTree.resize(countGauges);
+  downGauges.assign(countGauges, -1);
 
   // Initialize the map that contains the index into a vector for each
   // GaugeConfigSection *
+  gaugeMap.clear();
   for (size_t i = 0; i < countGauges; i++) {
     gaugeMap[gauges[i]] = i;
   }
 
-  // Initialize storage for the partial values contributing to each gauge
-  partialVal.resize(countGauges);
-  partialArea.resize(countGauges);
+  prepared = false;
 }
 
 void GaugeMap::AddUpstreamGauge(GaugeConfigSection *downStream,
                                 GaugeConfigSection *upStream) {
-  size_t countGauges = gauges.size();
-  for (size_t i = 0; i < countGauges; i++) {
-    if (gauges[i] == downStream) {
-      printf("%s is upstream(direct) of %s\n", upStream->GetName(),
-             downStream->GetName());
-      gaugeTree[i].push_back(upStream);
-    }
+  std::map<GaugeConfigSection *, size_t>::iterator down =
+      gaugeMap.find(downStream);
+  std::map<GaugeConfigSection *, size_t>::iterator up = gaugeMap.find(upStream);
+  if (down == gaugeMap.end() || up == gaugeMap.end()) {
+    return;
   }
 
-  for (size_t i = 0; i < countGauges; i++) {
-    std::vector<GaugeConfigSection *> *intGauges = &(gaugeTree[i]);
-    for (size_t j = 0; j < intGauges->size(); j++) {
-      if (intGauges->at(j) == downStream) {
-        printf("%s is upstream(indirect) of %s\n", upStream->GetName(),
-               gauges[j]->GetName());
-        intGauges->push_back(upStream);
-      }
-    }
+  // upStream is directly upstream of downStream and indirectly upstream of
+  // every gauge downStream is upstream of
+  for (long i = (long)down->second; i >= 0; i = downGauges[i]) {
+    gaugeTree[i].push_back(upStream);
   }
+  downGauges[up->second] = (long)down->second;
+  prepared = false;
 }
 
-void GaugeMap::GaugeAverage(std::vector<GridNode> *nodes,
-                            std::vector<float> *currentValue,
-                            std::vector<float> *gaugeAvg) {
+void GaugeMap::Prepare(std::vector<GridNode> *nodes) {
   size_t countGauges = gauges.size();
   size_t countNodes = nodes->size();
 
-  // Zero out the partial vectors
+  // Nodes of each gauge in ascending order, by counting sort. Nodes with a
+  // gauge outside the map count towards the first gauge.
+  std::vector<size_t> nodeGauges(countNodes);
+  std::vector<size_t> firstNode(countGauges + 1, 0);
+  for (size_t i = 0; i < countNodes; i++) {
+    std::map<GaugeConfigSection *, size_t>::iterator itr =
+        gaugeMap.find((*nodes)[i].gauge);
+    nodeGauges[i] = (itr != gaugeMap.end()) ? itr->second : 0;
+    firstNode[nodeGauges[i] + 1]++;
+  }
   for (size_t i = 0; i < countGauges; i++) {
-    partialVal[i] = 0;
-    partialArea[i] = 0;
+    firstNode[i + 1] += firstNode[i];
   }
-
-  // Add up contributions to each gauge
+  gaugeNodes.resize(countNodes);
+  std::vector<size_t> fill(firstNode.begin(), firstNode.end() - 1);
   for (size_t i = 0; i < countNodes; i++) {
-    GridNode *node = &((*nodes)[i]);
-    size_t gaugeIndex = gaugeMap[node->gauge];
-    partialVal[gaugeIndex] += ((*currentValue)[i] * node->area);
-    partialArea[gaugeIndex] += node->area;
+    gaugeNodes[fill[nodeGauges[i]]++] = i;
   }
 
+  chunkStart.clear();
+  firstChunk.resize(countGauges + 1);
   for (size_t i = 0; i < countGauges; i++) {
-    float totalVal = 0;
-    float totalArea = 0;
-
-    totalVal += partialVal[i];
-    totalArea += partialArea[i];
+    firstChunk[i] = chunkStart.size();
+    for (size_t n = firstNode[i]; n < firstNode[i + 1]; n += GAUGE_CHUNK_SIZE) {
+      chunkStart.push_back(n);
+    }
+  }
+  firstChunk[countGauges] = chunkStart.size();
+  chunkStart.push_back(countNodes);
 
+  firstMember.resize(countGauges + 1);
+  members.clear();
+  for (size_t i = 0; i < countGauges; i++) {
+    firstMember[i] = members.size();
+    members.push_back(i);
     std::vector<GaugeConfigSection *> *intGauges = &(gaugeTree[i]);
     for (size_t j = 0; j < intGauges->size(); j++) {
-      size_t gaugeIndex = gaugeMap[intGauges->at(j)];
-      totalVal += partialVal[gaugeIndex];
-      totalArea += partialArea[gaugeIndex];
+      members.push_back(gaugeMap[intGauges->at(j)]);
     }
-
-    gaugeAvg->at(i) = (totalVal / totalArea);
   }
-}
+  firstMember[countGauges] = members.size();
 
-void GaugeMap::GetGaugeArea(std::vector<GridNode> *nodes,
-                            std::vector<float> *gaugeArea) {
+  prepared = true;
+  preparedNodes = countNodes;
 
+  // The areas never change, so neither do the basin areas
+  std::vector<float> *noValue = NULL;
+  BasinSums(nodes, 1, &noValue, &basinArea);
+}
+
+// Sums value * area over the basin of every gauge for count fields, a NULL
+// field sums the area alone. sums holds the count sums of gauge 0 first.
+void GaugeMap::BasinSums(std::vector<GridNode> *nodes, size_t count,
+                         std::vector<float> **currentValues,
+                         std::vector<float> *sums) {
   size_t countGauges = gauges.size();
-  size_t countNodes = nodes->size();
+  long countChunks = (long)chunkStart.size() - 1;
+  chunkVal.resize(countChunks * count);
+  partialVal.resize(countGauges * count);
+  sums->resize(countGauges * count);
 
-  // Zero out the partial vectors
-  for (size_t i = 0; i < countGauges; i++) {
-    partialArea[i] = 0;
+#if _OPENMP
+#pragma omp parallel for schedule(dynamic, 1)
+#endif
+  for (long c = 0; c < countChunks; c++) {
+    for (size_t f = 0; f < count; f++) {
+      std::vector<float> *value = currentValues[f];
+      float sum = 0;
+      for (size_t n = chunkStart[c]; n < chunkStart[c + 1]; n++) {
+        unsigned long node = gaugeNodes[n];
+        if (value) {
+          sum += ((*value)[node] * (*nodes)[node].area);
+        } else {
+          sum += (*nodes)[node].area;
+        }
+      }
+      chunkVal[c * count + f] = sum;
+    }
   }
 
-  // Add up contributions to each gauge
-  for (size_t i = 0; i < countNodes; i++) {
-    GridNode *node = &((*nodes)[i]);
-    size_t gaugeIndex = gaugeMap[node->gauge];
-    partialArea[gaugeIndex] += node->area;
+  // Chunk sums are added up in chunk order, then gauge sums in basin order
+  for (size_t i = 0; i < countGauges; i++) {
+    for (size_t f = 0; f < count; f++) {
+      float sum = 0;
+      for (size_t c = firstChunk[i]; c < firstChunk[i + 1]; c++) {
+        sum += chunkVal[c * count + f];
+      }
+      partialVal[i * count + f] = sum;
+    }
   }
-
   for (size_t i = 0; i < countGauges; i++) {
-    float totalArea = 0;
+    for (size_t f = 0; f < count; f++) {
+      float total = 0;
+      for (size_t m = firstMember[i]; m < firstMember[i + 1]; m++) {
+        total += partialVal[members[m] * count + f];
+      }
+      (*sums)[i * count + f] = total;
+    }
+  }
+}
 
-    totalArea += partialArea[i];
+void GaugeMap::GaugeAverage(std::vector<GridNode> *nodes,
+                            std::vector<float> *currentValue,
+                            std::vector<float> *gaugeAvg) {
+  GaugeAverages(nodes, 1, &currentValue, &gaugeAvg);
+}
 
-    std::vector<GaugeConfigSection *> *intGauges = &(gaugeTree[i]);
-    for (size_t j = 0; j < intGauges->size(); j++) {
-      size_t gaugeIndex = gaugeMap[intGauges->at(j)];
-      totalArea += partialArea[gaugeIndex];
+void GaugeMap::GaugeAverages(std::vector<GridNode> *nodes, size_t count,
+                             std::vector<float> **currentValues,
+                             std::vector<float> **gaugeAvgs) {
+  if (!prepared || preparedNodes != nodes->size()) {
+    Prepare(nodes);
+  }
+
+  BasinSums(nodes, count, currentValues, &basinVal);
+  size_t countGauges = gauges.size();
+  for (size_t f = 0; f < count; f++) {
+    std::vector<float> *gaugeAvg = gaugeAvgs[f];
+    for (size_t i = 0; i < countGauges; i++) {
+      gaugeAvg->at(i) = (basinVal[i * count + f] / basinArea[i]);
     }
+  }
+}
 
-    gaugeArea->at(i) = totalArea;
+void GaugeMap::GetGaugeArea(std::vector<GridNode> *nodes,
+                            std::vector<float> *gaugeArea) {
+  if (!prepared || preparedNodes != nodes->size()) {
+    Prepare(nodes);
   }
+
+  size_t countGauges = gauges.size();
+  for (size_t i = 0; i < countGauges; i++) {
+    gaugeArea->at(i) = basinArea[i];
+  }
+}
+
+std::vector<GaugeConfigSection *> *
+GaugeMap::GetUpstreamGauges(GaugeConfigSection *gauge) {
+  std::map<GaugeConfigSection *, size_t>::iterator itr = gaugeMap.find(gauge);
+  if (itr == gaugeMap.end()) {
+    return NULL;
+  }
+  return &(gaugeTree[itr->second]);
 }
 
 void GaugeMap::SaveGaugeRelationships(TimeVar *currentTime, char *statePath) {
@@ -172,6 +254,11 @@ bool GaugeMap::LoadGaugeRelationships(TimeVar *beginTime, char *statePath) {
   if (!beginTime || !statePath) {
     return false;
   }
+
+  // Without the gauges no line can be matched, have the carve build them
+  if (gauges.empty()) {
+    return false;
+  }
   
   // Get the time components from the TimeVar object
   tm *timeInfo = beginTime->GetTM();
@@ -237,8 +324,10 @@ bool GaugeMap::LoadGaugeRelationships(TimeVar *beginTime, char *statePath) {
       }
       
       if (downstreamGauge && upstreamGauge) {
-        // Add the relationship using the existing method
-        AddUpstreamGauge(downstreamGauge, upstreamGauge);
+        // The file lists the indirect relationships too, so they go straight
+        // into the tree; AddUpstreamGauge would add them a second time
+        gaugeTree[gaugeMap[downstreamGauge]].push_back(upstreamGauge);
+        prepared = false;
       } else {
         printf("Warning: Could not find gauges in line %d: %s,%s\n", 
                lineNum, downstreamName.c_str(), upstreamName.c_str());
@@ -9,24 +9,53 @@
 
 class GaugeMap {
 public:
+  GaugeMap() {
+    prepared = false;
+    preparedNodes = 0;
+  }
   void Initialize(std::vector<GaugeConfigSection *> *newGauges);
   void AddUpstreamGauge(GaugeConfigSection *downStream,
                         GaugeConfigSection *upStream);
   void GaugeAverage(std::vector<GridNode> *nodes,
                     std::vector<float> *currentValue,
                     std::vector<float> *gaugeAvg);
+  // Area weighted basin averages of count node fields in a single pass
+  void GaugeAverages(std::vector<GridNode> *nodes, size_t count,
+                     std::vector<float> **currentValues,
+                     std::vector<float> **gaugeAvgs);
   void GetGaugeArea(std::vector<GridNode> *nodes,
                     std::vector<float> *gaugeArea);
+  // Every gauge (direct or indirect) upstream of gauge, NULL if unknown
+  std::vector<GaugeConfigSection *> *
+  GetUpstreamGauges(GaugeConfigSection *gauge);
   
   // New methods for saving/loading gauge relationships
   void SaveGaugeRelationships(TimeVar *currentTime, char *statePath);
   bool LoadGaugeRelationships(TimeVar *beginTime, char *statePath);
 
 private:
+  void Prepare(std::vector<GridNode> *nodes);
+  void BasinSums(std::vector<GridNode> *nodes, size_t count,
+                 std::vector<float> **currentValues, std::vector<float> *sums);
+
   std::vector<GaugeConfigSection *> gauges;
   std::vector<std::vector<GaugeConfigSection *> > gaugeTree;
   std::map<GaugeConfigSection *, size_t> gaugeMap;
-  std::vector<float> partialVal, partialArea;
+  // Index of the gauge directly downstream of each gauge, -1 for outlets
+  std::vector<long> downGauges;
+
+  // Built by Prepare from the nodes and gaugeTree. The nodes of each gauge,
+  // ascending, are split into chunks that are summed independently; chunk c
+  // covers gaugeNodes[chunkStart[c]] up to gaugeNodes[chunkStart[c + 1] - 1]
+  // and gauge g owns chunks firstChunk[g] up to firstChunk[g + 1] - 1. The
+  // basin of gauge g is gauges members[firstMember[g]] up to
+  // members[firstMember[g + 1] - 1], g itself first.
+  bool prepared;
+  size_t preparedNodes;
+  std::vector<unsigned long> gaugeNodes;
+  std::vector<size_t> chunkStart, firstChunk;
+  std::vector<size_t> firstMember, members;
+  std::vector<float> basinArea, basinVal, chunkVal, partialVal;
 };
 
 #endif
@@ -4,6 +4,7 @@
 #include "BoundingBox.h"
 #include <cstdio>
 #include <math.h>
+#include <new>
 
 struct GridLoc {
   long x;
@@ -84,7 +85,29 @@ public:
     backingStore = NULL;
     geoSet = false;
   }
-  ~FloatGrid() {
+  ~FloatGrid() { FreeData(); }
+
+  // Allocates numCols x numRows cells as one block with data[row] pointing
+  // into it. Returns false if the grid does not fit in memory.
+  bool Allocate() {
+    FreeData();
+    size_t numCells = (size_t)numCols * (size_t)numRows;
+    data = new (std::nothrow) float *[numRows];
+    backingStore = new (std::nothrow) float[numCells];
+    if (!data || !backingStore) {
+      delete[] data;
+      delete[] backingStore;
+      data = NULL;
+      backingStore = NULL;
+      return false;
+    }
+    for (long i = 0; i < numRows; i++) {
+      data[i] = &(backingStore[(size_t)i * numCols]);
+    }
+    return true;
+  }
+
+  void FreeData() {
     if (data) {
       if (!backingStore) {
         for (long i = 0; i < numRows; i++) {
@@ -97,7 +120,10 @@ public:
       }
       delete[] data;
     }
+    data = NULL;
+    backingStore = NULL;
   }
+
   float noData;
   float **data;
   float *backingStore;
@@ -124,4 +150,45 @@ public:
   long **data;
 };
 
+// A raster of a narrower cell type, always held as one block with data[row]
+// pointing into it, e.g. the flow directions which fit in a byte.
+template <typename T> class TypedGrid : public Grid {
+
+public:
+  TypedGrid() {
+    data = NULL;
+    backingStore = NULL;
+    geoSet = false;
+  }
+  ~TypedGrid() { FreeData(); }
+
+  bool Allocate() {
+    FreeData();
+    size_t numCells = (size_t)numCols * (size_t)numRows;
+    data = new (std::nothrow) T *[numRows];
+    backingStore = new (std::nothrow) T[numCells];
+    if (!data || !backingStore) {
+      FreeData();
+      return false;
+    }
+    for (long i = 0; i < numRows; i++) {
+      data[i] = &(backingStore[(size_t)i * numCols]);
+    }
+    return true;
+  }
+
+  void FreeData() {
+    delete[] data;
+    delete[] backingStore;
+    data = NULL;
+    backingStore = NULL;
+  }
+
+  T noData;
+  T **data;
+  T *backingStore;
+};
+
+typedef TypedGrid<unsigned char> ByteGrid;
+
 #endif
@@ -0,0 +1,93 @@
+#ifndef GRID_POOL_H
+#define GRID_POOL_H
+
+#include "Grid.h"
+#include <cstdio>
+#include <vector>
+
+// Most grids a pool keeps for reuse, enough for precip and QPF in
+// different geometries
+#define GRID_POOL_SIZE 4
+
+// Keeps the forcing rasters between reads so each timestep refills an
+// existing grid instead of allocating a new one. Grids are matched on their
+// dimensions and every reader sets the rest of the geometry on each read.
+// A pool belongs to one reader and is not thread safe.
+class GridPool {
+
+public:
+  GridPool() {
+    numAcquired = 0;
+    numAllocated = 0;
+  }
+  ~GridPool() {
+    for (size_t i = 0; i < freeGrids.size(); i++) {
+      delete freeGrids[i];
+    }
+  }
+
+  // Returns a contiguous numCols x numRows grid, NULL if out of memory
+  FloatGrid *Acquire(long numCols, long numRows) {
+    numAcquired++;
+    for (size_t i = 0; i < freeGrids.size(); i++) {
+      FloatGrid *grid = freeGrids[i];
+      if (grid->numCols == numCols && grid->numRows == numRows) {
+        freeGrids.erase(freeGrids.begin() + i);
+        return grid;
+      }
+    }
+    numAllocated++;
+    FloatGrid *grid = new FloatGrid();
+    grid->numCols = numCols;
+    grid->numRows = numRows;
+    if (!grid->Allocate()) {
+      delete grid;
+      return NULL;
+    }
+    return grid;
+  }
+
+  void Release(FloatGrid *grid) {
+    if (!grid) {
+      return;
+    }
+    freeGrids.push_back(grid);
+    if (freeGrids.size() > GRID_POOL_SIZE) {
+      delete freeGrids.front();
+      freeGrids.erase(freeGrids.begin());
+    }
+  }
+
+  long GetNumAcquired() { return numAcquired; }
+  long GetNumAllocated() { return numAllocated; }
+
+private:
+  std::vector<FloatGrid *> freeGrids;
+  long numAcquired, numAllocated;
+};
+
+// The readers take an optional pool; without one the grid is simply new'd
+// and it is up to the caller to delete it.
+inline FloatGrid *NewFloatGrid(GridPool *pool, long numCols, long numRows) {
+  if (pool) {
+    return pool->Acquire(numCols, numRows);
+  }
+  FloatGrid *grid = new FloatGrid();
+  grid->numCols = numCols;
+  grid->numRows = numRows;
+  if (!grid->Allocate()) {
+    delete grid;
+    return NULL;
+  }
+  return grid;
+}
+
+inline void FreeFloatGrid(GridPool *pool, FloatGrid *grid) {
+  if (pool) {
+    pool->Release(grid);
+  } else {
+    delete grid;
+  }
+}
+
+#endif
@@ -29,6 +29,18 @@ void InletConfigSection::LoadTS() {
   }
 }
 
+void InletConfigSection::AlignTS(const std::vector<time_t> &stepTimes) {
+  obs.AlignToSteps(stepTimes, &stepObs, &stepObsSet);
+}
+
+bool InletConfigSection::GetObservedAtStep(long step, float *value) {
+  if (step < 0 || (size_t)step >= stepObsSet.size() || !stepObsSet[step]) {
+    return false;
+  }
+  *value = stepObs[step];
+  return true;
+}
+
 float InletConfigSection::GetObserved(TimeVar *currentTime) {
   if (!obs.GetNumberOfObs()) {
     return std::numeric_limits<float>::quiet_NaN();
@@ -8,6 +8,7 @@
 #include "TimeVar.h"
 #include <map>
 #include <string>
+#include <vector>
 
 class InletConfigSection : public ConfigSection {
 
@@ -26,6 +27,10 @@ public:
   float GetObserved(TimeVar *currentTime, float diff);
   void SetObservedValue(char *timeBuffer, float dataValue);
   void LoadTS();
+  // Lines the observations up with the simulation steps, see GetObservedAtStep
+  void AlignTS(const std::vector<time_t> &stepTimes);
+  // False when the inlet has no observation for this step
+  bool GetObservedAtStep(long step, float *value);
   void SetGridNodeIndex(long newVal) { gridNodeIndex = newVal; }
   void SetLat(float newVal) { lat = newVal; }
   void SetLon(float newVal) { lon = newVal; }
@@ -45,6 +50,8 @@ private:
   float lat;
   float lon;
   TimeSeries obs;
+  std::vector<float> stepObs;
+  std::vector<unsigned char> stepObsSet;
 
   // These are for basin carving procedures!
   long gridNodeIndex;
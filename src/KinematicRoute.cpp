@@ -1,7 +1,7 @@
 #include "KinematicRoute.h"
 #include "AscGrid.h"
 #include "DatedName.h"
-#include "LakeModel.h"
+#include "ReservoirTable.h"
 #include <cmath>
 #include <cstdio>
 #include <cstring>
@@ -12,16 +12,24 @@ static const char *stateStrings[] = {
     "IR",
 };
 
-KWRoute::KWRoute() : hasLakes(false), currentRouteTime(NULL) {}
+KWRoute::KWRoute()
+    : hasLakes(false), reservoirs(NULL), currentRouteStep(-1) {}
 
 KWRoute::~KWRoute() {}
 
-void KWRoute::RegisterLake(long nodeIndex, LakeModelImpl *lake) {
-  if (nodeIndex < 0 || nodeIndex >= (long)kwNodes.size()) {
-    return;
+int KWRoute::RegisterLakes(ReservoirTable *newReservoirs) {
+  reservoirs = newReservoirs;
+  int numCoupled = 0;
+  for (size_t id = 0; id < reservoirs->GetNumLakes(); id++) {
+    long nodeIndex = reservoirs->GetNode(id);
+    if (nodeIndex < 0 || nodeIndex >= (long)kwNodes.size()) {
+      continue;
+    }
+    kwNodes[nodeIndex].lakeId = (long)id;
+    hasLakes = true;
+    numCoupled++;
   }
-  kwNodes[nodeIndex].lakeModel = lake;
-  hasLakes = true;
+  return numCoupled;
 }
 
 float KWRoute::SetObsInflow(long index, float inflow) {
@@ -67,6 +75,23 @@ float KWRoute::SetObsInflow(long index, float inflow) {
   return prev;
 }
 
+// Passed on the way RouteInt passes a cell's outflow downstream, so the
+// downstream cell routes it on the next Route() call and then clears it with
+// the other inflows. The node itself does not route it again.
+void KWRoute::AddBoundaryInflow(long index, float inflow) {
+  GridNode *node = &nodes->at(index);
+  if (node->downStreamNode == INVALID_DOWNSTREAM_NODE) {
+    return;
+  }
+  KWGridNode *downNode =
+      &(kwNodes[nodes->at(node->downStreamNode).modelIndex]);
+  if (!node->channelGridCell) {
+    downNode->incomingWaterOverland += inflow / node->horLen;
+  } else {
+    downNode->incomingWaterChannel += inflow;
+  }
+}
+
 bool KWRoute::InitializeModel(
     std::vector<GridNode> *newNodes,
     std::map<GaugeConfigSection *, float *> *paramSettings,
@@ -90,12 +115,14 @@ bool KWRoute::InitializeModel(
     cNode->incomingWater[KW_LAYER_FASTFLOW] = 0.0;
     cNode->incomingWaterOverland = 0.0;
     cNode->incomingWaterChannel = 0.0;
-    cNode->lakeModel = NULL; // set later via RegisterLake() for lake cells
+    cNode->lakeId = -1; // set later via RegisterLakes() for lake cells
     for (int p = 0; p < STATE_KW_QTY; p++) {
       cNode->states[p] = 0.0;
     }
   }
 
+  idleNodes.assign(numNodes, 0);
+
   InitializeParameters(paramSettings, paramGrids);
   initialized = false;
   maxSpeed = 1.0;
@@ -181,15 +208,32 @@ bool KWRoute::Route(float stepHours, std::vector<float> *fastFlow,
   }
 
   size_t numNodes = nodes->size();
+  numIdle = 0;
 
+  // Upstream cells are done first, so whether a cell receives any water
+  // this step is known by the time it is reached
   for (long i = numNodes - 1; i >= 0; i--) {
     KWGridNode *cNode = &(kwNodes[i]);
-    RouteInt(stepHours * 3600.0f, &(nodes->at(i)), cNode, fastFlow->at(i),
+    GridNode *node = &(nodes->at(i));
+    idleNodes[i] = IsIdle(stepHours * 3600.0f, node, cNode, fastFlow->at(i),
+                          interFlow->at(i), baseFlow->at(i));
+    if (idleNodes[i]) {
+      // No outflow, the interflow and baseflow it was sent stay for next step
+      cNode->incomingWater[KW_LAYER_FASTFLOW] = 0.0;
+      numIdle++;
+      continue;
+    }
+    RouteInt(stepHours * 3600.0f, node, cNode, fastFlow->at(i),
              interFlow->at(i), baseFlow->at(i));
   }
 
   for (size_t i = 0; i < numNodes; i++) {
     KWGridNode *cNode = &(kwNodes[i]);
+    // An idle cell's inputs are carried over to the next step
+    if (idleNodes[i]) {
+      discharge->at(i) = 0.0;
+      continue;
+    }
     interFlow->at(i) = 0.0; // cNode->incomingWater[KW_LAYER_INTERFLOW];
     baseFlow ->at(i)=  0.0; // cNode->incomingWater[KW_LAYER_BASEFLOW];
     fastFlow->at(i) = 0.0; // cNode->incomingWater[KW_LAYER_FASTFLOW];
@@ -218,6 +262,47 @@ bool KWRoute::Route(float stepHours, std::vector<float> *fastFlow,
   return true;
 }
 
+// Whether a non-negative amount of water is within the threshold once
+// converted to a discharge in cms by scale
+static bool WithinThreshold(double value, double scale, float threshold) {
+  if (threshold <= 0.0) {
+    return value == 0.0;
+  }
+  return value >= 0.0 && value * scale <= threshold;
+}
+
+// A cell is idle when its runoff, inflows, outflow and stored interflow are
+// each no more than the threshold as a discharge. With a zero threshold the
+// kinematic wave would give it zero outflow and leave it as it is, so
+// skipping it changes nothing. Lake cells are always stepped.
+bool KWRoute::IsIdle(float stepSeconds, GridNode *node, KWGridNode *cNode,
+                     float fastFlow, float interFlow, float baseFlow) {
+  double runoffScale = node->area * 1000.0; // mm/s over the cell to cms
+  if (cNode->lakeId >= 0 ||
+      !WithinThreshold(fastFlow, runoffScale, idleThreshold) ||
+      !WithinThreshold(interFlow, runoffScale, idleThreshold) ||
+      !WithinThreshold(baseFlow, runoffScale, idleThreshold) ||
+      !WithinThreshold(cNode->incomingWaterOverland, node->horLen,
+                       idleThreshold)) {
+    return false;
+  }
+  if (!node->channelGridCell) {
+    // Interflow and baseflow sent here join the store once the cell is stepped
+    return WithinThreshold(cNode->states[STATE_KW_PQ], node->horLen,
+                           idleThreshold) &&
+           WithinThreshold(cNode->states[STATE_KW_IR] +
+                               cNode->incomingWater[KW_LAYER_INTERFLOW] +
+                               cNode->incomingWater[KW_LAYER_BASEFLOW],
+                           runoffScale / stepSeconds, idleThreshold);
+  }
+  return WithinThreshold(cNode->incomingWater[KW_LAYER_INTERFLOW],
+                         runoffScale, idleThreshold) &&
+         WithinThreshold(cNode->states[STATE_KW_PO], node->horLen,
+                         idleThreshold) &&
+         WithinThreshold(cNode->incomingWaterChannel, 1.0, idleThreshold) &&
+         WithinThreshold(cNode->states[STATE_KW_PQ], 1.0, idleThreshold);
+}
+
 void KWRoute::RouteInt(float stepSeconds, GridNode *node, KWGridNode *cNode,
                        float fastFlow, float interFlow, float baseFlow) {
 
@@ -280,10 +365,10 @@ void KWRoute::RouteInt(float stepSeconds, GridNode *node, KWGridNode *cNode,
     // newq*horLen is ~the cell's inflow, so feed it through the reservoir and
     // replace newq with (regulated outflow / horLen). The sweep is upstream ->
     // downstream, so the regulated value reaches downstream cells this same step.
-    if (cNode->lakeModel && node->horLen > 0.0) {
+    if (cNode->lakeId >= 0 && node->horLen > 0.0) {
       double inflowCMS = (double)newq * (double)node->horLen;
-      double outflowCMS = cNode->lakeModel->StepReservoirInflow(
-          inflowCMS, stepSeconds, currentRouteTime);
+      double outflowCMS = reservoirs->StepInflow(
+          cNode->lakeId, inflowCMS, stepSeconds, currentRouteStep);
       newq = (float)(outflowCMS / (double)node->horLen);
     }
 
@@ -448,11 +533,11 @@ void KWRoute::RouteInt(float stepSeconds, GridNode *node, KWGridNode *cNode,
     // downstream, incomingWaterChannel already holds all upstream channel flow,
     // and newq is the local lateral inflow (cms/m) over the cell. The regulated
     // outflow then propagates downstream this same step (no operator-split lag).
-    if (cNode->lakeModel) {
+    if (cNode->lakeId >= 0) {
       double inflowCMS = (double)cNode->incomingWaterChannel +
                          (double)newq * (double)node->horLen;
-      double outflowCMS = cNode->lakeModel->StepReservoirInflow(
-          inflowCMS, stepSeconds, currentRouteTime);
+      double outflowCMS = reservoirs->StepInflow(
+          cNode->lakeId, inflowCMS, stepSeconds, currentRouteStep);
       newWater = (float)outflowCMS;
     }
 
@@ -3,7 +3,7 @@
 
 #include "ModelBase.h"
 
-class LakeModelImpl; // forward decl: lake cells are coupled in-sweep (see Route)
+class ReservoirTable; // forward decl: lake cells are coupled in-sweep (see Route)
 class TimeVar;
 
 enum KW_LAYER {
@@ -37,10 +37,10 @@ struct KWGridNode : BasicGridNode {
   // double previousOverland;
   double incomingWaterOverland, incomingWaterChannel;
 
-  // Non-NULL if this channel cell is a lake/reservoir outlet. When set, channel
-  // routing at this cell is replaced by the reservoir step so the regulated
-  // outflow propagates downstream within the same sweep.
-  LakeModelImpl *lakeModel;
+  // Reservoir table id if this channel cell is a lake/reservoir outlet, else
+  // -1. When set, channel routing at this cell is replaced by the reservoir
+  // step so the regulated outflow propagates downstream within the same sweep.
+  long lakeId;
 };
 
 class KWRoute : public RoutingModel {
@@ -49,6 +49,7 @@ public:
   KWRoute();
   ~KWRoute();
   float SetObsInflow(long index, float inflow);
+  void AddBoundaryInflow(long index, float inflow);
   bool InitializeModel(std::vector<GridNode> *newNodes,
                        std::map<GaugeConfigSection *, float *> *paramSettings,
                        std::vector<FloatGrid *> *paramGrids);
@@ -62,17 +63,20 @@ public:
              std::vector<float> *interFlow, std::vector<float> *baseFlow, std::vector<float> *discharge);
   float GetMaxSpeed() { return maxSpeed; }
 
-  // Couple a lake/reservoir to the routing cell at the given node index. After
-  // this, the cell's channel outflow is governed by the reservoir step rather
-  // than the kinematic wave, so lake regulation reaches downstream cells.
-  void RegisterLake(long nodeIndex, LakeModelImpl *lake);
-  // Provide the current simulation time so the in-sweep reservoir step can look
-  // up engineered (dam) discharge. NULL disables engineered lookup.
-  void SetCurrentTime(TimeVar *t) { currentRouteTime = t; }
+  // Couple every lake/reservoir of the table to the routing cell at its node.
+  // After this, those cells' channel outflow is governed by the reservoir step
+  // rather than the kinematic wave, so lake regulation reaches downstream
+  // cells. Returns the number of lakes coupled.
+  int RegisterLakes(ReservoirTable *newReservoirs);
+  // Provide the current simulation step so the in-sweep reservoir step can look
+  // up engineered (dam) discharge. -1 disables engineered lookup.
+  void SetCurrentStep(long step) { currentRouteStep = step; }
 
 private:
   void RouteInt(float stepSeconds, GridNode *node, KWGridNode *cNode,
                 float fastFlow, float interFlow, float baseFlow);
+  bool IsIdle(float stepSeconds, GridNode *node, KWGridNode *cNode,
+              float fastFlow, float interFlow, float baseFlow);
   void
   InitializeParameters(std::map<GaugeConfigSection *, float *> *paramSettings,
                        std::vector<FloatGrid *> *paramGrids);
@@ -80,10 +84,12 @@ private:
 
   std::vector<GridNode> *nodes;
   std::vector<KWGridNode> kwNodes;
+  std::vector<unsigned char> idleNodes; // skipped by the current Route call
   float maxSpeed;
   bool initialized;
   bool hasLakes;            // true once at least one lake cell is registered
-  TimeVar *currentRouteTime; // current sim time for engineered-discharge lookup
+  ReservoirTable *reservoirs; // owned by the simulator
+  long currentRouteStep; // current sim step for engineered-discharge lookup
 };
 
 #endif
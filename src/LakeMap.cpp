@@ -321,57 +321,39 @@ std::vector<GridLoc> LakeMap::GetUpstreamNeighbors(LakeModelImpl *lake) {
   return lakeNeighbors[itr->second];
 }
 
-float LakeMap::CalculateInflow(LakeModelImpl *lake, std::vector<float> *currentQ, std::vector<GridNode> *nodes, TimeVar *currentTime) {
-  // First check if this lake has inlets configured
+float LakeMap::CalculateInflow(LakeModelImpl *lake, std::vector<float> *currentQ, std::vector<GridNode> *nodes, long step) {
   std::map<LakeModelImpl *, size_t>::iterator itr = lakeMap.find(lake);
   if (itr != lakeMap.end()) {
-    size_t lakeIndex = itr->second;
-    if (lakeIndex < lakeInlets.size() && !lakeInlets[lakeIndex].empty()) {
-      // Use inlet-based inflow calculation
-      float totalInflow = 0.0f;
-      
-      for (size_t i = 0; i < lakeInlets[lakeIndex].size(); i++) {
-        InletConfigSection *inlet = lakeInlets[lakeIndex][i];
-        if (inlet && currentTime) {
-          float inletQ = inlet->GetObserved(currentTime);
-          if (inletQ == inletQ) { // Check for NaN using IEEE 754 property
-            totalInflow += inletQ;
-          } else {
-            // If inlet has no Q value at this timestep, assume Q = 0
-            totalInflow += 0.0f;
-          }
-        }
+    return CalculateInflow(itr->second, currentQ, step);
+  }
+  return LakeCellQ(lake, currentQ);
+}
+
+float LakeMap::CalculateInflow(size_t lakeIndex, std::vector<float> *currentQ, long step) {
+  // First check if this lake has inlets configured
+  if (!lakeInlets[lakeIndex].empty()) {
+    // Use inlet-based inflow calculation
+    float totalInflow = 0.0f;
+    
+    for (size_t i = 0; i < lakeInlets[lakeIndex].size(); i++) {
+      InletConfigSection *inlet = lakeInlets[lakeIndex][i];
+      // If inlet has no Q value at this timestep, assume Q = 0
+      float inletQ;
+      if (inlet && inlet->GetObservedAtStep(step, &inletQ) &&
+          inletQ == inletQ) { // Check for NaN using IEEE 754 property
+        totalInflow += inletQ;
       }
-      
-      // Using inlet-based inflow without logging
-      return totalInflow; // Return sum of all inlets (not average)
     }
+    
+    // Using inlet-based inflow without logging
+    return totalInflow; // Return sum of all inlets (not average)
   }
   
-  // Build the (y,x) -> node-index lookup once (avoids an O(nodes) scan for
-  // every neighbour of every lake on every timestep).
-  if (nodeIndexByLoc.empty() && nodes && !nodes->empty()) {
-    for (size_t ni = 0; ni < nodes->size(); ++ni) {
-      long long key = (((long long)(*nodes)[ni].y) << 32) |
-                      (unsigned long)(*nodes)[ni].x;
-      nodeIndexByLoc[key] = (int)ni;
-    }
-  }
-
   // Fallback to FAM neighbor-based inflow calculation
-  std::vector<GridLoc> neighbors = GetUpstreamNeighbors(lake);
+  std::vector<GridLoc> &neighbors = lakeNeighbors[lakeIndex];
 
   if (neighbors.empty()) {
-    // Fallback: use lake cell itself if no upstream neighbors found. The routed
-    // Q at the lake cell already accumulates all upstream contributions.
-    GridLoc *loc = lake->GetLocation();
-    long long key = (((long long)loc->y) << 32) | (unsigned long)loc->x;
-    std::map<long long, int>::iterator it = nodeIndexByLoc.find(key);
-    int nodeIdx = (it != nodeIndexByLoc.end()) ? it->second : -1;
-    if (nodeIdx >= 0 && nodeIdx < (int)currentQ->size()) {
-      return (*currentQ)[nodeIdx];
-    }
-    return 0.0f;
+    return LakeCellQ(lakes[lakeIndex], currentQ);
   }
 
   // Total inflow = SUM of the discharges of every cell that drains into the
@@ -379,20 +361,29 @@ float LakeMap::CalculateInflow(LakeModelImpl *lake, std::vector<float> *currentQ
   // in, violating mass conservation).
   float inflow = 0.0f;
   for (size_t n = 0; n < neighbors.size(); ++n) {
-    long long key = (((long long)neighbors[n].y) << 32) |
-                    (unsigned long)neighbors[n].x;
-    std::map<long long, int>::iterator it = nodeIndexByLoc.find(key);
-    int nodeIdx = (it != nodeIndexByLoc.end()) ? it->second : -1;
-    if (nodeIdx >= 0 && nodeIdx < (int)currentQ->size()) {
+    long nodeIdx =
+        nodeIndex ? nodeIndex->Find(neighbors[n].x, neighbors[n].y) : -1;
+    if (nodeIdx >= 0 && nodeIdx < (long)currentQ->size()) {
       inflow += (*currentQ)[nodeIdx];
     }
   }
   return inflow;
 }
 
+// Fallback: use lake cell itself if no upstream neighbors found. The routed
+// Q at the lake cell already accumulates all upstream contributions.
+float LakeMap::LakeCellQ(LakeModelImpl *lake, std::vector<float> *currentQ) {
+  GridLoc *loc = lake->GetLocation();
+  long nodeIdx = nodeIndex ? nodeIndex->Find(loc->x, loc->y) : -1;
+  if (nodeIdx >= 0 && nodeIdx < (long)currentQ->size()) {
+    return (*currentQ)[nodeIdx];
+  }
+  return 0.0f;
+}
+
 
 
-void LakeMap::InitializeInlets(std::vector<InletConfigSection *> *inlets) {
+void LakeMap::InitializeInlets(std::vector<InletConfigSection *> *inlets, const std::vector<time_t> &stepTimes) {
   if (!inlets) return;
   
   // Clear existing inlet assignments
@@ -426,11 +417,13 @@ void LakeMap::InitializeInlets(std::vector<InletConfigSection *> *inlets) {
     // Lake inlets configured without logging
   }
   
-  // Load time series for all inlets
+  // Load time series for all inlets, aligned to the simulation steps so the
+  // inflow is an index lookup each step
   for (size_t i = 0; i < inlets->size(); i++) {
     InletConfigSection *inlet = inlets->at(i);
     if (inlet) {
       inlet->LoadTS();
+      inlet->AlignTS(stepTimes);
     }
   }
 } 
@@ -5,30 +5,36 @@
 #include "LakeModel.h"
 #include "InletConfigSection.h"
 #include "Grid.h"
+#include "NodeIndex.h"
 #include <vector>
 #include <map>
 
 class LakeMap {
 public:
+  LakeMap() { nodeIndex = NULL; }
   void Initialize(std::vector<LakeModelImpl *> *newLakes);
   void FindLakeLocations();
   void FindUpstreamNeighbors();
   std::vector<GridLoc> GetUpstreamNeighbors(LakeModelImpl *lake);
-  float CalculateInflow(LakeModelImpl *lake, std::vector<float> *currentQ, std::vector<GridNode> *nodes, TimeVar *currentTime);
-  void InitializeInlets(std::vector<InletConfigSection *> *inlets);
+  float CalculateInflow(LakeModelImpl *lake, std::vector<float> *currentQ, std::vector<GridNode> *nodes, long step);
+  // Same, by the lake's position in the list given to Initialize
+  float CalculateInflow(size_t lakeIndex, std::vector<float> *currentQ, long step);
+  void InitializeInlets(std::vector<InletConfigSection *> *inlets, const std::vector<time_t> &stepTimes);
+  void SetNodeIndex(NodeIndex *newIndex) { nodeIndex = newIndex; }
   
   // New methods for saving/loading lake relationships
   void SaveLakeRelationships(TimeVar *currentTime, char *statePath);
   bool LoadLakeRelationships(TimeVar *beginTime, char *statePath);
 
 private:
+  float LakeCellQ(LakeModelImpl *lake, std::vector<float> *currentQ);
+
   std::vector<LakeModelImpl *> lakes;
   std::map<LakeModelImpl *, size_t> lakeMap;
   std::vector<std::vector<GridLoc> > lakeNeighbors;
   std::vector<std::vector<InletConfigSection *> > lakeInlets;
-  // (y<<32 | x) -> index into the nodes vector, built once and reused so
-  // CalculateInflow no longer scans all nodes per neighbor per lake per step.
-  std::map<long long, int> nodeIndexByLoc;
+  // Owned by the simulator, maps a cell to its index in the nodes vector
+  NodeIndex *nodeIndex;
 };
 
 #endif 
\ No newline at end of file
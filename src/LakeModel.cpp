@@ -87,8 +87,8 @@ double LegacyLakeModel::GetThVolume() const { return th_volume; }
 std::string LegacyLakeModel::GetLakeName() const { return lakeName; }
 
 // LakeModelImpl implementation (new state-saving version)
-LakeModelImpl::LakeModelImpl(const LakeInfo& info, bool wm_flag, std::map<std::string, double>* engineeredDischarge)
-    : lakeName(info.name), storage(info.th_volume), area(info.area), outflow(0.0), inflow(0.0), precipitation(0.0), evaporation(0.0), dt(0.0), th_volume(info.th_volume), wm_flag(wm_flag), engineeredDischarge(engineeredDischarge), retentionConstant(info.retention_constant), param_a(info.param_a), param_b(info.param_b), nodes(NULL), lakeNodeIndex(-1), warnedDtResidence(false), lat(info.lat), lon(info.lon), obsFlowAccum(info.obsFlowAccum), obsFlowAccumSet(info.obsFlowAccumSet) {
+LakeModelImpl::LakeModelImpl(const LakeInfo& info, bool wm_flag, const std::map<time_t, double>* engineeredDischarge)
+    : lakeName(info.name), storage(info.th_volume), area(info.area), outflow(0.0), inflow(0.0), precipitation(0.0), evaporation(0.0), dt(0.0), th_volume(info.th_volume), wm_flag(wm_flag), engineeredDischarge(engineeredDischarge), retentionConstant(info.retention_constant), param_a(info.param_a), param_b(info.param_b), nodes(NULL), lakeNodeIndex(-1), warnedDtResidence(false), lat(info.lat), lon(info.lon), obsFlowAccum(info.obsFlowAccum), obsFlowAccumSet(info.obsFlowAccumSet), outputts(info.outputts) {
     // Initialize grid location
     gridLoc.x = -1;
     gridLoc.y = -1;
@@ -285,7 +285,7 @@ void LakeModelImpl::SaveStates(TimeVar *currentTime, char *statePath,
 
 
 
-void LakeModelImpl::Step(const std::string& timestamp, double inflow, double precipitation, double evaporation, double dt) {
+void LakeModelImpl::Step(long step, double inflow, double precipitation, double evaporation, double dt) {
     // Legacy method for backward compatibility
     this->inflow = inflow;
     this->precipitation = precipitation;
@@ -297,7 +297,7 @@ void LakeModelImpl::Step(const std::string& timestamp, double inflow, double pre
     storage += (inflow * dt) + precip_vol - evap_vol;
     
     // Calculate outflow
-    outflow = LakeCalculations::GetEngineeredDischarge(timestamp, wm_flag, engineeredDischarge);
+    outflow = GetEngineeredDischarge(step);
     if (outflow == 0.0) {
         if (storage > th_volume) {
             // Overflow: spill the excess. Storage is capped at the threshold and
@@ -330,6 +330,37 @@ void LakeModelImpl::Step(const std::string& timestamp, double inflow, double pre
     }
 }
 
+void LakeModelImpl::AlignToSteps(const std::vector<time_t>& stepTimes) {
+    engineeredSteps.assign(stepTimes.size(), 0.0f);
+    engineeredSet.assign(stepTimes.size(), 0);
+    if (!wm_flag || !engineeredDischarge) {
+        return;
+    }
+    // Both are in time order, so a single pass lines them up
+    std::map<time_t, double>::const_iterator it = engineeredDischarge->begin();
+    size_t numSet = 0;
+    for (size_t i = 0; i < stepTimes.size(); i++) {
+        while (it != engineeredDischarge->end() && it->first < stepTimes[i]) {
+            ++it;
+        }
+        if (it != engineeredDischarge->end() && it->first == stepTimes[i]) {
+            engineeredSteps[i] = static_cast<float>(it->second);
+            engineeredSet[i] = 1;
+            numSet++;
+        }
+    }
+    if (numSet == 0 && !stepTimes.empty()) {
+        WARNING_LOGF("Lake %s: no engineered discharge falls on a simulation timestep", lakeName.c_str());
+    }
+}
+
+double LakeModelImpl::GetEngineeredDischarge(long step) const {
+    if (step < 0 || (size_t)step >= engineeredSet.size() || !engineeredSet[step]) {
+        return 0.0;
+    }
+    return engineeredSteps[step];
+}
+
 // Two-part lake balance approach implementation
 
 void LakeModelImpl::ApplyVerticalBalance(float stepHours, std::vector<float>* precip, std::vector<float>* pet) {
@@ -369,17 +400,17 @@ void LakeModelImpl::ApplyVerticalBalance(float stepHours, std::vector<float>* pr
     }
 }
 
-void LakeModelImpl::ApplyHorizontalBalance(float stepHours, std::vector<float>* currentQ, std::vector<GridNode>* nodes, TimeVar* currentTime, LakeMap* lakeMap) {
+void LakeModelImpl::ApplyHorizontalBalance(float stepHours, std::vector<float>* currentQ, std::vector<GridNode>* nodes, long step, LakeMap* lakeMap) {
     // Part 2: Horizontal balance - S = inflow - outflow
     // This handles the horizontal water exchange with the river network
     
-    if (!currentQ || !nodes || !currentTime || !lakeMap || lakeNodeIndex < 0) {
+    if (!currentQ || !nodes || !lakeMap || lakeNodeIndex < 0) {
         // Horizontal balance skipped without logging
         return;
     }
     
     // Calculate inflow from routed Q using LakeMap
-    float inflow = lakeMap->CalculateInflow(this, currentQ, nodes, currentTime);
+    float inflow = lakeMap->CalculateInflow(this, currentQ, nodes, step);
 
     // Step the reservoir and overwrite the lake cell's Q with the regulated
     // outflow. NOTE: with kinematic-wave routing this legacy post-routing write
@@ -388,7 +419,7 @@ void LakeModelImpl::ApplyHorizontalBalance(float stepHours, std::vector<float>*
     // path is kept for routing models without the in-router coupling.
     double outflowValue = StepReservoirInflow(static_cast<double>(inflow),
                                               static_cast<double>(stepHours * 3600.0),
-                                              currentTime);
+                                              step);
 
     // Replace Q value at lake grid cell with lake outflow
     if (lakeNodeIndex >= 0 && lakeNodeIndex < (int)currentQ->size()) {
@@ -400,7 +431,7 @@ void LakeModelImpl::ApplyHorizontalBalance(float stepHours, std::vector<float>*
 // (KWRoute) coupling. Updates storage from a channel inflow rate (m^3/s) and
 // returns the regulated outflow (m^3/s). Mass is conserved: inflow is added to
 // storage, outflow removed (overflow spills the excess above th_volume).
-double LakeModelImpl::StepReservoirInflow(double inflowCMS, double dtSeconds, TimeVar* currentTime) {
+double LakeModelImpl::StepReservoirInflow(double inflowCMS, double dtSeconds, long step) {
     this->inflow = inflowCMS;
     this->dt = dtSeconds;
 
@@ -419,12 +450,8 @@ double LakeModelImpl::StepReservoirInflow(double inflowCMS, double dtSeconds, Ti
     // Add inflow to storage
     storage += this->inflow * this->dt;
 
-    // Calculate outflow. currentTime may be NULL (engineered discharge unused).
-    double outflowValue = 0.0;
-    if (currentTime) {
-        std::string timestamp = LakeCalculations::TimeVarToTimestamp(currentTime);
-        outflowValue = LakeCalculations::GetEngineeredDischarge(timestamp, wm_flag, engineeredDischarge);
-    }
+    // Calculate outflow. step may be -1 (engineered discharge unused).
+    double outflowValue = GetEngineeredDischarge(step);
 
     if (outflowValue == 0.0) {
         if (storage > th_volume) {
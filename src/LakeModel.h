@@ -89,7 +89,7 @@ struct LakeGridNode : BasicGridNode {
 
 class LakeModelImpl : public WaterBalanceModel {
 public:
-    LakeModelImpl(const LakeInfo& info, bool wm_flag = false, std::map<std::string, double>* engineeredDischarge = NULL);
+    LakeModelImpl(const LakeInfo& info, bool wm_flag = false, const std::map<time_t, double>* engineeredDischarge = NULL);
     ~LakeModelImpl();
 
     // Model interface methods
@@ -120,7 +120,13 @@ public:
     void SetObsFlowAccum(double value) { obsFlowAccum = value; obsFlowAccumSet = true; }
 
     // Simulate one timestep (legacy method for backward compatibility)
-    void Step(const std::string& timestamp, double inflow, double precipitation, double evaporation, double dt);
+    void Step(long step, double inflow, double precipitation, double evaporation, double dt);
+
+    // Copy the engineered discharge onto the simulation steps (stepTimes[i] is
+    // the time of step i), so each step reads it by index instead of by time.
+    void AlignToSteps(const std::vector<time_t>& stepTimes);
+    // Engineered discharge for a step, 0 when there is none (or no wm_flag)
+    double GetEngineeredDischarge(long step) const;
 
     // WaterBalanceModel interface method
     bool WaterBalance(float stepHours,
@@ -134,15 +140,15 @@ public:
     
     // Two-part lake balance approach
     void ApplyVerticalBalance(float stepHours, std::vector<float>* precip, std::vector<float>* pet);
-    void ApplyHorizontalBalance(float stepHours, std::vector<float>* currentQ, std::vector<GridNode>* nodes, TimeVar* currentTime, LakeMap* lakeMap);
+    void ApplyHorizontalBalance(float stepHours, std::vector<float>* currentQ, std::vector<GridNode>* nodes, long step, LakeMap* lakeMap);
 
     // Core reservoir step: given a channel inflow rate (m^3/s) and timestep (s),
     // update storage and return the regulated outflow (m^3/s). This is the single
     // place the linear-reservoir / overflow / engineered logic lives; both the
     // legacy post-routing ApplyHorizontalBalance path and the in-router coupling
-    // (KWRoute) call it so they stay consistent. currentTime may be NULL when
-    // engineered discharge is not used (CSV lakes have wm_flag=false).
-    double StepReservoirInflow(double inflowCMS, double dtSeconds, TimeVar* currentTime);
+    // (KWRoute) call it so they stay consistent. step is the simulation step
+    // index used for the engineered discharge, -1 when there is none.
+    double StepReservoirInflow(double inflowCMS, double dtSeconds, long step);
 
     // Members
     std::string lakeName;    // Lake name
@@ -155,7 +161,9 @@ public:
     double dt;           // Timestep (s)
     double th_volume;   // Threshold volume (m^3)
     bool wm_flag;        // Use engineered discharge if true
-    std::map<std::string, double>* engineeredDischarge; // Pointer to engineered discharge time series
+    const std::map<time_t, double>* engineeredDischarge; // Engineered discharge time series (m^3/s)
+    std::vector<float> engineeredSteps; // Engineered discharge per simulation step
+    std::vector<unsigned char> engineeredSet; // 0 where a step has no engineered value
     
     // Linear reservoir parameter for dry season outflow
     double retentionConstant; // Retention constant K (hours)
@@ -177,6 +185,7 @@ public:
     double obsFlowAccum;
     bool obsFlowAccumSet;
     GridLoc gridLoc;
+    bool outputts; // Storage goes into the gauge output (Lake_Vol)
 };
 
 // Legacy LakeModel class for backward compatibility
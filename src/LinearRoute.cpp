@@ -11,6 +11,8 @@ LRRoute::~LRRoute() {}
 
 float LRRoute::SetObsInflow(long index, float inflow) { return 0.0; }
 
+void LRRoute::AddBoundaryInflow(long index, float inflow) {}
+
 bool LRRoute::InitializeModel(
     std::vector<GridNode> *newNodes,
     std::map<GaugeConfigSection *, float *> *paramSettings,
@@ -53,6 +53,7 @@ private:
                        std::vector<FloatGrid *> *paramGrids);
   void InitializeRouting(float timeSeconds);
   float SetObsInflow(long index, float inflow);
+  void AddBoundaryInflow(long index, float inflow);
 
   std::vector<GridNode> *nodes;
   std::vector<LRGridNode> lrNodes;
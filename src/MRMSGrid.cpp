@@ -4,7 +4,7 @@
 #include <math.h>
 #include <zlib.h>
 
-FloatGrid *ReadFloatMRMSGrid(char *file, FloatGrid *grid) {
+FloatGrid *ReadFloatMRMSGrid(char *file, GridPool *pool) {
 
   gzFile fileH;
 
@@ -55,82 +55,42 @@ FloatGrid *ReadFloatMRMSGrid(char *file, FloatGrid *grid) {
 
   gzclose(fileH);
 
-  float *__restrict__ backingStore = new float[num];
-  const float scalef = (float)header.var_scale;
-  int li = 0;
-  /*#pragma omp parallel for
-   for (li = 0; li < num; li += 4) {
-   backingStore[li] = ((float)binary_data[li]) / scalef;
-   backingStore[li+1] = ((float)binary_data[li+1]) / scalef;
-   backingStore[li+2] = ((float)binary_data[li+2]) / scalef;
-   backingStore[li+3] = ((float)binary_data[li+3]) / scalef;
-   }
-   */
-
   bool badFile = false;
 
-  //#pragma omp parallel for
-  for (li = 0; li < num; li++) {
-    backingStore[li] = ((float)binary_data[li]) / scalef;
-  }
-
-  /*#pragma omp parallel for
-   for (li = 0; li < num; li++) {
-   if (backingStore[li] > 500.0) {
-   badFile = true;
-   }
-   }*/
-
   dx = header.dx / float(header.dxy_scale);
   // dy = header.dy/float(header.dxy_scale);
   nw_lon = (float)header.nw_lon / (float)header.map_scale - (dx / 2.0);
   nw_lat = (float)header.nw_lat / (float)header.map_scale - (dx / 2.0);
+  FloatGrid *grid = NewFloatGrid(pool, header.nx, header.ny);
   if (!grid) {
-    grid = new FloatGrid();
-    grid->numCols = header.nx;
-    grid->numRows = header.ny;
-    grid->cellSize = dx;
-    grid->extent.top = nw_lat;
-    grid->extent.left = nw_lon;
-    grid->backingStore = backingStore;
-    grid->data = new float *[grid->numRows]();
-    if (!grid->data) {
-      WARNING_LOGF("MRMS file %s too large (out of memory) with %li rows", file,
-                   grid->numRows);
-      delete[] binary_data;
-      delete grid;
-      return NULL;
-    }
-    grid->noData = -999.0;
-    const int numRows = (int)grid->numRows;
-    const int nX = header.nx;
-    for (int i = 0; i < numRows; i++) {
-      int realI = numRows - i - 1;
-      int index = realI * nX;
-      grid->data[i] = &(backingStore[index]);
-    }
+    WARNING_LOGF("MRMS file %s too large (out of memory) with %i points", file,
+                 num);
+    delete[] binary_data;
+    return NULL;
   }
+  grid->cellSize = dx;
+  grid->extent.top = nw_lat;
+  grid->extent.left = nw_lon;
+  grid->noData = -999.0;
+  grid->geoSet = false;
 
-  /*#pragma omp parallel for
-   for (long i = 0; i < grid->numRows; i++) {
-   #pragma omp parallel for
-   for (int j = 0; j < grid->numCols; j++) {
-   int realI = grid->numRows - i - 1;
-   int index = realI*nx + j;
-   float floatData = 0;
-   floatData = ((float)binary_data[index]) / (float)var_scale;
-   grid->data[i][j] = floatData;
-   if (floatData > 500.0) {
-   badFile = true;
-   }
-   }
-   }*/
+  // MRMS rows run south to north, the grid's north to south
+  const float scalef = (float)header.var_scale;
+  const long numRows = grid->numRows;
+  const long nX = header.nx;
+  for (long i = 0; i < numRows; i++) {
+    const short int *realRow = &(binary_data[(numRows - i - 1) * nX]);
+    float *__restrict__ row = grid->data[i];
+    for (long j = 0; j < nX; j++) {
+      row[j] = ((float)realRow[j]) / scalef;
+    }
+  }
 
   delete[] binary_data;
 
   if (badFile) {
     printf("Rejecting %s for values > 500.0 ", file);
-    delete grid;
+    FreeFloatGrid(pool, grid);
     return NULL;
   }
 
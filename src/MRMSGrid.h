@@ -2,6 +2,7 @@
 #define MRMS_GRID_H
 
 #include "Grid.h"
+#include "GridPool.h"
 
 #pragma pack(push)
 #pragma pack(1)
@@ -38,7 +39,7 @@ struct MRMSHeader2D {
 };
 #pragma pack(pop)
 
-FloatGrid *ReadFloatMRMSGrid(char *file, FloatGrid *grid);
+FloatGrid *ReadFloatMRMSGrid(char *file, GridPool *pool);
 FloatGrid *ReadFloatMRMSGrid(char *file);
 
 #endif
@@ -2,7 +2,7 @@
 
 const char *runStyleStrings[] = {
     "simu",       "simu_rp",    "cali_ars",   "cali_dream",
-    "cali_dream_pixel",
+    "cali_dream_pixel", "cali_cascade",
     "clip_basin", "clip_gauge", "make_basic", "basin_avg",
 };
 
@@ -23,6 +23,7 @@ enum RUNSTYLE {
   STYLE_CALI_ARS,
   STYLE_CALI_DREAM,
   STYLE_CALI_DREAM_PIXEL,
+  STYLE_CALI_CASCADE,
   STYLE_CLIP_BASIN,
   STYLE_CLIP_GAUGE,
   STYLE_MAKE_BASIC,
@@ -217,6 +218,6 @@ extern const int numLakeParams[];
 
 #define IsCalibrationRunStyle(style)                                           \
   ((style) == STYLE_CALI_ARS || (style) == STYLE_CALI_DREAM ||                 \
-   (style) == STYLE_CALI_DREAM_PIXEL)
+   (style) == STYLE_CALI_DREAM_PIXEL || (style) == STYLE_CALI_CASCADE)
 
 #endif
@@ -3,6 +3,7 @@
 
 #include "BasicGrids.h"
 #include "GridWriterFull.h"
+#include "NodeIndex.h"
 #include "ParamSetConfigSection.h"
 #include "TimeUnit.h"
 #include <vector>
@@ -29,6 +30,16 @@ public:
 class WaterBalanceModel {
 
 public:
+  WaterBalanceModel() {
+    idleThreshold = 0.0;
+    numIdle = 0;
+  }
+  // Cells whose rain and soil water stay within this many mm may be skipped
+  // by models that support it. Zero only skips cells the step would not
+  // change.
+  void SetIdleThreshold(float newThreshold) { idleThreshold = newThreshold; }
+  // Cells skipped by the last WaterBalance call
+  unsigned long GetNumIdle() { return numIdle; }
   virtual bool
   InitializeModel(std::vector<GridNode> *nodes,
                   std::map<GaugeConfigSection *, float *> *paramSettings,
@@ -46,11 +57,25 @@ public:
                             std::vector<float> *groundwater) = 0;
   virtual bool IsLumped() = 0;
   virtual const char *GetName() = 0;
+
+protected:
+  float idleThreshold;
+  unsigned long numIdle;
 };
 
 class RoutingModel {
 
 public:
+  RoutingModel() {
+    idleThreshold = 0.0;
+    numIdle = 0;
+  }
+  // Cells whose inflows and outflow stay within this many cms may be skipped
+  // by models that support it. Zero only skips cells the step would not
+  // change.
+  void SetIdleThreshold(float newThreshold) { idleThreshold = newThreshold; }
+  // Cells skipped by the last Route call
+  unsigned long GetNumIdle() { return numIdle; }
   virtual bool
   InitializeModel(std::vector<GridNode> *nodes,
                   std::map<GaugeConfigSection *, float *> *paramSettings,
@@ -67,6 +92,13 @@ public:
                      std::vector<float> *discharge) = 0;
   virtual float GetMaxSpeed() = 0;
   virtual float SetObsInflow(long index, float inflow) = 0;
+  // Adds an external outflow (cms) leaving the node during the next Route, it
+  // enters the node's downstream neighbour like the node's own outflow would
+  virtual void AddBoundaryInflow(long index, float inflow) = 0;
+
+protected:
+  float idleThreshold;
+  unsigned long numIdle;
 };
 
 class SnowModel {
@@ -89,6 +121,17 @@ public:
 class InundationModel {
 
 public:
+  InundationModel() {
+    nodeIndex = NULL;
+    dischargeTolerance = 0.0;
+  }
+  // Cell lookup for the nodes later passed to InitializeModel
+  void SetNodeIndex(NodeIndex *newIndex) { nodeIndex = newIndex; }
+  // Relative change in discharge below which a model may keep the depths
+  // from its previous call. Zero only reuses them for unchanged discharge.
+  void SetDischargeTolerance(float newTolerance) {
+    dischargeTolerance = newTolerance;
+  }
   virtual bool
   InitializeModel(std::vector<GridNode> *nodes,
                   std::map<GaugeConfigSection *, float *> *paramSettings,
@@ -96,6 +139,10 @@ public:
   virtual bool Inundation(std::vector<float> *discharge,
                           std::vector<float> *depth) = 0;
   virtual const char *GetName() = 0;
+
+protected:
+  NodeIndex *nodeIndex;
+  float dischargeTolerance;
 };
 
 #endif
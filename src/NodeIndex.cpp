@@ -0,0 +1,69 @@
+#include "NodeIndex.h"
+
+NodeIndex::NodeIndex() {
+  minX = 0;
+  minY = 0;
+  width = 0;
+  height = 0;
+}
+
+void NodeIndex::Build(std::vector<GridNode> *nodes) {
+  size_t numNodes = nodes->size();
+  cells.clear();
+  width = 0;
+  height = 0;
+  BuildUpstream(nodes, &firstUp, &upNodes);
+  if (numNodes == 0) {
+    return;
+  }
+
+  long maxX = nodes->at(0).x, maxY = nodes->at(0).y;
+  minX = maxX;
+  minY = maxY;
+  for (size_t i = 1; i < numNodes; i++) {
+    GridNode *node = &(nodes->at(i));
+    if (node->x < minX) {
+      minX = node->x;
+    } else if (node->x > maxX) {
+      maxX = node->x;
+    }
+    if (node->y < minY) {
+      minY = node->y;
+    } else if (node->y > maxY) {
+      maxY = node->y;
+    }
+  }
+  width = maxX - minX + 1;
+  height = maxY - minY + 1;
+
+  cells.assign((size_t)width * height, -1);
+  for (size_t i = 0; i < numNodes; i++) {
+    GridNode *node = &(nodes->at(i));
+    cells[(node->y - minY) * width + (node->x - minX)] = (int)i;
+  }
+}
+
+void NodeIndex::BuildUpstream(std::vector<GridNode> *nodes,
+                              std::vector<unsigned long> *firstUp,
+                              std::vector<unsigned long> *upNodes) {
+  size_t numNodes = nodes->size();
+  firstUp->assign(numNodes + 1, 0);
+  for (size_t i = 0; i < numNodes; i++) {
+    unsigned long down = nodes->at(i).downStreamNode;
+    if (down != INVALID_DOWNSTREAM_NODE) {
+      (*firstUp)[down + 1]++;
+    }
+  }
+  for (size_t i = 0; i < numNodes; i++) {
+    (*firstUp)[i + 1] += (*firstUp)[i];
+  }
+
+  upNodes->resize(firstUp->back());
+  std::vector<unsigned long> fill(firstUp->begin(), firstUp->end() - 1);
+  for (size_t i = 0; i < numNodes; i++) {
+    unsigned long down = nodes->at(i).downStreamNode;
+    if (down != INVALID_DOWNSTREAM_NODE) {
+      (*upNodes)[fill[down]++] = i;
+    }
+  }
+}
@@ -0,0 +1,44 @@
+#ifndef NODE_INDEX_H
+#define NODE_INDEX_H
+
+#include "GridNode.h"
+#include <vector>
+
+// Finds the node at a grid cell and the nodes directly upstream of a node,
+// built once after CarveBasin. The cell lookup is a dense row-major table
+// over the bounding box of the carved nodes. The upstream lists are stored
+// CSR style: the upstream nodes of node i are upNodes[firstUp[i]] up to
+// upNodes[firstUp[i + 1] - 1], in index order.
+class NodeIndex {
+
+public:
+  NodeIndex();
+  void Build(std::vector<GridNode> *nodes);
+
+  // Index of the node at grid cell (x, y), -1 if the cell was not carved
+  long Find(long x, long y) const {
+    x -= minX;
+    y -= minY;
+    if (x < 0 || y < 0 || x >= width || y >= height) {
+      return -1;
+    }
+    return cells[y * width + x];
+  }
+  unsigned long GetNumUpstream(unsigned long node) const {
+    return firstUp[node + 1] - firstUp[node];
+  }
+  const unsigned long *GetUpstream(unsigned long node) const {
+    return upNodes.empty() ? NULL : &(upNodes[firstUp[node]]);
+  }
+
+  static void BuildUpstream(std::vector<GridNode> *nodes,
+                            std::vector<unsigned long> *firstUp,
+                            std::vector<unsigned long> *upNodes);
+
+private:
+  long minX, minY, width, height;
+  std::vector<int> cells;
+  std::vector<unsigned long> firstUp, upNodes;
+};
+
+#endif
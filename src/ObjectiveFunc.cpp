@@ -13,179 +13,94 @@ const OBJECTIVE_GOAL objectiveGoals[] = {
     OBJECTIVE_GOAL_MAXIMIZE,
 };
 
-// Internal functions for calculating actual objective function scores
-static float CalcLOGNSCE(std::vector<float> *obs, std::vector<float> *sim);
-static float CalcNSCE(std::vector<float> *obs, std::vector<float> *sim);
-static float CalcCC(std::vector<float> *obs, std::vector<float> *sim);
-static float CalcSSE(std::vector<float> *obs, std::vector<float> *sim);
-static float CalcKGE(std::vector<float> *obs, std::vector<float> *sim);
-
 // This is the main function for calculating objective functions, everything
 // passes through here first.
 float CalcObjFunc(std::vector<float> *obs, std::vector<float> *sim,
                   OBJECTIVES obj) {
-
-  switch (obj) {
-  case OBJECTIVE_NSCE:
-    return CalcNSCE(obs,sim);
-  case OBJECTIVE_LOGNSCE:
-    return CalcLOGNSCE(obs, sim);
-  case OBJECTIVE_CC:
-    return CalcCC(obs, sim);
-  case OBJECTIVE_SSE:
-    return CalcSSE(obs, sim);
-  case OBJECTIVE_KGE:
-    return CalcKGE(obs, sim);
-  default:
-    return 0;
+  ObjectiveAccumulator acc;
+  if (!obs->empty()) {
+    acc.AddSeries(&(obs->at(0)), &(sim->at(0)), obs->size());
   }
+  return acc.GetScore(obj);
 }
 
-float CalcNSCE(std::vector<float> *obs, std::vector<float> *sim) {
-
-  float obsMean = 0, obsAcc = 0, simAcc = 0, validQs = 0;
-  size_t totalTimeSteps = obs->size();
-  for (size_t tsIndex = 0; tsIndex < totalTimeSteps; tsIndex++) {
-    if ((*obs)[tsIndex] == (*obs)[tsIndex] &&
-        (*sim)[tsIndex] == (*sim)[tsIndex]) {
-      obsMean += (*obs)[tsIndex];
-      validQs++;
-    }
-  }
-
-  obsMean /= validQs;
-
-  for (size_t tsIndex = 0; tsIndex < totalTimeSteps; tsIndex++) {
-    if ((*obs)[tsIndex] == (*obs)[tsIndex] &&
-        (*sim)[tsIndex] == (*sim)[tsIndex]) {
-      // printf("%f %f\n", (*obs)[tsIndex], (*sim)[tsIndex]);
-      obsAcc += powf((*obs)[tsIndex] - obsMean, 2.0);
-      simAcc += powf((*obs)[tsIndex] - (*sim)[tsIndex], 2.0);
-    }
-  }
-
-  float result = 1.0 - (simAcc / obsAcc);
-  if (result == result) {
-    return result;
-  } else {
-    return -10000000000.0;
-  }
+void ObjectiveAccumulator::Reset() {
+  count = 0;
+  logCount = 0;
+  obsMean = simMean = obsM2 = simM2 = coM2 = sse = 0.0;
+  logObsMean = logObsRawMean = logObsM2 = logSSE = 0.0;
 }
 
-float CalcLOGNSCE(std::vector<float> *obs, std::vector<float> *sim){
-  float obsMean = 0, obsAcc = 0, simAcc = 0, validQs = 0;
-  size_t totalTimeSteps = obs->size();
-  for (size_t tsIndex = 0; tsIndex < totalTimeSteps; tsIndex++) {
-    if ((*obs)[tsIndex] == (*obs)[tsIndex] &&
-        (*sim)[tsIndex] == (*sim)[tsIndex]&&
-        (*sim)[tsIndex] !=0 &&
-        (*obs)[tsIndex] !=0) {
-      obsMean += (*obs)[tsIndex];
-      validQs++;
-    }
+void ObjectiveAccumulator::Add(float obs, float sim) {
+  if (obs != obs || sim != sim) {
+    return;
   }
 
-  obsMean /= validQs;
-  float logobsMean= log(obsMean);
-
-  for (size_t tsIndex = 0; tsIndex < totalTimeSteps; tsIndex++) {
-    if ((*obs)[tsIndex] == (*obs)[tsIndex] &&
-        (*sim)[tsIndex] == (*sim)[tsIndex] &&
-        (*sim)[tsIndex] !=0 &&
-        (*obs)[tsIndex] !=0) {
-      // printf("%f %f\n", (*obs)[tsIndex], (*sim)[tsIndex]);
-      obsAcc += powf( log((*obs)[tsIndex]) - logobsMean, 2.0);
-      simAcc += powf( log((*obs)[tsIndex]) - log((*sim)[tsIndex]), 2.0);
-    }
+  count++;
+  double dObs = obs - obsMean;
+  obsMean += dObs / count;
+  double dSim = sim - simMean;
+  simMean += dSim / count;
+  obsM2 += dObs * (obs - obsMean);
+  simM2 += dSim * (sim - simMean);
+  coM2 += dObs * (sim - simMean);
+  sse += ((double)obs - sim) * ((double)obs - sim);
+
+  if (obs != 0 && sim != 0) {
+    logCount++;
+    double logObs = log(obs), logSim = log(sim);
+    double dLog = logObs - logObsMean;
+    logObsMean += dLog / logCount;
+    logObsM2 += dLog * (logObs - logObsMean);
+    logObsRawMean += (obs - logObsRawMean) / logCount;
+    logSSE += (logObs - logSim) * (logObs - logSim);
   }
-
-  float result = 1.0 - (simAcc / obsAcc);
-  if (result == result) {
-    return result;
-  } else {
-    return -10000000000.0;
-  }  
 }
 
-float CalcCC(std::vector<float> *obs, std::vector<float> *sim) {
-
-  float obsMean = 0, simMean = 0, obsAcc2 = 0, obsAcc = 0, simAcc = 0;
-  size_t validQs = 0, totalTimeSteps = obs->size();
-  for (size_t tsIndex = 0; tsIndex < totalTimeSteps; tsIndex++) {
-    if ((*obs)[tsIndex] == (*obs)[tsIndex] &&
-        (*sim)[tsIndex] == (*sim)[tsIndex]) {
-      obsMean += (*obs)[tsIndex];
-      simMean += (*sim)[tsIndex];
-      validQs++;
-    }
-  }
-
-  obsMean /= validQs;
-  simMean /= validQs;
-
-  for (size_t tsIndex = 0; tsIndex < totalTimeSteps; tsIndex++) {
-    if ((*obs)[tsIndex] == (*obs)[tsIndex] &&
-        (*sim)[tsIndex] == (*sim)[tsIndex]) {
-      obsAcc += pow((*obs)[tsIndex] - obsMean, 2);
-      simAcc += pow((*sim)[tsIndex] - simMean, 2);
-      obsAcc2 += (((*obs)[tsIndex] - obsMean) * ((*sim)[tsIndex] - simMean));
-    }
+void ObjectiveAccumulator::AddSeries(const float *obs, const float *sim,
+                                     size_t num) {
+  for (size_t i = 0; i < num; i++) {
+    Add(obs[i], sim[i]);
   }
-
-  obsAcc = sqrt(obsAcc);
-  simAcc = sqrt(simAcc);
-
-  return obsAcc2 / (obsAcc * simAcc);
 }
 
-float CalcSSE(std::vector<float> *obs, std::vector<float> *sim) {
-
-  float sse = 0;
-  size_t totalTimeSteps = obs->size();
-
-  for (size_t tsIndex = 0; tsIndex < totalTimeSteps; tsIndex++) {
-    if ((*obs)[tsIndex] == (*obs)[tsIndex] &&
-        (*sim)[tsIndex] == (*sim)[tsIndex]) {
-      sse += pow((*obs)[tsIndex] - (*sim)[tsIndex], 2);
-    }
+float ObjectiveAccumulator::GetScore(OBJECTIVES obj) {
+  double result;
+  switch (obj) {
+  case OBJECTIVE_NSCE:
+    result = 1.0 - sse / obsM2;
+    break;
+  case OBJECTIVE_LOGNSCE: {
+    // Deviations are taken from the log of the mean flow, not the mean of
+    // the log flows
+    double offset = logObsMean - log(logObsRawMean);
+    result = 1.0 - logSSE / (logObsM2 + logCount * offset * offset);
+    break;
   }
-
-  return sse;
-}
-// TODO
-float CalcKGE(std::vector<float> *obs, std::vector<float> *sim){
-  float obsMean = 0,simMean = 0, obsAcc = 0, simAcc = 0, validQs = 0, simVar=0, obsAcc2=0;
-  size_t totalTimeSteps = obs->size();
-  for (size_t tsIndex = 0; tsIndex < totalTimeSteps; tsIndex++) {
-    if ((*obs)[tsIndex] == (*obs)[tsIndex] &&
-        (*sim)[tsIndex] == (*sim)[tsIndex]) {
-      obsMean += (*obs)[tsIndex];
-      simMean += (*sim)[tsIndex];
-      validQs++;
-    }
+  case OBJECTIVE_CC:
+    return (float)(coM2 / sqrt(obsM2 * simM2));
+  case OBJECTIVE_SSE:
+    return (float)sse;
+  case OBJECTIVE_KGE: {
+    double r = coM2 / sqrt(obsM2 * simM2);
+    double beta = simMean / obsMean;
+    double gamma = (sqrt(simM2 / count) / simMean) /
+                   (sqrt(obsM2 / count) / obsMean);
+    result = 1.0 - sqrt((r - 1.0) * (r - 1.0) + (beta - 1.0) * (beta - 1.0) +
+                        (gamma - 1.0) * (gamma - 1.0));
+    break;
   }
-
-  obsMean /= validQs;
-  simMean /= validQs;
-
-  for (size_t tsIndex = 0; tsIndex < totalTimeSteps; tsIndex++) {
-    if ((*obs)[tsIndex] == (*obs)[tsIndex] &&
-        (*sim)[tsIndex] == (*sim)[tsIndex]) {
-      // printf("%f %f\n", (*obs)[tsIndex], (*sim)[tsIndex]);
-      obsAcc += powf((*obs)[tsIndex] - obsMean, 2.0);
-      obsAcc2 += (((*obs)[tsIndex] - obsMean) * ((*sim)[tsIndex] - simMean));
-      simAcc += powf((*obs)[tsIndex] - (*sim)[tsIndex], 2.0);
-      simVar += powf((*sim)[tsIndex] - simMean, 2.0);
-    }
+  default:
+    return 0;
   }
-  float r= obsAcc2 / (sqrt(obsAcc) * sqrt(simAcc));
-  float beta= simMean/obsMean;
-  float gamma= sqrt(simVar)/simMean/(sqrt(obsAcc/obsMean));
-  float result= 1 - sqrt(powf(r-1,2)+powf(beta-1,2)+powf(gamma-1,2));
 
   if (result == result) {
-    return result;
+    return (float)result;
   } else {
     return -10000000000.0;
-  }  
+  }
+}
+
+float ObjectiveAccumulator::GetBias() {
+  return (float)(100.0 * (simMean - obsMean) / obsMean);
 }
@@ -1,6 +1,7 @@
 #ifndef OBJECTIVE_FUNC_H
 #define OBJECTIVE_FUNC_H
 
+#include <cstddef>
 #include <vector>
 
 enum OBJECTIVES {
@@ -23,4 +24,26 @@ extern const OBJECTIVE_GOAL objectiveGoals[];
 float CalcObjFunc(std::vector<float> *obs, std::vector<float> *sim,
                   OBJECTIVES obj);
 
+// Streaming skill accumulator. Every objective is derived from the same
+// running (Welford) moments, so a simulation can feed it one observed and
+// simulated pair per time step and read all scores at the end. Pairs with a
+// NaN on either side are skipped; the log-space terms only see pairs where
+// both values are non-zero.
+class ObjectiveAccumulator {
+public:
+  ObjectiveAccumulator() { Reset(); }
+  void Reset();
+  void Add(float obs, float sim);
+  void AddSeries(const float *obs, const float *sim, size_t count);
+  float GetScore(OBJECTIVES obj);
+  // Mean simulated over mean observed, as a percentage difference
+  float GetBias();
+  long GetCount() { return count; }
+
+private:
+  long count, logCount;
+  double obsMean, simMean, obsM2, simM2, coM2, sse;
+  double logObsMean, logObsRawMean, logObsM2, logSSE;
+};
+
 #endif
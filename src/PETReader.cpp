@@ -28,16 +28,16 @@ bool PETReader::Read(char *file, SUPPORTED_PET_TYPES type,
 
   switch (type) {
   case PET_ASCII:
-    petGrid = ReadFloatAscGrid(file);
+    petGrid = ReadFloatAscGrid(file, &gridPool);
     break;
   case PET_BIF:
-    petGrid = ReadFloatBifGrid(file);
+    petGrid = ReadFloatBifGrid(file, &gridPool);
     break;
   case PET_TIF:
-    petGrid = ReadFloatTifGrid(file);
+    petGrid = ReadFloatTifGrid(file, &gridPool);
     break;
   case PET_PQF:
-    petGrid = ReadFloatPqfGrid(file);
+    petGrid = ReadFloatPqfGrid(file, &gridPool);
     break;
   default:
     ERROR_LOG("Unsupported PET format!");
@@ -107,7 +107,7 @@ bool PETReader::Read(char *file, SUPPORTED_PET_TYPES type,
   }
 
   // We don't actually need to keep the PET grid in memory anymore
-  delete petGrid;
+  gridPool.Release(petGrid);
 
   return true;
 }
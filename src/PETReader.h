@@ -3,6 +3,7 @@
 
 #include "BasicGrids.h"
 #include "Defines.h"
+#include "GridPool.h"
 #include "PETType.h"
 #include <vector>
 
@@ -11,9 +12,11 @@ public:
   bool Read(char *file, SUPPORTED_PET_TYPES type, std::vector<GridNode> *nodes,
             std::vector<float> *currentPET, float petConvert, bool isTemp,
             float jday, std::vector<float> *prevPET = NULL);
+  GridPool *GetGridPool() { return &gridPool; }
 
 private:
   char lastPETFile[CONFIG_MAX_LEN * 2];
+  GridPool gridPool;
 };
 
 #endif
@@ -9,7 +9,8 @@
 
 // Built without Apache Arrow: PQF forcing is unavailable. Return NULL so the
 // reader reports a missing file (zeros) rather than crashing.
-FloatGrid *ReadFloatPqfGrid(char *file) {
+FloatGrid *ReadFloatPqfGrid(char *file, GridPool *pool) {
+  (void)pool;
   WARNING_LOGF("PQF/Parquet support not compiled in (configure --with-arrow); "
                "cannot read %s",
                file);
@@ -40,7 +41,7 @@ static double KvGet(const std::shared_ptr<const arrow::KeyValueMetadata> &kv,
   return atof(r.ValueOrDie().c_str());
 }
 
-FloatGrid *ReadFloatPqfGrid(char *file) {
+FloatGrid *ReadFloatPqfGrid(char *file, GridPool *pool) {
   // Open the file.
   arrow::Result<std::shared_ptr<arrow::io::ReadableFile>> infileR =
       arrow::io::ReadableFile::Open(file);
@@ -88,20 +89,20 @@ FloatGrid *ReadFloatPqfGrid(char *file) {
     return NULL;
   }
 
-  FloatGrid *grid = new FloatGrid();
-  grid->numCols = ncols;
-  grid->numRows = nrows;
+  FloatGrid *grid = NewFloatGrid(pool, ncols, nrows);
+  if (!grid) {
+    WARNING_LOGF("PQF file %s too large (out of memory) with %li rows and "
+                 "%li columns",
+                 file, nrows, ncols);
+    return NULL;
+  }
   grid->cellSize = cellsize;
   grid->extent.left = xll;
   grid->extent.bottom = yll;
   grid->extent.top = yll + nrows * cellsize;
   grid->extent.right = xll + ncols * cellsize;
   grid->noData = nodata;
-
-  grid->data = new float *[nrows]();
-  for (long i = 0; i < nrows; i++) {
-    grid->data[i] = new float[ncols];
-  }
+  grid->geoSet = false;
 
   // Copy float values out chunk-by-chunk into row-major data[row][col].
   long flat = 0;
@@ -124,3 +125,7 @@ FloatGrid *ReadFloatPqfGrid(char *file) {
 }
 
 #endif // HAVE_PARQUET
+
+FloatGrid *ReadFloatPqfGrid(char *file) {
+  return ReadFloatPqfGrid(file, NULL);
+}
@@ -2,6 +2,7 @@
 #define PQF_GRID_H
 
 #include "Grid.h"
+#include "GridPool.h"
 
 /* Parquet forcing grid ("PQF").
  *
@@ -17,5 +18,6 @@
  * Apache Arrow (--with-arrow not given) this reader is a stub returning NULL.
  */
 FloatGrid *ReadFloatPqfGrid(char *file);
+FloatGrid *ReadFloatPqfGrid(char *file, GridPool *pool);
 
 #endif
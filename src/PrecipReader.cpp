@@ -35,22 +35,22 @@ bool PrecipReader::Read(char *file, SUPPORTED_PRECIP_TYPES type,
 
   switch (type) {
   case PRECIP_ASCII:
-    precipGrid = ReadFloatAscGrid(file);
+    precipGrid = ReadFloatAscGrid(file, &gridPool);
     break;
   case PRECIP_BIF:
-    precipGrid = ReadFloatBifGrid(file);
+    precipGrid = ReadFloatBifGrid(file, &gridPool);
     break;
   case PRECIP_TIF:
-    precipGrid = ReadFloatTifGrid(file);
+    precipGrid = ReadFloatTifGrid(file, &gridPool);
     break;
   case PRECIP_PQF:
-    precipGrid = ReadFloatPqfGrid(file);
+    precipGrid = ReadFloatPqfGrid(file, &gridPool);
     break;
   case PRECIP_MRMS:
-    precipGrid = ReadFloatMRMSGrid(file);
+    precipGrid = ReadFloatMRMSGrid(file, &gridPool);
     break;
   case PRECIP_TRMMRT:
-    precipGrid = ReadFloatTRMMRTGrid(file, precipGrid);
+    precipGrid = ReadFloatTRMMRTGrid(file, &gridPool);
     break;
     // case PRECIP_TRMMV7:
     //	precipGrid = ReadFloatTRMMV6Grid(file);
@@ -108,7 +108,7 @@ bool PrecipReader::Read(char *file, SUPPORTED_PRECIP_TYPES type,
     }
   }
 
-  delete precipGrid;
+  gridPool.Release(precipGrid);
 
   return true;
 }
@@ -3,6 +3,7 @@
 
 #include "BasicGrids.h"
 #include "Defines.h"
+#include "GridPool.h"
 #include "PrecipType.h"
 #include <vector>
 
@@ -12,9 +13,11 @@ public:
             std::vector<GridNode> *nodes, std::vector<float> *currentPrecip,
             float precipConvert, std::vector<float> *prevPrecip = NULL,
             bool hasQPF = false);
+  GridPool *GetGridPool() { return &gridPool; }
 
 private:
   char lastPrecipFile[CONFIG_MAX_LEN * 2];
+  GridPool gridPool;
 };
 
 #endif
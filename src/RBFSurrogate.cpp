@@ -0,0 +1,182 @@
+#include "RBFSurrogate.h"
+#include <cmath>
+
+RBFSurrogate::RBFSurrogate() {
+  numParams = 0;
+  maxPoints = 0;
+  nextSlot = 0;
+  fitted = false;
+  lengthScale = 1.0;
+  meanValue = 0.0;
+}
+
+void RBFSurrogate::Initialize(int numParamsNew, float *paramMins,
+                              float *paramMaxs, int maxPointsNew) {
+  numParams = numParamsNew;
+  maxPoints = maxPointsNew;
+  nextSlot = 0;
+  fitted = false;
+  mins.resize(numParams);
+  ranges.resize(numParams);
+  scratch.resize(numParams);
+  for (int i = 0; i < numParams; i++) {
+    mins[i] = paramMins[i];
+    ranges[i] = paramMaxs[i] - paramMins[i];
+    if (ranges[i] <= 0.0) {
+      ranges[i] = 1.0;
+    }
+  }
+  points.clear();
+  values.clear();
+}
+
+void RBFSurrogate::Scale(float *params, double *out) {
+  for (int i = 0; i < numParams; i++) {
+    out[i] = (params[i] - mins[i]) / ranges[i];
+  }
+}
+
+double RBFSurrogate::Kernel(const double *a, const double *b) {
+  double dist = 0.0;
+  for (int i = 0; i < numParams; i++) {
+    double diff = a[i] - b[i];
+    dist += diff * diff;
+  }
+  return exp(-dist / (2.0 * lengthScale * lengthScale));
+}
+
+// Non-finite scores (failed simulations) are not worth learning from
+void RBFSurrogate::AddPoint(float *params, float value) {
+  if (!std::isfinite(value)) {
+    return;
+  }
+
+  if ((int)values.size() < maxPoints) {
+    points.push_back(std::vector<double>(numParams));
+    values.push_back(value);
+    Scale(params, &(points.back()[0]));
+  } else {
+    // Overwrite the oldest point once the window is full
+    Scale(params, &(points[nextSlot][0]));
+    values[nextSlot] = value;
+    nextSlot = (nextSlot + 1) % maxPoints;
+  }
+}
+
+// Solves (K + ridge * I) w = y - mean with a Cholesky factorization. The
+// length scale follows the mean spacing of the training points.
+bool RBFSurrogate::Fit() {
+  int m = (int)values.size();
+  fitted = false;
+  if (m < numParams + 2) {
+    return false;
+  }
+
+  meanValue = 0.0;
+  for (int i = 0; i < m; i++) {
+    meanValue += values[i];
+  }
+  meanValue /= m;
+
+  double distSum = 0.0;
+  long pairs = 0;
+  for (int i = 0; i < m; i++) {
+    for (int j = i + 1; j < m; j++) {
+      double dist = 0.0;
+      for (int k = 0; k < numParams; k++) {
+        double diff = points[i][k] - points[j][k];
+        dist += diff * diff;
+      }
+      distSum += sqrt(dist);
+      pairs++;
+    }
+  }
+  lengthScale = (distSum > 0.0) ? 0.5 * distSum / pairs : 1.0;
+
+  std::vector<double> chol(m * m);
+  for (int i = 0; i < m; i++) {
+    for (int j = 0; j <= i; j++) {
+      chol[i * m + j] = Kernel(&(points[i][0]), &(points[j][0]));
+    }
+    chol[i * m + i] += 1e-3;
+  }
+
+  // In-place lower triangular Cholesky
+  for (int j = 0; j < m; j++) {
+    double diag = chol[j * m + j];
+    for (int k = 0; k < j; k++) {
+      diag -= chol[j * m + k] * chol[j * m + k];
+    }
+    if (diag <= 0.0) {
+      return false;
+    }
+    diag = sqrt(diag);
+    chol[j * m + j] = diag;
+    for (int i = j + 1; i < m; i++) {
+      double val = chol[i * m + j];
+      for (int k = 0; k < j; k++) {
+        val -= chol[i * m + k] * chol[j * m + k];
+      }
+      chol[i * m + j] = val / diag;
+    }
+  }
+
+  // Forward then backward substitution
+  weights.resize(m);
+  for (int i = 0; i < m; i++) {
+    double val = values[i] - meanValue;
+    for (int k = 0; k < i; k++) {
+      val -= chol[i * m + k] * weights[k];
+    }
+    weights[i] = val / chol[i * m + i];
+  }
+  for (int i = m - 1; i >= 0; i--) {
+    double val = weights[i];
+    for (int k = i + 1; k < m; k++) {
+      val -= chol[k * m + i] * weights[k];
+    }
+    weights[i] = val / chol[i * m + i];
+  }
+
+  fitted = true;
+  return true;
+}
+
+float RBFSurrogate::Predict(float *params) {
+  if (!fitted) {
+    return (float)meanValue;
+  }
+
+  Scale(params, &(scratch[0]));
+  double result = meanValue;
+  for (size_t i = 0; i < weights.size(); i++) {
+    result += weights[i] * Kernel(&(scratch[0]), &(points[i][0]));
+  }
+  return (float)result;
+}
+
+bool RBFSurrogate::Write(FILE *file) {
+  for (size_t i = 0; i < values.size(); i++) {
+    if (fwrite(&(points[i][0]), sizeof(double), numParams, file) !=
+            (size_t)numParams ||
+        fwrite(&(values[i]), sizeof(double), 1, file) != 1) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool RBFSurrogate::Read(FILE *file, int numPoints, int nextSlotNew) {
+  points.assign(numPoints, std::vector<double>(numParams));
+  values.resize(numPoints);
+  for (int i = 0; i < numPoints; i++) {
+    if (fread(&(points[i][0]), sizeof(double), numParams, file) !=
+            (size_t)numParams ||
+        fread(&(values[i]), sizeof(double), 1, file) != 1) {
+      return false;
+    }
+  }
+  nextSlot = nextSlotNew;
+  Fit();
+  return true;
+}
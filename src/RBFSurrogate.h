@@ -0,0 +1,40 @@
+#ifndef RBF_SURROGATE_H
+#define RBF_SURROGATE_H
+
+#include <cstdio>
+#include <vector>
+
+// Gaussian radial basis function regressor used by DREAM to pre-screen
+// proposals. Parameters are scaled to the unit cube by the calibration
+// bounds and only the most recent maxPoints evaluations are kept.
+class RBFSurrogate {
+public:
+  RBFSurrogate();
+  void Initialize(int numParamsNew, float *paramMins, float *paramMaxs,
+                  int maxPointsNew);
+  void AddPoint(float *params, float value);
+  bool Fit();
+  bool IsReady() { return fitted; }
+  float Predict(float *params);
+  int GetNumPoints() { return (int)values.size(); }
+  int GetNextSlot() { return nextSlot; }
+
+  // Raw training window for DREAM checkpoints; Fit() restores the weights
+  bool Write(FILE *file);
+  bool Read(FILE *file, int numPoints, int nextSlotNew);
+
+private:
+  void Scale(float *params, double *out);
+  double Kernel(const double *a, const double *b);
+
+  int numParams, maxPoints, nextSlot;
+  bool fitted;
+  double lengthScale, meanValue;
+  std::vector<double> mins, ranges;
+  std::vector<std::vector<double> > points;
+  std::vector<double> values;
+  std::vector<double> weights;
+  std::vector<double> scratch;
+};
+
+#endif
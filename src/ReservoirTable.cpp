@@ -0,0 +1,140 @@
+#include "ReservoirTable.h"
+#include "LakeMap.h"
+#include "LakeModel.h"
+#include "Messages.h"
+
+ReservoirTable::ReservoirTable() {}
+
+void ReservoirTable::Initialize(std::vector<LakeModelImpl *> *newLakes) {
+  lakes = *newLakes;
+  size_t numLakes = lakes.size();
+  storage.resize(numLakes);
+  thVolume.resize(numLakes);
+  area.resize(numLakes);
+  paramA.resize(numLakes);
+  paramB.resize(numLakes);
+  outflow.resize(numLakes);
+  inflow.resize(numLakes);
+  node.resize(numLakes);
+  warnedDt.assign(numLakes, 0);
+  outputIds.clear();
+
+  for (size_t i = 0; i < numLakes; i++) {
+    LakeModelImpl *lake = lakes[i];
+    storage[i] = lake->storage;
+    thVolume[i] = lake->th_volume;
+    area[i] = lake->area;
+    paramA[i] = lake->param_a;
+    paramB[i] = lake->param_b;
+    outflow[i] = lake->outflow;
+    inflow[i] = lake->inflow;
+    node[i] = lake->lakeNodeIndex;
+    if (lake->outputts && node[i] >= 0) {
+      outputIds.push_back(i);
+    }
+  }
+}
+
+void ReservoirTable::LoadStates() {
+  for (size_t i = 0; i < lakes.size(); i++) {
+    storage[i] = lakes[i]->storage;
+    outflow[i] = lakes[i]->outflow;
+  }
+}
+
+void ReservoirTable::StoreStates() {
+  for (size_t i = 0; i < lakes.size(); i++) {
+    LakeModelImpl *lake = lakes[i];
+    lake->storage = storage[i];
+    lake->outflow = outflow[i];
+    lake->inflow = inflow[i];
+    lake->lakeNode.storage = storage[i];
+    lake->lakeNode.outflow = outflow[i];
+    lake->lakeNode.inflow = inflow[i];
+    lake->lakeNode.states[STATE_LAKE_STORAGE] = (float)storage[i];
+    lake->lakeNode.states[STATE_LAKE_OUTFLOW] = (float)outflow[i];
+  }
+}
+
+void ReservoirTable::VerticalBalance(std::vector<float> *precip,
+                                     std::vector<float> *pet) {
+  long numLakes = (long)storage.size(), numValues = (long)precip->size();
+  if ((long)pet->size() < numValues) {
+    numValues = (long)pet->size();
+  }
+  for (long i = 0; i < numLakes; i++) {
+    long n = node[i];
+    if (n < 0 || n >= numValues) {
+      continue;
+    }
+    // mm over the lake area to m^3
+    storage[i] += ((double)(*precip)[n] * 1e-3 * area[i]) -
+                  ((double)(*pet)[n] * 1e-3 * area[i]);
+    if (storage[i] < 0) {
+      storage[i] = 0;
+    }
+  }
+}
+
+void ReservoirTable::HorizontalBalance(float stepHours,
+                                       std::vector<float> *currentQ,
+                                       long step, LakeMap *lakeMap) {
+  double dtSeconds = (double)(stepHours * 3600.0);
+  for (size_t i = 0; i < storage.size(); i++) {
+    if (node[i] < 0) {
+      continue;
+    }
+    float lakeInflow = lakeMap->CalculateInflow(i, currentQ, step);
+    double lakeOutflow = StepInflow(i, (double)lakeInflow, dtSeconds, step);
+    if (node[i] < (long)currentQ->size()) {
+      (*currentQ)[node[i]] = (float)lakeOutflow;
+    }
+  }
+}
+
+double ReservoirTable::StepInflow(size_t id, double inflowCMS,
+                                  double dtSeconds, long step) {
+  inflow[id] = inflowCMS;
+
+  // Warn once if the timestep is larger than the lake's residence time. The
+  // outflow is not capped, that would break the water mass balance.
+  double stepHours = dtSeconds / 3600.0;
+  if (!warnedDt[id] && paramA[id] > 0.0 && stepHours > paramA[id]) {
+    WARNING_LOGF("Lake %s: timestep (%.4g h) exceeds the lake residence time "
+                 "klake=%.4g h. Outflow may overshoot available storage and "
+                 "degrade the simulation; consider a smaller timestep.",
+                 lakes[id]->lakeName.c_str(), stepHours, paramA[id]);
+    warnedDt[id] = 1;
+  }
+
+  double lakeStorage = storage[id] + inflowCMS * dtSeconds;
+  double lakeOutflow = lakes[id]->GetEngineeredDischarge(step);
+  if (lakeOutflow == 0.0) {
+    if (lakeStorage > thVolume[id]) {
+      // Overflow: spill the excess above the threshold
+      lakeOutflow = (lakeStorage - thVolume[id]) / dtSeconds;
+      lakeStorage = thVolume[id];
+    } else {
+      // Dry season: linear-reservoir outflow
+      lakeOutflow = LakeCalculations::CalculateLinearReservoirOutflow(
+          lakeStorage, thVolume[id], paramA[id], paramB[id]);
+      lakeStorage -= lakeOutflow * dtSeconds;
+    }
+  } else {
+    // Engineered (dam-controlled) release
+    lakeStorage -= lakeOutflow * dtSeconds;
+  }
+  if (lakeStorage < 0) {
+    lakeStorage = 0;
+  }
+  storage[id] = lakeStorage;
+  outflow[id] = lakeOutflow;
+  return lakeOutflow;
+}
+
+void ReservoirTable::GetOutputVolumes(std::vector<float> *volume) {
+  for (size_t i = 0; i < outputIds.size(); i++) {
+    size_t id = outputIds[i];
+    (*volume)[node[id]] = (float)storage[id];
+  }
+}
@@ -0,0 +1,57 @@
+#ifndef RESERVOIR_TABLE_H
+#define RESERVOIR_TABLE_H
+
+#include "GridNode.h"
+#include <vector>
+
+class LakeMap;
+class LakeModelImpl;
+
+// The per-step state of every lake module reservoir, one array per field and
+// indexed by a dense lake id (the lake's position in the list given to
+// Initialize). The LakeModelImpl objects keep the configuration, location,
+// engineered discharge and state file I/O; the storage updates run here so a
+// step over thousands of lakes is a pass over a few arrays instead of a call
+// per lake object. The reservoir equations are those of
+// LakeModelImpl::StepReservoirInflow.
+class ReservoirTable {
+
+public:
+  ReservoirTable();
+  // Call after the lakes' InitializeModel, which finds their nodes
+  void Initialize(std::vector<LakeModelImpl *> *newLakes);
+  size_t GetNumLakes() { return storage.size(); }
+  long GetNode(size_t id) { return node[id]; }
+
+  // Copies storage and outflow in from the lakes after they load states
+  void LoadStates();
+  // Copies the state back to the lakes before they save it
+  void StoreStates();
+
+  // storage += P - E over the lake area for every lake
+  void VerticalBalance(std::vector<float> *precip, std::vector<float> *pet);
+  // Steps every lake not coupled into the router from its LakeMap inflow and
+  // writes the regulated outflow into its cell's Q. Lakes go in id order
+  // since one lake's outflow can be the next one's inflow.
+  void HorizontalBalance(float stepHours, std::vector<float> *currentQ,
+                         long step, LakeMap *lakeMap);
+  // Reservoir step for one lake: adds the inflow (m^3/s) over dtSeconds and
+  // returns the regulated outflow (m^3/s). step is the simulation step for
+  // the engineered discharge, -1 for none.
+  double StepInflow(size_t id, double inflowCMS, double dtSeconds, long step);
+
+  // Lakes flagged outputts, resolved once at Initialize
+  bool HasOutputTS() { return !outputIds.empty(); }
+  // Writes the storage of every outputts lake at its node
+  void GetOutputVolumes(std::vector<float> *volume);
+
+private:
+  std::vector<LakeModelImpl *> lakes;
+  std::vector<double> storage, thVolume, area, paramA, paramB, outflow,
+      inflow;
+  std::vector<long> node;
+  std::vector<unsigned char> warnedDt;
+  std::vector<size_t> outputIds;
+};
+
+#endif
@@ -5,6 +5,8 @@
 #include <omp.h>
 #endif
 #include "BasicGrids.h"
+#include "CacheHash.h"
+#include "CaliWorkerPool.h"
 #include "CRESTModel.h"
 #include "CRESTPhysModel.h"
 #include "LakeModel.h"
@@ -129,6 +131,7 @@ bool Simulator::InitializeBasic(TaskConfigSection *task) {
   endTime = *(task->GetTimeEnd());  // Leave for multi-event calibration if necessary
   endTimes= *(task->GetTimeEnds());
   warmEndTime = *(task->GetTimeWarmEnd());
+  BuildStepTimes();
 
   // Initialize file name information
   precipFile = task->GetPrecipSec()->GetFileName();
@@ -241,6 +244,7 @@ bool Simulator::InitializeBasic(TaskConfigSection *task) {
 
   // Carve lake parameters from lake data to grid nodes
   CarveLakeParameters(task->GetBasinSec(), &nodes);
+  nodeIndex.Build(&nodes);
 
   // Ensure we actually have at least one node to work with!
   if (nodes.size() == 0) {
@@ -268,11 +272,20 @@ bool Simulator::InitializeBasic(TaskConfigSection *task) {
   case MODEL_LAKE: {
     // Check if lakes are defined in basin configuration
     std::vector<LakeInfo> *basinLakes = task->GetBasinSec()->GetLakes();
-    std::map<std::string, double> *basinEngineeredDischarge = task->GetBasinSec()->GetEngineeredDischarge();
+    std::map<std::string, std::map<time_t, double> > *basinEngineeredDischarge = task->GetBasinSec()->GetEngineeredDischarge();
     
     if (basinLakes && !basinLakes->empty()) {
       // Use the first lake from the basin configuration
-      wbModel = new LakeModelImpl(basinLakes->at(0), false, basinEngineeredDischarge);
+      std::map<std::string, std::map<time_t, double> >::iterator dischargeItr =
+          basinEngineeredDischarge->find(basinLakes->at(0).name);
+      LakeModelImpl *lake;
+      if (dischargeItr != basinEngineeredDischarge->end()) {
+        lake = new LakeModelImpl(basinLakes->at(0), true, &(dischargeItr->second));
+      } else {
+        lake = new LakeModelImpl(basinLakes->at(0), false, NULL);
+      }
+      lake->AlignToSteps(stepTimes);
+      wbModel = lake;
       // Lake model created without logging
     } else {
       // Fall back to default lake info
@@ -360,10 +373,20 @@ bool Simulator::InitializeBasic(TaskConfigSection *task) {
     if (task->GetBasinSec()->GetLakes() && !task->GetBasinSec()->GetLakes()->empty()) {
       // Use lakes from CSV file for additional lake processing
       std::vector<LakeInfo> *lakes = task->GetBasinSec()->GetLakes();
-      std::map<std::string, double> *basinEngineeredDischarge = task->GetBasinSec()->GetEngineeredDischarge();
+      std::map<std::string, std::map<time_t, double> > *basinEngineeredDischarge = task->GetBasinSec()->GetEngineeredDischarge();
       
+      // Lakes with a column in the engineered discharge CSV release it
+      // instead of the reservoir outflow on the steps it covers
       for (size_t i = 0; i < lakes->size(); ++i) {
-        LakeModelImpl* lake = new LakeModelImpl(lakes->at(i), false, basinEngineeredDischarge);
+        std::map<std::string, std::map<time_t, double> >::iterator dischargeItr =
+            basinEngineeredDischarge->find(lakes->at(i).name);
+        LakeModelImpl* lake;
+        if (dischargeItr != basinEngineeredDischarge->end()) {
+          lake = new LakeModelImpl(lakes->at(i), true, &(dischargeItr->second));
+        } else {
+          lake = new LakeModelImpl(lakes->at(i), false, NULL);
+        }
+        lake->AlignToSteps(stepTimes);
         lakeModels.push_back(lake);
       }
     }
@@ -371,6 +394,7 @@ bool Simulator::InitializeBasic(TaskConfigSection *task) {
     // Initialize LakeMap for additional lakes
     if (lakeModels.size() > 0) {
       lakeMap.Initialize(&lakeModels);
+      lakeMap.SetNodeIndex(&nodeIndex);
       lakeMap.FindLakeLocations();
       
       // If using states, try to load lake relationships first and skip building them
@@ -392,7 +416,7 @@ bool Simulator::InitializeBasic(TaskConfigSection *task) {
       
       // Initialize inlets if any are configured
       if (inlets.size() > 0) {
-        lakeMap.InitializeInlets(&inlets);
+        lakeMap.InitializeInlets(&inlets, stepTimes);
       }
     }
   }
@@ -541,6 +565,9 @@ bool Simulator::InitializeCali(TaskConfigSection *task) {
   snowCaliParamSec = task->GetSnowCaliParamSec();
   objectiveFunc = caliParamSec->GetObjFunc();
   caliGauge = caliParamSec->GetGauge();
+  if (caliGaugeOverride) {
+    caliGauge = caliGaugeOverride;
+  }
   numWBParams = numModelParams[task->GetModel()];
   if (task->GetRouting() != ROUTE_QTY) {
     numRParams = numRouteParams[task->GetRouting()];
@@ -564,41 +591,64 @@ bool Simulator::InitializeCali(TaskConfigSection *task) {
     return false;
   }
 
-  INFO_LOGF("Calibrating on gauge %s", caliGauge->GetName());
-
-  // See if we have the approriate parameters set to do this
-  if (paramSettings->find(caliGauge) == paramSettings->end()) {
-    ERROR_LOGF("In order to calibrate on gauge \"%s\" it must be given "
-               "parameter settings. They can not be inferred from a downstream "
-               "gauge!",
-               caliGauge->GetName());
-    return false;
+  if (caliGaugeOverride) {
+    caliGauges.assign(1, caliGaugeOverride);
+    caliWeights.assign(1, 1.0);
+  } else {
+    caliGauges = *(caliParamSec->GetCaliGauges());
+    caliWeights = *(caliParamSec->GetCaliWeights());
   }
-  caliWBParams = fullParamSettings[caliGauge];
+  caliBlockSize = numWBParams + numRParams + numSParams;
+  caliWBParamsList.resize(caliGauges.size());
+  caliRParamsList.resize(caliGauges.size(), NULL);
+  caliSParamsList.resize(caliGauges.size(), NULL);
 
-  if (task->GetRouting() != ROUTE_QTY) {
-    // See if we have the approriate routing parameters set to do this
-    if (paramSettingsRoute->find(caliGauge) == paramSettingsRoute->end()) {
+  for (size_t k = 0; k < caliGauges.size(); k++) {
+    GaugeConfigSection *thisGauge = caliGauges[k];
+    INFO_LOGF("Calibrating on gauge %s (weight %f)", thisGauge->GetName(),
+              caliWeights[k]);
+
+    // See if we have the approriate parameters set to do this
+    if (paramSettings->find(thisGauge) == paramSettings->end()) {
       ERROR_LOGF("In order to calibrate on gauge \"%s\" it must be given "
-                 "routing parameter settings. They can not be inferred from a "
+                 "parameter settings. They can not be inferred from a "
                  "downstream gauge!",
-                 caliGauge->GetName());
+                 thisGauge->GetName());
       return false;
     }
-    caliRParams = fullParamSettingsRoute[caliGauge];
-  }
+    caliWBParamsList[k] = fullParamSettings[thisGauge];
 
-  if (task->GetSnow() != SNOW_QTY) {
-    // See if we have the approriate routing parameters set to do this
-    if (paramSettingsSnow->find(caliGauge) == paramSettingsSnow->end()) {
-      ERROR_LOGF("In order to calibrate on gauge \"%s\" it must be given snow "
-                 "parameter settings. They can not be inferred from a "
-                 "downstream gauge!",
-                 caliGauge->GetName());
-      return false;
+    if (task->GetRouting() != ROUTE_QTY) {
+      // See if we have the approriate routing parameters set to do this
+      if (paramSettingsRoute->find(thisGauge) == paramSettingsRoute->end()) {
+        ERROR_LOGF("In order to calibrate on gauge \"%s\" it must be given "
+                   "routing parameter settings. They can not be inferred from "
+                   "a downstream gauge!",
+                   thisGauge->GetName());
+        return false;
+      }
+      caliRParamsList[k] = fullParamSettingsRoute[thisGauge];
+    }
+
+    if (task->GetSnow() != SNOW_QTY) {
+      // See if we have the approriate routing parameters set to do this
+      if (paramSettingsSnow->find(thisGauge) == paramSettingsSnow->end()) {
+        ERROR_LOGF("In order to calibrate on gauge \"%s\" it must be given "
+                   "snow parameter settings. They can not be inferred from a "
+                   "downstream gauge!",
+                   thisGauge->GetName());
+        return false;
+      }
+      caliSParamsList[k] = fullParamSettingsSnow[thisGauge];
+    }
+
+    if (thisGauge != caliGauge) {
+      thisGauge->LoadTS();
     }
-    caliSParams = fullParamSettingsSnow[caliGauge];
   }
+  caliWBParams = caliWBParamsList[0];
+  caliRParams = caliRParamsList[0];
+  caliSParams = caliSParamsList[0];
 
   // Lake parameters are now handled through CSV file, not parameter sets
   caliLParams = NULL;
@@ -639,6 +689,10 @@ bool Simulator::InitializeCali(TaskConfigSection *task) {
   // Initialize storage for discharge vectors
   obsQ.resize(totalTimeStepsOutsideWarm);
   simQ.resize(totalTimeStepsOutsideWarm);
+  obsQGauges.resize(caliGauges.size());
+  for (size_t k = 0; k < caliGauges.size(); k++) {
+    obsQGauges[k].resize(totalTimeStepsOutsideWarm);
+  }
 
   // Get caliGaugeIndex
   for (size_t i = 0; i < gauges->size(); i++) {
@@ -700,6 +754,10 @@ bool Simulator::InitializeCali(TaskConfigSection *task) {
       ERROR_LOG("Unsupported Routing Model!!");
       return false;
     }
+    caliWBModels[i]->SetIdleThreshold(task->GetWBIdleThreshold());
+    if (caliRModels[i]) {
+      caliRModels[i]->SetIdleThreshold(task->GetRouteIdleThreshold());
+    }
 
     // Create the appropriate snow model
     switch (task->GetSnow()) {
@@ -721,41 +779,50 @@ bool Simulator::InitializeCali(TaskConfigSection *task) {
       caliLModels[i] = NULL;
     }
 
-    caliWBCurrentParams[i] = new float[numWBParams];
+    // One parameter block per calibration gauge. Every gauge sharing a
+    // calibration gauge's parameter set gets pointed at that gauge's block.
+    size_t numCali = caliGauges.size();
+    caliWBCurrentParams[i] = new float[numWBParams * numCali];
 
     for (std::map<GaugeConfigSection *, float *>::iterator itr =
              fullParamSettings.begin();
          itr != fullParamSettings.end(); itr++) {
-      if (itr->second == caliWBParams) {
-        (caliWBFullParamSettings[i])[itr->first] = caliWBCurrentParams[i];
-      } else {
-        (caliWBFullParamSettings[i])[itr->first] = itr->second;
+      (caliWBFullParamSettings[i])[itr->first] = itr->second;
+      for (size_t k = 0; k < numCali; k++) {
+        if (itr->second == caliWBParamsList[k]) {
+          (caliWBFullParamSettings[i])[itr->first] =
+              caliWBCurrentParams[i] + k * numWBParams;
+        }
       }
     }
 
     if (task->GetRouting() != ROUTE_QTY) {
-      caliRCurrentParams[i] = new float[numRParams];
+      caliRCurrentParams[i] = new float[numRParams * numCali];
       for (std::map<GaugeConfigSection *, float *>::iterator itr =
                fullParamSettingsRoute.begin();
            itr != fullParamSettingsRoute.end(); itr++) {
-        if (itr->second == caliRParams) {
-          (caliRFullParamSettings[i])[itr->first] = caliRCurrentParams[i];
-        } else {
-          (caliRFullParamSettings[i])[itr->first] = itr->second;
+        (caliRFullParamSettings[i])[itr->first] = itr->second;
+        for (size_t k = 0; k < numCali; k++) {
+          if (itr->second == caliRParamsList[k]) {
+            (caliRFullParamSettings[i])[itr->first] =
+                caliRCurrentParams[i] + k * numRParams;
+          }
         }
       }
     }
 
     if (task->GetSnow() != SNOW_QTY) {
-      caliSCurrentParams[i] = new float[numSParams];
+      caliSCurrentParams[i] = new float[numSParams * numCali];
 
       for (std::map<GaugeConfigSection *, float *>::iterator itr =
                fullParamSettingsSnow.begin();
            itr != fullParamSettingsSnow.end(); itr++) {
-        if (itr->second == caliSParams) {
-          (caliSFullParamSettings[i])[itr->first] = caliSCurrentParams[i];
-        } else {
-          (caliSFullParamSettings[i])[itr->first] = itr->second;
+        (caliSFullParamSettings[i])[itr->first] = itr->second;
+        for (size_t k = 0; k < numCali; k++) {
+          if (itr->second == caliSParamsList[k]) {
+            (caliSFullParamSettings[i])[itr->first] =
+                caliSCurrentParams[i] + k * numSParams;
+          }
         }
       }
     }
@@ -945,6 +1012,24 @@ float Simulator::GetNumSimulatedYears() {
   return numYears;
 }
 
+// The times SimulateDistributed visits, in tsIndex order, including the
+// switch to the long range time step. Per-step series (engineered discharge,
+// inlet flows) are lined up with these once instead of searched every step.
+void Simulator::BuildStepTimes() {
+  stepTimes.clear();
+  TimeUnit *step = timeStepSR;
+  bool stepLR = false;
+  TimeVar tempTime = beginTime;
+  for (tempTime.Increment(step); tempTime <= endTime;
+       tempTime.Increment(step)) {
+    stepTimes.push_back(tempTime.currentTimeSec);
+    if (timeStepLR && !stepLR && beginLRTime <= tempTime) {
+      stepLR = true;
+      step = timeStepLR;
+    }
+  }
+}
+
 int Simulator::LoadForcings(PrecipReader *precipReader, PETReader *petReader,
                             TempReader *tempReader) {
   char buffer[CONFIG_MAX_LEN * 2], qpfBuffer[CONFIG_MAX_LEN * 2];
@@ -1096,6 +1181,7 @@ void Simulator::SaveLP3Params() {
 }
 
 void Simulator::SaveTSOutput() {
+  bool lakeOutputTS = task->IsLakeModuleEnabled() && HasLakesWithOutputTS();
   for (size_t i = 0; i < gauges->size(); i++) {
     GaugeConfigSection *gauge = gauges->at(i);
     if (gaugeOutputs[i]) {
@@ -1118,7 +1204,7 @@ void Simulator::SaveTSOutput() {
                 GetReturnPeriod(currentQ[gauge->GetGridNodeIndex()],
                                 &(rpData[gauge->GetGridNodeIndex()])));
       }
-      if (task->IsLakeModuleEnabled() && HasLakesWithOutputTS()) {
+      if (lakeOutputTS) {
         fprintf(gaugeOutputs[i], ",%.2f", currentLakeVolume[gauge->GetGridNodeIndex()]);
       }
       fprintf(gaugeOutputs[i], "%s", "\n");
@@ -1322,6 +1408,23 @@ float Simulator::CalcProb(float discharge, float mean, float sd) {
   return 0.5f * (1.0 + erf((discharge - mean) / (logf(sd) * sqrtf(2))));
 }
 
+// Compares the forcing grids read with the ones actually allocated
+static void LogGridPool(const char *name, GridPool *pool) {
+  if (pool->GetNumAcquired() > 0) {
+    INFO_LOGF("%s grids: %li read, %li allocated", name,
+              pool->GetNumAcquired(), pool->GetNumAllocated());
+  }
+}
+
+// JSON has no NaN or infinity, so undefined scores are written as null
+static void WriteJSONScore(FILE *fp, const char *name, float value) {
+  if (std::isfinite(value)) {
+    fprintf(fp, ", \"%s\": %f", name, value);
+  } else {
+    fprintf(fp, ", \"%s\": null", name);
+  }
+}
+
 void Simulator::SimulateDistributed(bool trackPeaks) {
   PrecipReader precipReader;
   PETReader petReader;
@@ -1331,6 +1434,8 @@ void Simulator::SimulateDistributed(bool trackPeaks) {
   char buffer[CONFIG_MAX_LEN * 2];
   size_t tsIndex = 0;
   bool outputTS = IsOutputTS();
+  // Skill of every gauge with observations, reported in results.json
+  std::vector<ObjectiveAccumulator> gaugeSkills(gauges->size());
   // NORMAL_LOGF("%s\n", "Got here!3");
   // Peak tracking variables
   numYears = 0;
@@ -1403,9 +1508,11 @@ void Simulator::SimulateDistributed(bool trackPeaks) {
   // printf("Got here before initializing water balance models...");
   // Initialize our models
   // NORMAL_LOGF("%s\n", "Got here!4");
+  wbModel->SetIdleThreshold(task->GetWBIdleThreshold());
   wbModel->InitializeModel(&nodes, &fullParamSettings, &paramGrids);
   //	NORMAL_LOGF("%s\n", "Got here!5");
   if (rModel) {
+    rModel->SetIdleThreshold(task->GetRouteIdleThreshold());
     rModel->InitializeModel(&nodes, &fullParamSettingsRoute, &paramGridsRoute);
   }
   //	NORMAL_LOGF("%s\n", "Got here!6");
@@ -1414,6 +1521,8 @@ void Simulator::SimulateDistributed(bool trackPeaks) {
     sModel->InitializeModel(&nodes, &fullParamSettingsSnow, &paramGridsSnow);
   }
   if (iModel) {
+    iModel->SetNodeIndex(&nodeIndex);
+    iModel->SetDischargeTolerance(task->GetInundationTolerance());
     iModel->InitializeModel(&nodes, &fullParamSettingsInundation,
                             &paramGridsInundation);
   }
@@ -1422,6 +1531,7 @@ void Simulator::SimulateDistributed(bool trackPeaks) {
   }
   
   // Initialize additional lake models (when using non-lake water balance model)
+  std::vector<LakeModelImpl *> tableLakes;
   if (task->IsLakeModuleEnabled() && task->GetModel() != MODEL_LAKE) {
     for (size_t l = 0; l < lakeModels.size(); ++l) {
       LakeModelImpl* lake = lakeModels[l];
@@ -1429,7 +1539,9 @@ void Simulator::SimulateDistributed(bool trackPeaks) {
         lake->InitializeModel(&nodes, NULL, NULL);
       }
     }
+    tableLakes = lakeModels;
   }
+  reservoirs.Initialize(&tableLakes);
 
   // Couple lakes into the kinematic-wave router so their regulated outflow
   // actually propagates downstream. Without this the lake only overwrites its
@@ -1442,17 +1554,12 @@ void Simulator::SimulateDistributed(bool trackPeaks) {
   if (task->IsLakeModuleEnabled() && task->GetModel() != MODEL_LAKE) {
     KWRoute* kwr = dynamic_cast<KWRoute*>(rModel);
     if (kwr) {
-      for (size_t l = 0; l < lakeModels.size(); ++l) {
-        LakeModelImpl* lake = lakeModels[l];
-        if (lake && lake->lakeNodeIndex >= 0) {
-          kwr->RegisterLake(lake->lakeNodeIndex, lake);
-          lakesInRouter = true;
-        }
-      }
-      if (lakesInRouter) {
+      int numCoupled = kwr->RegisterLakes(&reservoirs);
+      if (numCoupled > 0) {
+        lakesInRouter = true;
         lakeRouter = kwr;
         INFO_LOGF("Coupled %d lake(s) into kinematic-wave routing",
-                  (int)lakeModels.size());
+                  numCoupled);
       }
     }
   }
@@ -1480,6 +1587,7 @@ void Simulator::SimulateDistributed(bool trackPeaks) {
           lake->InitializeStates(&currentTime, statePath);
         }
       }
+      reservoirs.LoadStates();
     }
   } else {
     for (size_t i = 0; i < currentFF.size(); i++) {
@@ -1530,6 +1638,10 @@ void Simulator::SimulateDistributed(bool trackPeaks) {
   double simStartTime = omp_get_wtime();
 #endif
 
+  // Lake bookkeeping resolved once instead of every step
+  LakeModelImpl* mainLakeModel = dynamic_cast<LakeModelImpl*>(wbModel);
+  bool lakeOutputTS = task->IsLakeModuleEnabled() && HasLakesWithOutputTS();
+
   // This is the temporal loop for each time step
   // Here we load the input forcings & actually run the model
   for (currentTime.Increment(timeStep); currentTime <= endTime;
@@ -1572,17 +1684,11 @@ void Simulator::SimulateDistributed(bool trackPeaks) {
     
     // Part 1: Vertical balance (P-E) for lakes before water balance
     if (task->IsLakeModuleEnabled()) {
-      // Handle additional lakes (when using non-lake water balance model)
-      for (size_t l = 0; l < lakeModels.size(); ++l) {
-        LakeModelImpl* lake = lakeModels[l];
-        if (!lake) continue;
-        
-        // Apply vertical balance with current precipitation and PET
-        lake->ApplyVerticalBalance(timeStepHours, currentPrecip, &currentPETSimu);
-      }
+      // Handle additional lakes (when using non-lake water balance model),
+      // with current precipitation and PET
+      reservoirs.VerticalBalance(currentPrecip, &currentPETSimu);
       
       // Handle main lake model (when using MODEL_LAKE)
-      LakeModelImpl* mainLakeModel = dynamic_cast<LakeModelImpl*>(wbModel);
       if (mainLakeModel) {
         mainLakeModel->ApplyVerticalBalance(timeStepHours, currentPrecip, &currentPETSimu);
       }
@@ -1597,6 +1703,10 @@ void Simulator::SimulateDistributed(bool trackPeaks) {
                             &(currentPETCali[tsIndex]), &currentFF, &currentSF, &currentBF,
                             &SM, &GW);
     }
+    if (wbModel->GetNumIdle() > 0) {
+      NORMAL_LOGF(" %lu/%lu water balance cells idle", wbModel->GetNumIdle(),
+                  (unsigned long)nodes.size());
+    }
     if (griddedOutputs && ((griddedOutputs & OG_RUNOFF)==OG_RUNOFF)) {
       // 2021-04 Allen: output gridded surface runoff ---------------------------------
       std::vector<float> _runoff;
@@ -1623,9 +1733,9 @@ void Simulator::SimulateDistributed(bool trackPeaks) {
       }    
 
     if (outputTS) {
-      gaugeMap.GaugeAverage(&nodes, &currentFF, &avgFF);
-      gaugeMap.GaugeAverage(&nodes, &currentSF, &avgSF);
-      gaugeMap.GaugeAverage(&nodes, &currentBF, &avgBF);
+      std::vector<float> *values[] = {&currentFF, &currentSF, &currentBF};
+      std::vector<float> *avgs[] = {&avgFF, &avgSF, &avgBF};
+      gaugeMap.GaugeAverages(&nodes, 3, values, avgs);
     }
 
 
@@ -1640,10 +1750,10 @@ void Simulator::SimulateDistributed(bool trackPeaks) {
       double beginTimeR = omp_get_wtime();
 #endif
 #endif
-      // Give the router the current time so the in-sweep lake/reservoir step
-      // can resolve engineered (dam) discharge by timestamp.
+      // Give the router the current step so the in-sweep lake/reservoir step
+      // can look up engineered (dam) discharge.
       if (lakeRouter) {
-        lakeRouter->SetCurrentTime(&currentTime);
+        lakeRouter->SetCurrentStep((long)tsIndex);
       }
       rModel->Route(stepHoursReal, &currentFF, &currentSF, &currentBF, &currentQ);
       // printf("After routing...\n");
@@ -1653,36 +1763,9 @@ void Simulator::SimulateDistributed(bool trackPeaks) {
       NORMAL_LOGF(" %f routing sec", endTimeR - beginTimeR);
 #endif
 #endif
-      
-      // Lake volume and outflow logging removed
-      if (task->IsLakeModuleEnabled() && HasLakesWithOutputTS()) {
-        // Main lake model processing (no logging)
-        LakeModelImpl* mainLakeModel = dynamic_cast<LakeModelImpl*>(wbModel);
-        if (mainLakeModel) {
-          // Volume and outflow processing without logging
-        }
-        
-        // Additional lake models processing (no logging)
-        for (size_t lakeIdx = 0; lakeIdx < lakeModels.size(); ++lakeIdx) {
-          LakeModelImpl* lake = lakeModels[lakeIdx];
-          if (!lake) continue;
-          
-          // Check if this lake has outputts=true
-          bool hasOutputTS = false;
-          if (task->GetBasinSec()->GetLakes()) {
-            std::vector<LakeInfo> *lakes = task->GetBasinSec()->GetLakes();
-            for (size_t i = 0; i < lakes->size(); i++) {
-              if (lakes->at(i).name == lake->GetLakeName() && lakes->at(i).outputts) {
-                hasOutputTS = true;
-                break;
-              }
-            }
-          }
-          
-          if (hasOutputTS) {
-            // Volume and outflow processing without logging
-          }
-        }
+      if (rModel->GetNumIdle() > 0) {
+        NORMAL_LOGF(" %lu/%lu routing cells idle", rModel->GetNumIdle(),
+                    (unsigned long)nodes.size());
       }
     } else {
       for (size_t i = 0; i < currentFF.size(); i++) {
@@ -1699,19 +1782,25 @@ void Simulator::SimulateDistributed(bool trackPeaks) {
       // there the reservoir step already ran in-sweep (and propagated outflow
       // downstream); running it again here would step storage a second time.
       if (!lakesInRouter) {
-        for (size_t l = 0; l < lakeModels.size(); ++l) {
-          LakeModelImpl* lake = lakeModels[l];
-          if (!lake) continue;
-
-          // Apply horizontal balance and update Q vector
-          lake->ApplyHorizontalBalance(timeStepHours, &currentQ, &nodes, &currentTime, &lakeMap);
-        }
+        // Apply horizontal balance and update Q vector
+        reservoirs.HorizontalBalance(timeStepHours, &currentQ, (long)tsIndex, &lakeMap);
       }
       
       // Handle main lake model (when using MODEL_LAKE)
-      LakeModelImpl* mainLakeModel = dynamic_cast<LakeModelImpl*>(wbModel);
       if (mainLakeModel) {
-        mainLakeModel->ApplyHorizontalBalance(timeStepHours, &currentQ, &nodes, &currentTime, &lakeMap);
+        mainLakeModel->ApplyHorizontalBalance(timeStepHours, &currentQ, &nodes, (long)tsIndex, &lakeMap);
+      }
+
+      // Lake volume for the gauge output, at the outputts lakes' nodes
+      if (lakeOutputTS) {
+        reservoirs.GetOutputVolumes(&currentLakeVolume);
+        if (mainLakeModel) {
+          GridLoc* lakeLoc = mainLakeModel->GetLocation();
+          long lakeNode = lakeLoc ? nodeIndex.Find(lakeLoc->x, lakeLoc->y) : -1;
+          if (lakeNode >= 0) {
+            currentLakeVolume[lakeNode] = (float)mainLakeModel->GetStorage();
+          }
+        }
       }
     }
     if (saveStates && stateTime == currentTime) {
@@ -1737,6 +1826,7 @@ void Simulator::SimulateDistributed(bool trackPeaks) {
       
       // Save states for additional lake models
       if (task->IsLakeModuleEnabled()) {
+        reservoirs.StoreStates();
         for (size_t l = 0; l < lakeModels.size(); ++l) {
           LakeModelImpl* lake = lakeModels[l];
           if (lake) {
@@ -1762,31 +1852,48 @@ void Simulator::SimulateDistributed(bool trackPeaks) {
 
       OutputCombinedOutput();
 
+      for (size_t i = 0; i < gauges->size(); i++) {
+        GaugeConfigSection *gauge = gauges->at(i);
+        gaugeSkills[i].Add(gauge->GetObserved(&currentTime),
+                           currentQ[gauge->GetGridNodeIndex()]);
+      }
+
       if (trackPeaks && currentYear != currentTime.GetTM()->tm_year) {
         currentYear = currentTime.GetTM()->tm_year;
         indexYear++;
       }
 
       if (outputTS) {
-        gaugeMap.GaugeAverage(&nodes, &SM, &avgSM);
-        gaugeMap.GaugeAverage(&nodes, &GW, &avgGW);
+        // Every basin average of this step in one pass over the nodes
+        std::vector<float> *values[6], *avgs[6];
+        size_t numAvgs = 0;
+        values[numAvgs] = &SM;
+        avgs[numAvgs++] = &avgSM;
+        values[numAvgs] = &GW;
+        avgs[numAvgs++] = &avgGW;
         if (!preloadedForcings) {
-          gaugeMap.GaugeAverage(&nodes, currentPrecip, &avgPrecip);
-          gaugeMap.GaugeAverage(&nodes, &currentPETSimu, &avgPET);
+          values[numAvgs] = currentPrecip;
+          avgs[numAvgs++] = &avgPrecip;
+          values[numAvgs] = &currentPETSimu;
+          avgs[numAvgs++] = &avgPET;
         } else {
-          gaugeMap.GaugeAverage(&nodes, &(currentPrecipCali[tsIndex]),
-                                &avgPrecip);
-          gaugeMap.GaugeAverage(&nodes, &(currentPETCali[tsIndex]), &avgPET);
+          values[numAvgs] = &(currentPrecipCali[tsIndex]);
+          avgs[numAvgs++] = &avgPrecip;
+          values[numAvgs] = &(currentPETCali[tsIndex]);
+          avgs[numAvgs++] = &avgPET;
         }
 
         if (sModel) {
-          gaugeMap.GaugeAverage(&nodes, &currentSWE, &avgSWE);
+          values[numAvgs] = &currentSWE;
+          avgs[numAvgs++] = &avgSWE;
           if (!preloadedForcings) {
-            gaugeMap.GaugeAverage(&nodes, &currentTempSimu, &avgT);
+            values[numAvgs] = &currentTempSimu;
           } else {
-            gaugeMap.GaugeAverage(&nodes, &(currentTempCali[tsIndex]), &avgT);
+            values[numAvgs] = &(currentTempCali[tsIndex]);
           }
+          avgs[numAvgs++] = &avgT;
         }
+        gaugeMap.GaugeAverages(&nodes, numAvgs, values, avgs);
 
         // Write the output to file
         SaveTSOutput();
@@ -2049,68 +2156,34 @@ void Simulator::SimulateDistributed(bool trackPeaks) {
 #if _OPENMP
   fprintf(fp, ",\n\"runTimeSeconds\": %f", timeDiff);
 #endif
+  fprintf(fp, ",\n\"skill\": {");
+  bool firstSkill = true;
+  for (size_t i = 0; i < gauges->size(); i++) {
+    ObjectiveAccumulator *skill = &(gaugeSkills[i]);
+    if (skill->GetCount() < 2) {
+      continue;
+    }
+    fprintf(fp, "%s\n\"%s\": {\"count\": %ld", firstSkill ? "" : ",",
+            gauges->at(i)->GetName(), skill->GetCount());
+    for (int obj = 0; obj < OBJECTIVE_QTY; obj++) {
+      WriteJSONScore(fp, objectiveStrings[obj],
+                     skill->GetScore((OBJECTIVES)obj));
+    }
+    WriteJSONScore(fp, "bias", skill->GetBias());
+    fprintf(fp, "%s", "}");
+    INFO_LOGF("Gauge %s: NSCE %.3f, KGE %.3f, CC %.3f, bias %.1f%%",
+              gauges->at(i)->GetName(), skill->GetScore(OBJECTIVE_NSCE),
+              skill->GetScore(OBJECTIVE_KGE), skill->GetScore(OBJECTIVE_CC),
+              skill->GetBias());
+    firstSkill = false;
+  }
+  fprintf(fp, "%s", "}");
   fprintf(fp, "\n%s", "}");
   fclose(fp);
 
-  // Populate lake volume data for output if lake module is enabled
-  if (task->IsLakeModuleEnabled() && HasLakesWithOutputTS()) {
-    // Initialize all nodes with 0
-    for (size_t i = 0; i < nodes.size(); i++) {
-      currentLakeVolume[i] = 0.0f;
-    }
-    
-    // Handle main lake model (when using MODEL_LAKE)
-    LakeModelImpl* mainLakeModel = dynamic_cast<LakeModelImpl*>(wbModel);
-    if (mainLakeModel) {
-      // For main lake model, populate at its grid location
-      GridLoc* lakeLoc = mainLakeModel->GetLocation();
-      if (lakeLoc && lakeLoc->x >= 0 && lakeLoc->y >= 0) {
-        // Find the node that matches the lake location
-        for (size_t i = 0; i < nodes.size(); i++) {
-          if (nodes[i].x == lakeLoc->x && nodes[i].y == lakeLoc->y) {
-            currentLakeVolume[i] = (float)mainLakeModel->GetStorage();
-            // Lake volume processing without logging
-            break;
-          }
-        }
-      }
-    }
-    
-    // Handle additional lakes (when using non-lake water balance model)
-    for (size_t l = 0; l < lakeModels.size(); ++l) {
-      LakeModelImpl* lake = lakeModels[l];
-      if (!lake) continue;
-      
-      // Check if this lake has outputts=true
-      bool hasOutputTS = false;
-      if (task->GetBasinSec()->GetLakes()) {
-        std::vector<LakeInfo> *lakes = task->GetBasinSec()->GetLakes();
-        for (size_t i = 0; i < lakes->size(); i++) {
-          if (lakes->at(i).name == lake->GetLakeName() && lakes->at(i).outputts) {
-            hasOutputTS = true;
-            break;
-          }
-        }
-      }
-      
-      if (hasOutputTS) {
-        // Populate at this lake's grid location
-        GridLoc* lakeLoc = lake->GetLocation();
-        if (lakeLoc && lakeLoc->x >= 0 && lakeLoc->y >= 0) {
-          // Find the node that matches the lake location
-          for (size_t i = 0; i < nodes.size(); i++) {
-            if (nodes[i].x == lakeLoc->x && nodes[i].y == lakeLoc->y) {
-              currentLakeVolume[i] = (float)lake->GetStorage();
-              // Lake volume processing without logging
-              break;
-            }
-          }
-        }
-      }
-    }
-  }
-
-
+  LogGridPool("Precip", precipReader.GetGridPool());
+  LogGridPool("PET", petReader.GetGridPool());
+  LogGridPool("Temp", tempReader.GetGridPool());
 }
 
 
@@ -2163,8 +2236,9 @@ void Simulator::SimulateLumped() {
     }
 
     if (!preloadedForcings) {
-      gaugeMap.GaugeAverage(&nodes, &currentPrecipSimu, &avgPrecip);
-      gaugeMap.GaugeAverage(&nodes, &currentPETSimu, &avgPET);
+      std::vector<float> *values[] = {&currentPrecipSimu, &currentPETSimu};
+      std::vector<float> *avgs[] = {&avgPrecip, &avgPET};
+      gaugeMap.GaugeAverages(&nodes, 2, values, avgs);
 
       wbModel->WaterBalance(timeStepHours, &avgPrecip, &avgPET, &currentFF, &currentBF,
                             &currentSF, &SM, &GW);
@@ -2346,12 +2420,19 @@ void Simulator::PreloadForcings(char *file, bool cali) {
 
     if (cali && warmEndTime <= currentTime) {
       obsQ[tsIndexWarm] = caliGauge->GetObserved(&currentTime);
+      for (size_t k = 0; k < caliGauges.size(); k++) {
+        obsQGauges[k][tsIndexWarm] = caliGauges[k]->GetObserved(&currentTime);
+      }
       tsIndexWarm++;
     }
 
     tsIndex++;
   }
 
+  LogGridPool("Precip", precipReader.GetGridPool());
+  LogGridPool("PET", petReader.GetGridPool());
+  LogGridPool("Temp", tempReader.GetGridPool());
+
   SaveForcings(file);
 }
 
@@ -2423,6 +2504,9 @@ bool Simulator::LoadSavedForcings(char *file, bool cali) {
        currentTime.Increment(timeStep)) {
     if (warmEndTime <= currentTime) {
       obsQ[tsIndexWarm] = caliGauge->GetObserved(&currentTime);
+      for (size_t k = 0; k < caliGauges.size(); k++) {
+        obsQGauges[k][tsIndexWarm] = caliGauges[k]->GetObserved(&currentTime);
+      }
       tsIndexWarm++;
     }
   }
@@ -2453,29 +2537,27 @@ void Simulator::SaveForcings(char *file) {
   gzclose(filep);
 }
 
-float Simulator::SimulateForCali(float *testParams) {
+float Simulator::SimulateForCali(float *testParams,
+                                 std::vector<float> *outflow) {
 
   WaterBalanceModel *runModel;
   RoutingModel *runRoutingModel;
   SnowModel *runSnowModel;
-  std::vector<float> currentFFCali, currentSFCali, currentBFCali, currentQCali, simQCali,
+  std::vector<float> currentFFCali, currentSFCali, currentBFCali, currentQCali,
       SMCali, GWCali, currentSWECali, currentPrecipSnow;
+  std::vector<ObjectiveAccumulator> skills(caliGauges.size());
   TimeVar currentTimeCali;
   std::map<GaugeConfigSection *, float *> *currentWBParamSettings;
   std::map<GaugeConfigSection *, float *> *currentRParamSettings;
   std::map<GaugeConfigSection *, float *> *currentSParamSettings;
-  float *currentWBParams, *currentRParams, *currentSParams;
 #if _OPENMP
   int thread = omp_get_thread_num();
   runModel = caliWBModels[thread];
   runRoutingModel = caliRModels[thread];
   runSnowModel = caliSModels[thread];
   currentWBParamSettings = &(caliWBFullParamSettings[thread]);
-  currentWBParams = caliWBCurrentParams[thread];
   currentRParamSettings = &(caliRFullParamSettings[thread]);
-  currentRParams = caliRCurrentParams[thread];
   currentSParamSettings = &(caliSFullParamSettings[thread]);
-  currentSParams = caliSCurrentParams[thread];
 #else
   runModel = wbModel;
   runRoutingModel = rModel;
@@ -2483,15 +2565,13 @@ float Simulator::SimulateForCali(float *testParams) {
   currentWBParamSettings = &fullParamSettings;
   currentRParamSettings = &fullParamSettingsRoute;
   currentSParamSettings = &fullParamSettingsSnow;
-  currentWBParams = caliWBParams;
-  currentRParams = caliRParams;
-  currentSParams = caliSParams;
 #endif
 
-  memcpy(currentWBParams, testParams, sizeof(float) * numWBParams);
-  memcpy(currentRParams, testParams + numWBParams, sizeof(float) * numRParams);
-  memcpy(currentSParams, testParams + numWBParams + numRParams,
-         sizeof(float) * numSParams);
+#if _OPENMP
+  CopyCaliParams(testParams, thread);
+#else
+  CopyCaliParams(testParams, -1);
+#endif
 
   // Initialize our model
   if (!runModel->IsLumped()) {
@@ -2517,7 +2597,6 @@ float Simulator::SimulateForCali(float *testParams) {
   currentPrecipSnow.resize(currentFF.size());
   SMCali.resize(currentFF.size());
   GWCali.resize(currentFF.size());
-  simQCali.resize(simQ.size());
   avgPrecip.resize(gauges->size());
   avgPET.resize(gauges->size());
 
@@ -2525,6 +2604,9 @@ float Simulator::SimulateForCali(float *testParams) {
   // Here we actually run the model
   size_t tsIndex = 0, tsIndexWarm = 0;
   currentTimeCali = beginTime;
+  if (outflow) {
+    outflow->clear();
+  }
 
   for (currentTimeCali.Increment(timeStep); currentTimeCali <= endTime;
        currentTimeCali.Increment(timeStep)) {
@@ -2547,17 +2629,26 @@ float Simulator::SimulateForCali(float *testParams) {
     runModel->WaterBalance(timeStepHours, precipVec, petVec, &currentFFCali, &currentSFCali,
                            &currentBFCali, &SMCali, &GWCali);
 
+    InjectCascadeInflows(runRoutingModel, &currentFFCali, &currentSFCali,
+                         &currentBFCali, tsIndex);
     runRoutingModel->Route(timeStepHours, &currentFFCali, &currentSFCali, &currentBFCali,
                            &currentQCali);
 
+    if (outflow) {
+      outflow->push_back(currentQCali[caliGauge->GetGridNodeIndex()]);
+    }
+
     if (warmEndTime <= currentTimeCali) {
-      simQCali[tsIndexWarm] = currentQCali[caliGauge->GetGridNodeIndex()];
+      for (size_t k = 0; k < caliGauges.size(); k++) {
+        skills[k].Add(obsQGauges[k][tsIndexWarm],
+                      currentQCali[caliGauges[k]->GetGridNodeIndex()]);
+      }
       tsIndexWarm++;
     }
 
     tsIndex++;
   }
-  float skill = CalcObjFunc(&obsQ, &simQCali, objectiveFunc);
+  float skill = CalcCaliObjective(&skills);
 #if _OPENMP
   // printf("%i: %f %f\n", thread, skill, rP[0]);
   /*if (skill < -2000.0) {
@@ -2572,6 +2663,188 @@ float Simulator::SimulateForCali(float *testParams) {
   // return CalcObjFunc(&obsQ, &simQCali, objectiveFunc);
 }
 
+// Candidates are laid out as one [water balance|routing|snow] block per
+// calibration gauge, in cali_gauges order.
+void Simulator::CopyCaliParams(float *testParams, int slot) {
+  for (size_t k = 0; k < caliGauges.size(); k++) {
+    float *block = testParams + k * caliBlockSize;
+    float *wbDest, *rDest, *sDest;
+    if (slot < 0) {
+      wbDest = caliWBParamsList[k];
+      rDest = caliRParamsList[k];
+      sDest = caliSParamsList[k];
+    } else {
+      wbDest = caliWBCurrentParams[slot] + k * numWBParams;
+      rDest = (numRParams) ? caliRCurrentParams[slot] + k * numRParams : NULL;
+      sDest = (numSParams) ? caliSCurrentParams[slot] + k * numSParams : NULL;
+    }
+    memcpy(wbDest, block, sizeof(float) * numWBParams);
+    if (rDest) {
+      memcpy(rDest, block + numWBParams, sizeof(float) * numRParams);
+    }
+    if (sDest) {
+      memcpy(sDest, block + numWBParams + numRParams,
+             sizeof(float) * numSParams);
+    }
+  }
+}
+
+float Simulator::CalcCaliObjective(std::vector<ObjectiveAccumulator> *skills) {
+  if (caliGauges.size() == 1) {
+    return skills->at(0).GetScore(objectiveFunc);
+  }
+
+  float total = 0.0, totalWeight = 0.0;
+  for (size_t k = 0; k < caliGauges.size(); k++) {
+    total += caliWeights[k] * skills->at(k).GetScore(objectiveFunc);
+    totalWeight += caliWeights[k];
+  }
+  return (totalWeight > 0.0) ? total / totalWeight : total;
+}
+
+// Boundary gauges of a cascade stage had their upstream area carved away, so
+// the recorded outflow of the upstream stage stands in for the gauge cell and
+// everything above it.
+void Simulator::AddCascadeInflow(GaugeConfigSection *gauge,
+                                 std::vector<float> *series) {
+  cascadeInflowNodes.push_back(gauge->GetGridNodeIndex());
+  cascadeInflows.push_back(series);
+}
+
+// The boundary cell's own runoff is already part of the recorded outflow, so
+// it is dropped here and the outflow enters the cell below the boundary.
+void Simulator::InjectCascadeInflows(RoutingModel *routeModel,
+                                     std::vector<float> *fastFlow,
+                                     std::vector<float> *interFlow,
+                                     std::vector<float> *baseFlow,
+                                     size_t tsIndex) {
+  for (size_t i = 0; i < cascadeInflowNodes.size(); i++) {
+    long node = cascadeInflowNodes[i];
+    fastFlow->at(node) = 0.0;
+    interFlow->at(node) = 0.0;
+    baseFlow->at(node) = 0.0;
+    routeModel->AddBoundaryInflow(node, cascadeInflows[i]->at(tsIndex));
+  }
+}
+
+// Evaluates count parameter sets in lockstep. Each member gets its own model
+// slot, but all members advance through the same timestep together so the
+// preloaded forcing vectors for that step are shared in cache instead of each
+// chain streaming the whole forcing record independently.
+void Simulator::SimulateForCaliBatch(float **testParams, int count,
+                                     float *scores) {
+  if (workerPool) {
+    workerPool->Evaluate(testParams, count, scores);
+    return;
+  }
+
+#if _OPENMP
+  int slots = (int)caliWBModels.size();
+
+  for (int block = 0; block < count; block += slots) {
+    int members = count - block;
+    if (members > slots) {
+      members = slots;
+    }
+
+    std::vector<std::vector<float> > memberFF(members), memberSF(members),
+        memberBF(members), memberQ(members), memberSM(members),
+        memberGW(members), memberSWE(members), memberPrecipSnow(members);
+    std::vector<std::vector<ObjectiveAccumulator> > memberSkills(
+        members, std::vector<ObjectiveAccumulator>(caliGauges.size()));
+
+    // Set up each member on its own model slot
+#pragma omp parallel for
+    for (int m = 0; m < members; m++) {
+      CopyCaliParams(testParams[block + m], m);
+
+      if (!caliWBModels[m]->IsLumped()) {
+        caliWBModels[m]->InitializeModel(&nodes, &(caliWBFullParamSettings[m]),
+                                         &paramGrids);
+      } else {
+        caliWBModels[m]->InitializeModel(
+            &lumpedNodes, &(caliWBFullParamSettings[m]), &paramGrids);
+      }
+      caliRModels[m]->InitializeModel(&nodes, &(caliRFullParamSettings[m]),
+                                      &paramGridsRoute);
+      if (caliSModels[m]) {
+        caliSModels[m]->InitializeModel(&nodes, &(caliSFullParamSettings[m]),
+                                        &paramGridsSnow);
+      }
+
+      memberFF[m].resize(currentFF.size());
+      memberSF[m].resize(currentFF.size());
+      memberBF[m].resize(currentFF.size());
+      memberQ[m].resize(currentFF.size());
+      memberSM[m].resize(currentFF.size());
+      memberGW[m].resize(currentFF.size());
+      memberSWE[m].resize(currentFF.size());
+      memberPrecipSnow[m].resize(currentFF.size());
+    }
+
+    // One parallel region for the whole record, members step together
+#pragma omp parallel
+    {
+      int numThreads = omp_get_num_threads();
+      int thread = omp_get_thread_num();
+      size_t tsIndex = 0, tsIndexWarm = 0;
+      TimeVar currentTimeCali = beginTime;
+
+      for (currentTimeCali.Increment(timeStep); currentTimeCali <= endTime;
+           currentTimeCali.Increment(timeStep)) {
+
+        bool outsideWarm = (warmEndTime <= currentTimeCali);
+        for (int m = thread; m < members; m += numThreads) {
+          std::vector<float> *precipVec = &(currentPrecipCali[tsIndex]);
+          std::vector<float> *petVec = &(currentPETCali[tsIndex]);
+
+          if (caliSModels[m]) {
+            caliSModels[m]->SnowBalance(
+                (float)currentTimeCali.GetTM()->tm_yday, timeStepHours,
+                precipVec, &(currentTempCali[tsIndex]), &(memberPrecipSnow[m]),
+                &(memberSWE[m]));
+            precipVec = &(memberPrecipSnow[m]);
+          }
+
+          caliWBModels[m]->WaterBalance(timeStepHours, precipVec, petVec,
+                                        &(memberFF[m]), &(memberSF[m]),
+                                        &(memberBF[m]), &(memberSM[m]),
+                                        &(memberGW[m]));
+          InjectCascadeInflows(caliRModels[m], &(memberFF[m]),
+                               &(memberSF[m]), &(memberBF[m]), tsIndex);
+          caliRModels[m]->Route(timeStepHours, &(memberFF[m]), &(memberSF[m]),
+                                &(memberBF[m]), &(memberQ[m]));
+
+          if (outsideWarm) {
+            for (size_t k = 0; k < caliGauges.size(); k++) {
+              memberSkills[m][k].Add(
+                  obsQGauges[k][tsIndexWarm],
+                  memberQ[m][caliGauges[k]->GetGridNodeIndex()]);
+            }
+          }
+        }
+
+        if (outsideWarm) {
+          tsIndexWarm++;
+        }
+        tsIndex++;
+
+        // Keep the members on the same timestep so they share the forcings
+#pragma omp barrier
+      }
+    }
+
+    for (int m = 0; m < members; m++) {
+      scores[block + m] = CalcCaliObjective(&(memberSkills[m]));
+    }
+  }
+#else
+  for (int i = 0; i < count; i++) {
+    scores[i] = SimulateForCali(testParams[i]);
+  }
+#endif
+}
+
 float *Simulator::SimulateForCaliTS(float *testParams) {
 
   WaterBalanceModel *runModel;
@@ -2580,11 +2853,11 @@ float *Simulator::SimulateForCaliTS(float *testParams) {
   TimeVar currentTimeCali;
   std::map<GaugeConfigSection *, float *> *currentParamSettings;
   float *currentParams;
-#if 0 // def _OPENMP
+#if _OPENMP
   int thread = omp_get_thread_num();
-  runModel = caliModels[thread];
-  currentParamSettings = &(caliFullParamSettings[thread]);
-  currentParams = caliCurrentParams[thread];
+  runModel = caliWBModels[thread];
+  currentParamSettings = &(caliWBFullParamSettings[thread]);
+  currentParams = caliWBCurrentParams[thread];
 #else
   runModel = wbModel;
   currentParamSettings = &fullParamSettings;
@@ -2601,7 +2874,10 @@ float *Simulator::SimulateForCaliTS(float *testParams) {
   }
 
   currentFFCali.resize(currentFF.size());
+  currentSFCali.resize(currentFF.size());
+  currentBFCali.resize(currentFF.size());
   SMCali.resize(currentFF.size());
+  GWCali.resize(currentFF.size());
   simQCali = new float[simQ.size()];
 
   // This is the temporal loop for each time step
@@ -2643,22 +2919,23 @@ float *Simulator::GetObsTS() {
 }
 
 bool Simulator::InitializeGridParams(TaskConfigSection *task) {
+  // Every parameter grid is its own file, so they are all read concurrently
+  // and the failures reported afterwards in the usual order.
+  struct ParamGridLoad {
+    std::vector<FloatGrid *> *grids;
+    int index;
+    const char *file, *kind;
+  };
+  std::vector<ParamGridLoad> loads;
+
   int numParams = numModelParams[task->GetModel()];
   std::vector<std::string> *vecGrids = task->GetParamsSec()->GetParamGrids();
-
-  paramGrids.resize(numParams);
-
+  paramGrids.assign(numParams, NULL);
   for (int i = 0; i < numParams; i++) {
     std::string *file = &(vecGrids->at(i));
-    if (file->length() == 0) {
-      paramGrids[i] = NULL;
-    } else {
-      paramGrids[i] = ReadFloatTifGrid(file->c_str());
-      if (!paramGrids[i]) {
-        ERROR_LOGF("Failed to load water balance parameter grid %s\n",
-                   file->c_str());
-        return false;
-      }
+    if (file->length() != 0) {
+      ParamGridLoad load = {&paramGrids, i, file->c_str(), "water balance"};
+      loads.push_back(load);
     }
   }
 
@@ -2666,20 +2943,12 @@ bool Simulator::InitializeGridParams(TaskConfigSection *task) {
     int numRParams = numRouteParams[task->GetRouting()];
     std::vector<std::string> *vecRouteGrids =
         task->GetRoutingParamsSec()->GetParamGrids();
-
-    paramGridsRoute.resize(numRParams);
-
+    paramGridsRoute.assign(numRParams, NULL);
     for (int i = 0; i < numRParams; i++) {
       std::string *file = &(vecRouteGrids->at(i));
-      if (file->length() == 0) {
-        paramGridsRoute[i] = NULL;
-      } else {
-        paramGridsRoute[i] = ReadFloatTifGrid(file->c_str());
-        if (!paramGridsRoute[i]) {
-          ERROR_LOGF("Failed to load routing parameter grid %s\n",
-                     file->c_str());
-          return false;
-        }
+      if (file->length() != 0) {
+        ParamGridLoad load = {&paramGridsRoute, i, file->c_str(), "routing"};
+        loads.push_back(load);
       }
     }
   }
@@ -2688,19 +2957,12 @@ bool Simulator::InitializeGridParams(TaskConfigSection *task) {
     int numSParams = numSnowParams[task->GetSnow()];
     std::vector<std::string> *vecSnowGrids =
         task->GetSnowParamsSec()->GetParamGrids();
-
-    paramGridsSnow.resize(numSParams);
-
+    paramGridsSnow.assign(numSParams, NULL);
     for (int i = 0; i < numSParams; i++) {
       std::string *file = &(vecSnowGrids->at(i));
-      if (file->length() == 0) {
-        paramGridsSnow[i] = NULL;
-      } else {
-        paramGridsSnow[i] = ReadFloatTifGrid(file->c_str());
-        if (!paramGridsSnow[i]) {
-          ERROR_LOGF("Failed to load snow parameter grid %s\n", file->c_str());
-          return false;
-        }
+      if (file->length() != 0) {
+        ParamGridLoad load = {&paramGridsSnow, i, file->c_str(), "snow"};
+        loads.push_back(load);
       }
     }
   }
@@ -2709,25 +2971,40 @@ bool Simulator::InitializeGridParams(TaskConfigSection *task) {
     int numIParams = numInundationParams[task->GetInundation()];
     std::vector<std::string> *vecInundationGrids =
         task->GetInundationParamsSec()->GetParamGrids();
-
-    paramGridsInundation.resize(numIParams);
-
+    paramGridsInundation.assign(numIParams, NULL);
     for (int i = 0; i < numIParams; i++) {
       std::string *file = &(vecInundationGrids->at(i));
-      if (file->length() == 0) {
-        paramGridsInundation[i] = NULL;
-      } else {
-        paramGridsInundation[i] = ReadFloatTifGrid(file->c_str());
-        if (!paramGridsInundation[i]) {
-          ERROR_LOGF("Failed to load inundation parameter grid %s\n",
-                     file->c_str());
-          return false;
-        }
+      if (file->length() != 0) {
+        ParamGridLoad load = {&paramGridsInundation, i, file->c_str(),
+                              "inundation"};
+        loads.push_back(load);
       }
     }
   }
 
+  int numLoads = (int)loads.size();
+#pragma omp parallel for schedule(dynamic, 1)
+  for (int i = 0; i < numLoads; i++) {
+#if _OPENMP
+    double loadStart = omp_get_wtime();
+#endif
+    FloatGrid *grid = ReadFloatTifGrid(loads[i].file);
+    loads[i].grids->at(loads[i].index) = grid;
+#if _OPENMP
+    if (grid) {
+      INFO_LOGF("Loaded %s parameter grid %s in %.2fs", loads[i].kind,
+                loads[i].file, omp_get_wtime() - loadStart);
+    }
+#endif
+  }
 
+  for (int i = 0; i < numLoads; i++) {
+    if (!loads[i].grids->at(loads[i].index)) {
+      ERROR_LOGF("Failed to load %s parameter grid %s\n", loads[i].kind,
+                 loads[i].file);
+      return false;
+    }
+  }
 
   return true;
 }
@@ -2759,38 +3036,64 @@ namespace {
 
 const float OBS_NODATA = -9999.0f;
 
-// cost (to MINIMIZE) for one signal: sqrt((R^2 - 1)^2 + NRMSE^2). This is the
-// Euclidean distance from the ideal point (R^2=1, NRMSE=0); it is 0 at a perfect
-// fit and bounded in [0, sqrt(2)] -- numerically stable. Guards near-constant
-// series: constant obs -> correlation undefined, fall back to NRMSE alone
-// (magnitude only); constant sim with varying obs -> R^2=0 (no pattern match).
-static double SignalCost(const float *sim, const float *obs, int n) {
-  double mo = 0, ms = 0;
-  int m = 0;
+// Observation side of a signal's cost; fixed for a pixel, so it is computed
+// once rather than for every candidate.
+struct SignalObsStats {
+  int m;      // valid observations
+  double mo;  // their mean
+  double so;  // sum of squared deviations from mo
+};
+
+// Simulation side, accumulated in one pass over the valid observation steps.
+// Moments are kept about the running sim mean (Welford) so that large,
+// nearly constant runoff does not cancel away the variance.
+struct SignalSimSums {
+  int n;      // steps so far
+  double ms;  // running mean of sim
+  double m2;  // sum of squared deviations of sim from ms
+  double co;  // sum of (sim - ms) * (obs - st.mo)
+  double od;  // sum of (obs - st.mo) so far, tends to 0
+  double sse; // sum of (sim - obs)^2
+};
+
+static SignalObsStats SignalObs(const float *obs, int n) {
+  SignalObsStats st;
+  st.m = 0;
+  st.mo = 0.0;
+  st.so = 0.0;
   for (int t = 0; t < n; t++) {
     if (obs[t] > OBS_NODATA + 1.0f) {
-      mo += obs[t];
-      ms += sim[t];
-      m++;
+      st.mo += obs[t];
+      st.m++;
     }
   }
-  if (m < 5) {
-    return 0.0; // too few valid obs -> uninformative, neutral cost
+  if (st.m > 0) {
+    st.mo /= st.m;
   }
-  mo /= m;
-  ms /= m;
-  double so = 0, ss = 0, cov = 0, sse = 0;
   for (int t = 0; t < n; t++) {
     if (obs[t] > OBS_NODATA + 1.0f) {
-      double dobs = obs[t] - mo, dsim = sim[t] - ms;
-      so += dobs * dobs;
-      ss += dsim * dsim;
-      cov += dobs * dsim;
-      sse += (sim[t] - obs[t]) * (sim[t] - obs[t]);
+      st.so += (obs[t] - st.mo) * (obs[t] - st.mo);
     }
   }
+  return st;
+}
+
+// cost (to MINIMIZE) for one signal: sqrt((R^2 - 1)^2 + NRMSE^2). This is the
+// Euclidean distance from the ideal point (R^2=1, NRMSE=0); it is 0 at a perfect
+// fit and bounded in [0, sqrt(2)] -- numerically stable. Guards near-constant
+// series: constant obs -> correlation undefined, fall back to NRMSE alone
+// (magnitude only); constant sim with varying obs -> R^2=0 (no pattern match).
+static double SignalCost(const SignalObsStats &st, const SignalSimSums &sums) {
+  int m = st.m;
+  if (m < 5) {
+    return 0.0; // too few valid obs -> uninformative, neutral cost
+  }
+  double mo = st.mo;
+  double so = st.so;
+  double ss = sums.m2;
+  double cov = sums.co;
   double stdo = sqrt(so / m);
-  double rmse = sqrt(sse / m);
+  double rmse = sqrt(sums.sse / m);
   // Normalized RMSE: by std(obs); fall back to |mean| then to raw if both ~0.
   double denom = (stdo > 1e-9) ? stdo
                  : (fabs(mo) > 1e-9 ? fabs(mo) : 1.0);
@@ -2812,6 +3115,22 @@ static double SignalCost(const float *sim, const float *obs, int n) {
   return sqrt(dr * dr + nrmse * nrmse);
 }
 
+static inline void SignalAccumulate(SignalSimSums *sums,
+                                    const SignalObsStats &st, float sim,
+                                    float obs) {
+  double d = sim - obs;
+  double dObs = obs - st.mo;
+  double dSim = sim - sums->ms;
+  sums->n++;
+  sums->ms += dSim / sums->n;
+  double dSimNew = sim - sums->ms;
+  sums->m2 += dSim * dSimNew;
+  // Moving the mean shifts every earlier deviation, scaled by their obs sum
+  sums->co += dSimNew * dObs - (dSim / sums->n) * sums->od;
+  sums->od += dObs;
+  sums->sse += d * d;
+}
+
 // Tiny per-pixel RNG (xorshift64*) so each pixel is reproducible & thread-safe.
 struct PixelRng {
   unsigned long long s;
@@ -2825,32 +3144,61 @@ struct PixelRng {
   }
 };
 
+// Population size and generation count DEOptimize uses for a budget
+static void DESize(int d, int budget, int *NP, int *gens) {
+  *NP = d * 8;
+  if (*NP < 16) *NP = 16;
+  if (*NP > 40) *NP = 40;
+  *gens = budget / *NP;
+  if (*gens < 5) *gens = 5;
+}
+
 // DE/rand/1/bin (greedy) over d params in [lo,hi]; ~budget cost evaluations.
-// Returns best score; writes best params into best[]. cost: const float* -> double.
+// Returns best score; writes best params into best[]. Each generation's trials
+// are built from the previous generation and scored together, so cost is
+// handed the whole population: cost(candidates, count, fitnesses).
+// Optional seeds (e.g. converged neighbours) fill up to half the initial
+// population, copied once and then jittered by 5% of the range. A positive
+// spreadTol stops the search once every free parameter's population range is
+// below that fraction of its bounds. evals receives the evaluations spent.
 template <typename CostFn>
 static double DEOptimize(int d, const float *lo, const float *hi, CostFn cost,
-                         float *best, unsigned long long seed, int budget) {
+                         float *best, unsigned long long seed, int budget,
+                         const float *const *seeds = NULL, int numSeeds = 0,
+                         double spreadTol = 0.0, int *evals = NULL) {
   PixelRng rng(seed);
-  int NP = d * 8;
-  if (NP < 16) NP = 16;
-  if (NP > 40) NP = 40;
-  int gens = budget / NP;
-  if (gens < 5) gens = 5;
+  int NP, gens;
+  DESize(d, budget, &NP, &gens);
   std::vector<std::vector<float> > pop(NP, std::vector<float>(d));
-  std::vector<double> fit(NP);
+  std::vector<std::vector<float> > trials(NP, std::vector<float>(d));
+  std::vector<const float *> cands(NP);
+  std::vector<double> fit(NP), trialFit(NP);
+  int numSeeded = (numSeeds > 0) ? NP / 2 : 0;
   for (int i = 0; i < NP; i++) {
     for (int j = 0; j < d; j++) {
-      pop[i][j] = lo[j] + (float)rng.next() * (hi[j] - lo[j]);
+      if (i < numSeeded) {
+        float v = seeds[i % numSeeds][j];
+        if (i >= numSeeds) {
+          v += (float)(0.1 * (rng.next() - 0.5)) * (hi[j] - lo[j]);
+          if (v < lo[j]) v = lo[j];
+          if (v > hi[j]) v = hi[j];
+        }
+        pop[i][j] = v;
+      } else {
+        pop[i][j] = lo[j] + (float)rng.next() * (hi[j] - lo[j]);
+      }
     }
-    fit[i] = cost(pop[i].data());
+    cands[i] = pop[i].data();
   }
+  cost(cands.data(), NP, fit.data());
+  int spent = NP;
   int bi = 0;
   for (int i = 1; i < NP; i++)
     if (fit[i] > fit[bi]) bi = i;
-  std::vector<float> trial(d);
   const double F = 0.6, CR = 0.9;
   for (int g = 0; g < gens; g++) {
     for (int i = 0; i < NP; i++) {
+      std::vector<float> &trial = trials[i];
       int a, b, c;
       do { a = (int)(rng.next() * NP); } while (a == i);
       do { b = (int)(rng.next() * NP); } while (b == i || b == a);
@@ -2866,18 +3214,131 @@ static double DEOptimize(int d, const float *lo, const float *hi, CostFn cost,
           trial[j] = pop[i][j];
         }
       }
-      double ft = cost(trial.data());
-      if (ft >= fit[i]) {
-        pop[i] = trial;
-        fit[i] = ft;
-        if (ft > fit[bi]) bi = i;
+      cands[i] = trial.data();
+    }
+    cost(cands.data(), NP, trialFit.data());
+    spent += NP;
+    for (int i = 0; i < NP; i++) {
+      if (trialFit[i] >= fit[i]) {
+        pop[i].swap(trials[i]);
+        fit[i] = trialFit[i];
+        if (fit[i] > fit[bi]) bi = i;
+      }
+    }
+    if (spreadTol > 0.0) {
+      double spread = 0.0;
+      for (int j = 0; j < d && spread < spreadTol; j++) {
+        if (hi[j] <= lo[j]) continue;
+        float pmin = pop[0][j], pmax = pop[0][j];
+        for (int i = 1; i < NP; i++) {
+          if (pop[i][j] < pmin) pmin = pop[i][j];
+          if (pop[i][j] > pmax) pmax = pop[i][j];
+        }
+        double range = (pmax - pmin) / (hi[j] - lo[j]);
+        if (range > spread) spread = range;
+      }
+      if (spread < spreadTol) {
+        break;
       }
     }
   }
   for (int j = 0; j < d; j++) best[j] = pop[bi][j];
+  if (evals) *evals = spent;
   return fit[bi];
 }
 
+// Lloyd k-means on z-scored per-pixel features (nf per pixel, node-major).
+// Clusters start from evenly spaced pixels; clusters that end up empty are
+// dropped. assign maps each pixel to an index into reps, and reps holds the
+// pixel nearest each centroid.
+static void KMeansPixels(std::vector<float> *features, int nf, int k,
+                         std::vector<int> *assign, std::vector<long> *reps) {
+  std::vector<float> &feat = *features;
+  const size_t n = feat.size() / nf;
+  if ((size_t)k > n) k = (int)n;
+  for (int f = 0; f < nf; f++) {
+    double mean = 0.0, sq = 0.0;
+    for (size_t i = 0; i < n; i++) mean += feat[i * nf + f];
+    mean /= (n > 0 ? n : 1);
+    for (size_t i = 0; i < n; i++) {
+      double dv = feat[i * nf + f] - mean;
+      sq += dv * dv;
+    }
+    double sd = (n > 0 && sq > 0.0) ? sqrt(sq / n) : 1.0;
+    for (size_t i = 0; i < n; i++) {
+      feat[i * nf + f] = (float)((feat[i * nf + f] - mean) / sd);
+    }
+  }
+
+  std::vector<double> cent(k * nf);
+  for (int c = 0; c < k; c++) {
+    size_t i = (size_t)c * n / k;
+    for (int f = 0; f < nf; f++) cent[c * nf + f] = feat[i * nf + f];
+  }
+  assign->assign(n, -1);
+  std::vector<int> &as = *assign;
+  for (int iter = 0; iter < 50; iter++) {
+    long changed = 0;
+#pragma omp parallel for schedule(static) reduction(+ : changed)
+    for (long i = 0; i < (long)n; i++) {
+      int bc = 0;
+      double bd = 0.0;
+      for (int c = 0; c < k; c++) {
+        double dist = 0.0;
+        for (int f = 0; f < nf; f++) {
+          double dv = feat[i * nf + f] - cent[c * nf + f];
+          dist += dv * dv;
+        }
+        if (c == 0 || dist < bd) {
+          bd = dist;
+          bc = c;
+        }
+      }
+      if (as[i] != bc) {
+        as[i] = bc;
+        changed++;
+      }
+    }
+    if (changed == 0) {
+      break;
+    }
+    std::vector<double> sum(k * nf, 0.0);
+    std::vector<long> count(k, 0);
+    for (size_t i = 0; i < n; i++) {
+      count[as[i]]++;
+      for (int f = 0; f < nf; f++) sum[as[i] * nf + f] += feat[i * nf + f];
+    }
+    for (int c = 0; c < k; c++) {
+      if (count[c] == 0) continue;
+      for (int f = 0; f < nf; f++) cent[c * nf + f] = sum[c * nf + f] / count[c];
+    }
+  }
+
+  // Representative = member nearest the centroid; renumber without empties
+  std::vector<long> nearest(k, -1);
+  std::vector<double> nearestDist(k, 0.0);
+  for (size_t i = 0; i < n; i++) {
+    int c = as[i];
+    double dist = 0.0;
+    for (int f = 0; f < nf; f++) {
+      double dv = feat[i * nf + f] - cent[c * nf + f];
+      dist += dv * dv;
+    }
+    if (nearest[c] < 0 || dist < nearestDist[c]) {
+      nearest[c] = (long)i;
+      nearestDist[c] = dist;
+    }
+  }
+  std::vector<int> renumber(k, -1);
+  reps->clear();
+  for (int c = 0; c < k; c++) {
+    if (nearest[c] < 0) continue;
+    renumber[c] = (int)reps->size();
+    reps->push_back(nearest[c]);
+  }
+  for (size_t i = 0; i < n; i++) as[i] = renumber[as[i]];
+}
+
 } // namespace
 
 bool Simulator::LoadObsField(const char *pattern,
@@ -2916,6 +3377,179 @@ bool Simulator::LoadObsField(const char *pattern,
   return true;
 }
 
+// Side of the square node x step tiles the forcings are transposed in
+#define PIXEL_TILE 64
+
+void Simulator::TransposeToNodeMajor(std::vector<std::vector<float> > *field,
+                                     std::vector<float> *out) {
+  const size_t nSteps = totalTimeSteps, nNodes = nodes.size();
+  const long numNodeTiles = (long)((nNodes + PIXEL_TILE - 1) / PIXEL_TILE);
+  out->resize(nSteps * nNodes);
+
+  for (size_t t0 = 0; t0 < nSteps; t0 += PIXEL_TILE) {
+    size_t t1 = (t0 + PIXEL_TILE < nSteps) ? t0 + PIXEL_TILE : nSteps;
+#pragma omp parallel for schedule(static)
+    for (long tile = 0; tile < numNodeTiles; tile++) {
+      size_t i0 = (size_t)tile * PIXEL_TILE;
+      size_t i1 = (i0 + PIXEL_TILE < nNodes) ? i0 + PIXEL_TILE : nNodes;
+      for (size_t t = t0; t < t1; t++) {
+        const float *row = &((*field)[t][0]);
+        for (size_t i = i0; i < i1; i++) {
+          (*out)[i * nSteps + t] = row[i];
+        }
+      }
+    }
+    // These steps are done, hand their memory back before the next block
+    for (size_t t = t0; t < t1; t++) {
+      std::vector<float>().swap((*field)[t]);
+    }
+  }
+}
+
+bool Simulator::BuildPixelForcings(TaskConfigSection *task) {
+#if _OPENMP
+  double beginBuild = omp_get_wtime();
+#endif
+
+  TransposeToNodeMajor(&currentPrecipCali, &pixelPrecip);
+  TransposeToNodeMajor(&currentPETCali, &pixelPET);
+
+  // Load gridded observations into [step][node], one field at a time
+  std::vector<std::vector<float> > obsField;
+  if (!LoadObsField(task->GetObsSurface(), obsField)) {
+    return false;
+  }
+  TransposeToNodeMajor(&obsField, &pixelObsSurf);
+  if (!LoadObsField(task->GetObsSubsurface(), obsField)) {
+    return false;
+  }
+  TransposeToNodeMajor(&obsField, &pixelObsSub);
+
+#if _OPENMP
+  INFO_LOGF("Built node-major per-pixel forcings in %.1f s",
+            omp_get_wtime() - beginBuild);
+#endif
+  return true;
+}
+
+// The forcing file names are hashed as they resolve for the first step, the
+// DatedName patterns themselves are overwritten once in use
+void Simulator::HashForcingSources(TaskConfigSection *task,
+                                   unsigned long long *hash) {
+  TimeVar firstStep = *(task->GetTimeBegin());
+  firstStep.Increment(task->GetTimeStep());
+
+  PrecipConfigSection *precip = task->GetPrecipSec();
+  precip->GetFileName()->UpdateName(firstStep.GetTM());
+  HashString(hash, precip->GetLoc());
+  HashString(hash, precip->GetFileName()->GetName());
+  unsigned long precipSource[2] = {(unsigned long)precip->GetType(),
+                                   precip->GetUnitTime()->GetTimeInSec()};
+  HashBytes(hash, precipSource, sizeof(precipSource));
+
+  PETConfigSection *pet = task->GetPETSec();
+  pet->GetFileName()->UpdateName(firstStep.GetTM());
+  HashString(hash, pet->GetLoc());
+  HashString(hash, pet->GetFileName()->GetName());
+  unsigned long petSource[3] = {(unsigned long)pet->GetType(),
+                                (unsigned long)pet->IsTemperature(),
+                                pet->GetUnitTime()->GetTimeInSec()};
+  HashBytes(hash, petSource, sizeof(petSource));
+}
+
+unsigned long long Simulator::PixelForcingsKey(TaskConfigSection *task) {
+  unsigned long long hash = CACHE_HASH_BASIS;
+  HashForcingSources(task, &hash);
+  HashString(&hash, task->GetObsSurface());
+  HashString(&hash, task->GetObsSubsurface());
+  return hash;
+}
+
+// Same header as the preload file plus the source key, then each field a tile
+// of nodes at a time
+void Simulator::SavePixelForcings(char *file, TaskConfigSection *task) {
+  gzFile filep = gzopen(file, "w1");
+  if (filep == NULL) {
+    WARNING_LOGF("Failed to save per-pixel forcing file %s", file);
+    return;
+  }
+  size_t numNodes = nodes.size();
+  unsigned long long key = PixelForcingsKey(task);
+  gzwrite(filep, &(beginTime.currentTimeSec), sizeof(time_t));
+  gzwrite(filep, &(endTime.currentTimeSec), sizeof(time_t));
+  gzwrite(filep, &totalTimeSteps, sizeof(totalTimeSteps));
+  gzwrite(filep, &numNodes, sizeof(numNodes));
+  gzwrite(filep, &key, sizeof(key));
+  std::vector<float> *fields[] = {&pixelPrecip, &pixelPET, &pixelObsSurf,
+                                  &pixelObsSub};
+  size_t tileFloats = PIXEL_TILE * totalTimeSteps;
+  for (int f = 0; f < 4; f++) {
+    for (size_t offset = 0; offset < fields[f]->size(); offset += tileFloats) {
+      size_t count = fields[f]->size() - offset;
+      if (count > tileFloats) {
+        count = tileFloats;
+      }
+      gzwrite(filep, &(fields[f]->at(offset)),
+              (unsigned int)(sizeof(float) * count));
+    }
+  }
+  gzclose(filep);
+}
+
+bool Simulator::LoadPixelForcings(char *file, TaskConfigSection *task) {
+  gzFile filep = gzopen(file, "r");
+  if (filep == NULL) {
+    return false;
+  }
+  time_t beginSec, endSec;
+  size_t steps, numNodes;
+  unsigned long long key;
+  if (gzread(filep, &beginSec, sizeof(time_t)) != sizeof(time_t) ||
+      gzread(filep, &endSec, sizeof(time_t)) != sizeof(time_t) ||
+      gzread(filep, &steps, sizeof(steps)) != sizeof(steps) ||
+      gzread(filep, &numNodes, sizeof(numNodes)) != sizeof(numNodes) ||
+      gzread(filep, &key, sizeof(key)) != sizeof(key) ||
+      beginSec != beginTime.currentTimeSec ||
+      endSec != endTime.currentTimeSec || steps != totalTimeSteps ||
+      numNodes != nodes.size() || key != PixelForcingsKey(task)) {
+    gzclose(filep);
+    WARNING_LOGF("Per-pixel forcing file %s does not match this task, not "
+                 "loaded",
+                 file);
+    return false;
+  }
+
+  INFO_LOGF("Loading saved per-pixel forcing file, %s!", file);
+
+  std::vector<float> *fields[] = {&pixelPrecip, &pixelPET, &pixelObsSurf,
+                                  &pixelObsSub};
+  size_t tileFloats = PIXEL_TILE * totalTimeSteps;
+  for (int f = 0; f < 4; f++) {
+    fields[f]->resize(numNodes * steps);
+    for (size_t offset = 0; offset < fields[f]->size(); offset += tileFloats) {
+      size_t count = fields[f]->size() - offset;
+      if (count > tileFloats) {
+        count = tileFloats;
+      }
+      unsigned int bytes = (unsigned int)(sizeof(float) * count);
+      if (gzread(filep, &(fields[f]->at(offset)), bytes) != (int)bytes) {
+        gzclose(filep);
+        WARNING_LOGF("Per-pixel forcing file %s is truncated, not loaded",
+                     file);
+        for (int c = 0; c < 4; c++) {
+          std::vector<float>().swap(*(fields[c]));
+        }
+        return false;
+      }
+    }
+  }
+  gzclose(filep);
+  return true;
+}
+
+// Side in pixels of the spatial blocks the warm start seeds in order
+#define PIXEL_BLOCK 16
+
 bool Simulator::CalibratePerPixel(TaskConfigSection *task) {
   char *surfPat = task->GetObsSurface();
   char *subPat = task->GetObsSubsurface();
@@ -2947,71 +3581,210 @@ bool Simulator::CalibratePerPixel(TaskConfigSection *task) {
             "budget %d evals/pixel",
             d, nNodes, nSteps, evalN, ndraw);
 
-  // Load gridded observations into [step][node].
-  std::vector<std::vector<float> > obsSurf, obsSub;
-  LoadObsField(surfPat, obsSurf);
-  LoadObsField(subPat, obsSub);
+  // Each pixel reads its own contiguous series from the node-major copies
+  if (pixelPrecip.empty()) {
+    char cacheFile[CONFIG_MAX_LEN * 2];
+    if (!BuildPixelForcings(task)) {
+      return false;
+    }
+    sprintf(cacheFile, "%s/%s", task->GetOutput(), "pixelforcings.bin");
+    SavePixelForcings(cacheFile, task);
+  }
 
-  std::vector<std::vector<float> > paramField(d, std::vector<float>(nNodes, 0.0f));
+  const bool warmStart = caliParamSec->PixelWarmStart();
+  const int numClusters = caliParamSec->PixelGetClusters();
+  const double spreadTol = caliParamSec->PixelGetSpreadTol();
+  if (warmStart && numClusters > 0) {
+    WARNING_LOGF("%s", "pixel_clusters takes precedence over pixel_warmstart");
+  }
 
+  // Best parameters, node-major so converged pixels can seed their neighbours
+  std::vector<float> bestAll(nNodes * d, 0.0f);
+  long long totalEvals = 0;
   long done = 0;
-#pragma omp parallel for schedule(dynamic, 16)
-  for (size_t i = 0; i < nNodes; i++) {
-    std::vector<float> precip(nSteps), pet(nSteps);
-    std::vector<float> os(nSteps), ob(nSteps), sims(nSteps), simb(nSteps);
-    for (int t = 0; t < nSteps; t++) {
-      precip[t] = currentPrecipCali[t][i];
-      pet[t] = currentPETCali[t][i];
-      os[t] = obsSurf[t][i];
-      ob[t] = obsSub[t][i];
-    }
-    // cost(cand) -> negated mean of surface & subsurface costs (maximize -> min cost)
-    CRESTPHYSGridNode cn;
-    HPGridNode hn;
-    auto cost = [&](const float *cand) -> double {
+
+  // Calibrates pixel i into bestAll, optionally seeded; returns evaluations
+  auto calibrate = [&](size_t i, const float *const *seeds, int numSeeds,
+                       double tol, int budget) -> int {
+    const float *precip = &(pixelPrecip[i * nSteps]);
+    const float *pet = &(pixelPET[i * nSteps]);
+    const float *os = &(pixelObsSurf[i * nSteps]);
+    const float *ob = &(pixelObsSub[i * nSteps]);
+    SignalObsStats surfStats = SignalObs(&os[warmSteps], evalN);
+    SignalObsStats subStats = SignalObs(&ob[warmSteps], evalN);
+
+    // cost(cands) -> negated mean of surface & subsurface costs (maximize ->
+    // min cost). The population steps through time together: every member
+    // takes the same forcing step, and the cost sums are folded in as the
+    // runoff is produced rather than from stored series.
+    std::vector<CRESTPHYSGridNode> cns;
+    std::vector<HPGridNode> hns;
+    std::vector<SignalSimSums> surfSums, subSums;
+    auto cost = [&](const float *const *cands, int np, double *fits) {
+      surfSums.assign(np, SignalSimSums());
+      subSums.assign(np, SignalSimSums());
       if (cm) {
-        memset(&cn, 0, sizeof(cn));
-        for (int p = 0; p < PARAM_CRESTPHYS_QTY; p++) cn.params[p] = cand[p];
-        cn.params[PARAM_CRESTPHYS_IM] /= 100.0f;
-        if (cn.params[PARAM_CRESTPHYS_WM] < 1e-3f) cn.params[PARAM_CRESTPHYS_WM] = 1e-3f;
-        if (cn.params[PARAM_CRESTPHYS_HMAXAQ] < 1e-3f) cn.params[PARAM_CRESTPHYS_HMAXAQ] = 1e-3f;
-        cn.states[STATE_CRESTPHYS_SM] =
-            cand[PARAM_CRESTPHYS_IWU] * cn.params[PARAM_CRESTPHYS_WM] / 100.0f;
-        cn.states[STATE_CRESTPHYS_GW] =
-            cand[PARAM_CRESTPHYS_IGW] * cn.params[PARAM_CRESTPHYS_HMAXAQ] / 100.0f;
-        for (int t = 0; t < nSteps; t++) {
-          float f = 0, in = 0, b = 0;
-          cm->WaterBalanceInt(NULL, &cn, stepHours, precip[t], pet[t], &f, &in, &b);
-          sims[t] = f * 3600.0f;
-          simb[t] = in * 3600.0f;
+        cns.resize(np);
+        for (int k = 0; k < np; k++) {
+          CRESTPHYSGridNode &cn = cns[k];
+          const float *cand = cands[k];
+          memset(&cn, 0, sizeof(cn));
+          for (int p = 0; p < PARAM_CRESTPHYS_QTY; p++) cn.params[p] = cand[p];
+          cn.params[PARAM_CRESTPHYS_IM] /= 100.0f;
+          if (cn.params[PARAM_CRESTPHYS_WM] < 1e-3f) cn.params[PARAM_CRESTPHYS_WM] = 1e-3f;
+          if (cn.params[PARAM_CRESTPHYS_HMAXAQ] < 1e-3f) cn.params[PARAM_CRESTPHYS_HMAXAQ] = 1e-3f;
+          cn.states[STATE_CRESTPHYS_SM] =
+              cand[PARAM_CRESTPHYS_IWU] * cn.params[PARAM_CRESTPHYS_WM] / 100.0f;
+          cn.states[STATE_CRESTPHYS_GW] =
+              cand[PARAM_CRESTPHYS_IGW] * cn.params[PARAM_CRESTPHYS_HMAXAQ] / 100.0f;
         }
       } else {
-        memset(&hn, 0, sizeof(hn));
-        for (int p = 0; p < PARAM_HP_QTY; p++) hn.params[p] = cand[p];
-        for (int t = 0; t < nSteps; t++) {
-          float f = 0, sl = 0;
-          hm->WaterBalanceInt(NULL, &hn, stepHours, precip[t], pet[t], &f, &sl);
-          sims[t] = f * 3600.0f;
-          simb[t] = sl * 3600.0f;
+        hns.resize(np);
+        for (int k = 0; k < np; k++) {
+          memset(&hns[k], 0, sizeof(hns[k]));
+          for (int p = 0; p < PARAM_HP_QTY; p++) hns[k].params[p] = cands[k][p];
+        }
+      }
+      for (int t = 0; t < nSteps; t++) {
+        bool surfValid = (t >= warmSteps && os[t] > OBS_NODATA + 1.0f);
+        bool subValid = (t >= warmSteps && ob[t] > OBS_NODATA + 1.0f);
+        for (int k = 0; k < np; k++) {
+          float f = 0, in = 0, b = 0;
+          if (cm) {
+            cm->WaterBalanceInt(NULL, &cns[k], stepHours, precip[t], pet[t], &f, &in, &b);
+          } else {
+            hm->WaterBalanceInt(NULL, &hns[k], stepHours, precip[t], pet[t], &f, &in);
+          }
+          if (surfValid)
+            SignalAccumulate(&surfSums[k], surfStats, f * 3600.0f, os[t]);
+          if (subValid)
+            SignalAccumulate(&subSums[k], subStats, in * 3600.0f, ob[t]);
         }
       }
       // Objective: minimize the mean of the surface & subsurface costs. The
       // optimizer maximizes, so return the negated mean cost.
-      double cs = SignalCost(&sims[warmSteps], &os[warmSteps], evalN);
-      double cb = SignalCost(&simb[warmSteps], &ob[warmSteps], evalN);
-      return -0.5 * (cs + cb);
+      for (int k = 0; k < np; k++) {
+        fits[k] = -0.5 * (SignalCost(surfStats, surfSums[k]) +
+                          SignalCost(subStats, subSums[k]));
+      }
     };
 
-    float best[PARAM_CRESTPHYS_QTY > 8 ? PARAM_CRESTPHYS_QTY : 8];
-    DEOptimize(d, lo, hi, cost, best,
-               (unsigned long long)(i + 1) * 2654435761ULL, ndraw);
-    for (int p = 0; p < d; p++) paramField[p][i] = best[p];
-
-#pragma omp atomic
-    done++;
-    if ((done & 4095) == 0) {
-      NORMAL_LOGF(" per-pixel cali: %ld/%zu pixels", done, nNodes);
+    int evals = 0;
+    DEOptimize(d, lo, hi, cost, &(bestAll[i * d]),
+               (unsigned long long)(i + 1) * 2654435761ULL, budget, seeds,
+               numSeeds, tol, &evals);
+
+    long doneNow;
+#pragma omp atomic capture
+    doneNow = ++done;
+    if ((doneNow & 4095) == 0) {
+      NORMAL_LOGF(" per-pixel cali: %ld/%zu pixels", doneNow, nNodes);
+    }
+    return evals;
+  };
+
+  if (numClusters > 0) {
+    // Cluster pixels on their mean precip, PET and observed runoff, calibrate
+    // the pixel nearest each centroid with the full budget, then refine the
+    // members from their representative with a quarter of it.
+    const int nf = 4;
+    std::vector<float> features(nNodes * nf);
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < nNodes; i++) {
+      double sp = 0.0, se = 0.0;
+      for (int t = 0; t < nSteps; t++) {
+        sp += pixelPrecip[i * nSteps + t];
+        se += pixelPET[i * nSteps + t];
+      }
+      features[i * nf] = (float)(sp / nSteps);
+      features[i * nf + 1] = (float)(se / nSteps);
+      features[i * nf + 2] =
+          (float)SignalObs(&(pixelObsSurf[i * nSteps + warmSteps]), evalN).mo;
+      features[i * nf + 3] =
+          (float)SignalObs(&(pixelObsSub[i * nSteps + warmSteps]), evalN).mo;
+    }
+    std::vector<int> assign;
+    std::vector<long> reps;
+    KMeansPixels(&features, nf, numClusters, &assign, &reps);
+    INFO_LOGF("Per-pixel calibration: %zu cluster representatives",
+              reps.size());
+
+#pragma omp parallel for schedule(dynamic, 1) reduction(+ : totalEvals)
+    for (long c = 0; c < (long)reps.size(); c++) {
+      totalEvals += calibrate(reps[c], NULL, 0, 0.0, ndraw);
+    }
+    std::vector<char> isRep(nNodes, 0);
+    for (size_t c = 0; c < reps.size(); c++) {
+      isRep[reps[c]] = 1;
+    }
+#pragma omp parallel for schedule(dynamic, 16) reduction(+ : totalEvals)
+    for (size_t i = 0; i < nNodes; i++) {
+      if (isRep[i]) continue;
+      const float *seed = &(bestAll[reps[assign[i]] * d]);
+      totalEvals += calibrate(i, &seed, 1, spreadTol, ndraw / 4);
+    }
+  } else if (warmStart && nNodes > 0) {
+    // Pixels are taken in 16x16 cell blocks, one block per thread, in raster
+    // order inside the block so the left and upper neighbours finish first.
+    long minX = nodes[0].x, maxX = nodes[0].x, minY = nodes[0].y, maxY = nodes[0].y;
+    for (size_t i = 1; i < nNodes; i++) {
+      if (nodes[i].x < minX) minX = nodes[i].x;
+      if (nodes[i].x > maxX) maxX = nodes[i].x;
+      if (nodes[i].y < minY) minY = nodes[i].y;
+      if (nodes[i].y > maxY) maxY = nodes[i].y;
+    }
+    const long width = maxX - minX + 1, height = maxY - minY + 1;
+    std::vector<long> cellNode(width * height, -1);
+    for (size_t i = 0; i < nNodes; i++) {
+      cellNode[(nodes[i].y - minY) * width + (nodes[i].x - minX)] = (long)i;
+    }
+    std::vector<char> finished(nNodes, 0);
+    const long blocksX = (width + PIXEL_BLOCK - 1) / PIXEL_BLOCK;
+    const long numBlocks = blocksX * ((height + PIXEL_BLOCK - 1) / PIXEL_BLOCK);
+
+#pragma omp parallel for schedule(dynamic, 1) reduction(+ : totalEvals)
+    for (long blk = 0; blk < numBlocks; blk++) {
+      long x0 = (blk % blocksX) * PIXEL_BLOCK, y0 = (blk / blocksX) * PIXEL_BLOCK;
+      long x1 = (x0 + PIXEL_BLOCK < width) ? x0 + PIXEL_BLOCK : width;
+      long y1 = (y0 + PIXEL_BLOCK < height) ? y0 + PIXEL_BLOCK : height;
+      for (long y = y0; y < y1; y++) {
+        for (long x = x0; x < x1; x++) {
+          long i = cellNode[y * width + x];
+          if (i < 0) continue;
+          // Left, upper-left, upper and upper-right neighbours in this block
+          const float *seeds[4];
+          int numSeeds = 0;
+          const long nx[4] = {x - 1, x - 1, x, x + 1};
+          const long ny[4] = {y, y - 1, y - 1, y - 1};
+          for (int k = 0; k < 4; k++) {
+            if (nx[k] < x0 || nx[k] >= x1 || ny[k] < y0) continue;
+            long n = cellNode[ny[k] * width + nx[k]];
+            if (n >= 0 && finished[n]) seeds[numSeeds++] = &(bestAll[n * d]);
+          }
+          totalEvals += calibrate(i, seeds, numSeeds,
+                                  numSeeds > 0 ? spreadTol : 0.0, ndraw);
+          finished[i] = 1;
+        }
+      }
     }
+  } else {
+#pragma omp parallel for schedule(dynamic, 16) reduction(+ : totalEvals)
+    for (size_t i = 0; i < nNodes; i++) {
+      totalEvals += calibrate(i, NULL, 0, 0.0, ndraw);
+    }
+  }
+
+  int NP, gens;
+  DESize(d, ndraw, &NP, &gens);
+  double nominal = (double)nNodes * NP * (gens + 1);
+  INFO_LOGF("Per-pixel calibration used %lld evaluations of %.0f nominal "
+            "(%.1f%% saved)",
+            totalEvals, nominal,
+            nominal > 0.0 ? 100.0 * (1.0 - totalEvals / nominal) : 0.0);
+
+  std::vector<std::vector<float> > paramField(d, std::vector<float>(nNodes, 0.0f));
+  for (size_t i = 0; i < nNodes; i++) {
+    for (int p = 0; p < d; p++) paramField[p][i] = bestAll[i * d + p];
   }
 
   // Stitch each calibrated parameter into a raster (skip fixed params lo==hi).
@@ -16,10 +16,15 @@
 #include "TempReader.h"
 #include "LakeModel.h"
 #include "LakeMap.h"
+#include "NodeIndex.h"
+#include "ReservoirTable.h"
 #include "InletConfigSection.h"
 
+class CaliWorkerPool;
+
 class Simulator {
 public:
+  Simulator() : caliGaugeOverride(NULL), workerPool(NULL) {}
   bool Initialize(TaskConfigSection *taskN);
   void PreloadForcings(char *file, bool cali);
   bool LoadSavedForcings(char *file, bool cali);
@@ -28,14 +33,34 @@ public:
   void CleanUp();
   void BasinAvg();
   void Simulate(bool trackPeaks = false);
-  float SimulateForCali(float *testParams);
+  // outflow, if given, receives the calibration gauge discharge for every
+  // time step including the warm up
+  float SimulateForCali(float *testParams, std::vector<float> *outflow = NULL);
+  // Evaluates a population of parameter sets in lockstep over the forcings.
+  void SimulateForCaliBatch(float **testParams, int count, float *scores);
   float *SimulateForCaliTS(float *testParams);
   // Per-pixel water-balance calibration against gridded surface/subsurface
   // runoff (STYLE_CALI_DREAM_PIXEL). No routing. Writes one param raster per
   // calibrated parameter to the task OUTPUT dir.
   bool CalibratePerPixel(TaskConfigSection *task);
+  // Node-major forcing/observation cache written by CalibratePerPixel. When
+  // this loads, PreloadForcings and the observation rasters can be skipped.
+  bool LoadPixelForcings(char *file, TaskConfigSection *task);
+  // Folds where the task's precipitation and PET come from, and their units,
+  // into a cache key
+  static void HashForcingSources(TaskConfigSection *task,
+                                 unsigned long long *hash);
   float *GetObsTS();
   size_t GetNumSteps() { return totalTimeStepsOutsideWarm; }
+  size_t GetNumTotalSteps() { return totalTimeSteps; }
+  int GetNumCaliGauges() { return (int)caliGauges.size(); }
+
+  // Cascade calibration: calibrate this gauge alone (set before Initialize)
+  // and let a frozen upstream outflow series stand in for a boundary gauge.
+  void SetCaliGauge(GaugeConfigSection *gauge) { caliGaugeOverride = gauge; }
+  void AddCascadeInflow(GaugeConfigSection *gauge, std::vector<float> *series);
+  // SimulateForCaliBatch hands its population to these worker processes
+  void SetWorkerPool(CaliWorkerPool *pool) { workerPool = pool; }
 
 private:
   bool InitializeBasic(TaskConfigSection *task);
@@ -46,11 +71,29 @@ private:
   // pattern) into field[timestep][node], aligned to the calibration steps.
   bool LoadObsField(const char *pattern,
                     std::vector<std::vector<float> > &field);
+  // Builds the node-major copies of the forcings and observations that the
+  // per-pixel calibration streams through, releasing the time-major ones.
+  bool BuildPixelForcings(TaskConfigSection *task);
+  void TransposeToNodeMajor(std::vector<std::vector<float> > *field,
+                            std::vector<float> *out);
+  void SavePixelForcings(char *file, TaskConfigSection *task);
+  // Hash of where the forcings and observations come from and their units
+  unsigned long long PixelForcingsKey(TaskConfigSection *task);
+  // Spreads one candidate across the per-gauge parameter blocks, either into
+  // a thread's calibration arrays or (slot < 0) the shared parameter sets.
+  void CopyCaliParams(float *testParams, int slot);
+  // Weighted objective over all calibration gauges
+  float CalcCaliObjective(std::vector<ObjectiveAccumulator> *skills);
+  void InjectCascadeInflows(RoutingModel *routeModel,
+                            std::vector<float> *fastFlow,
+                            std::vector<float> *interFlow,
+                            std::vector<float> *baseFlow, size_t tsIndex);
 
   void SimulateDistributed(bool trackPeaks);
   void SimulateLumped();
 
   float GetNumSimulatedYears();
+  void BuildStepTimes();
   int LoadForcings(PrecipReader *precipReader, PETReader *petReader,
                    TempReader *tempReader);
   void SaveLP3Params();
@@ -83,6 +126,7 @@ private:
   InundationModel *iModel;
   GaugeMap gaugeMap;
   LakeMap lakeMap;
+  NodeIndex nodeIndex;
   PrecipConfigSection *precipSec, *qpfSec;
   PETConfigSection *petSec;
   TempConfigSection *tempSec, *tempFSec;
@@ -109,7 +153,9 @@ private:
       currentSWE, avgT, avgSM,avgGW, avgFF, avgSF, avgBF, currentDepth;
   std::vector<float> currentLakeVolume; // Lake volume for output
   std::vector<LakeModelImpl*> lakeModels; // All lake models for inflow calculation
+  ReservoirTable reservoirs; // Per-step state of lakeModels, by position
   std::vector<InletConfigSection*> inlets; // All inlet configurations
+  std::vector<time_t> stepTimes; // Time of each tsIndex in SimulateDistributed
   std::vector<FloatGrid *> paramGrids, paramGridsRoute, paramGridsSnow,
       paramGridsInundation, paramGridsLake;
   bool hasQPF, hasTempF, wantsDA;
@@ -136,12 +182,23 @@ private:
   std::vector<std::vector<float> > currentPrecipCali, currentPETCali,
       currentTempCali;
   std::vector<float> obsQ, simQ;
+  // Per-pixel calibration only: series of node i start at i * totalTimeSteps
+  std::vector<float> pixelPrecip, pixelPET, pixelObsSurf, pixelObsSub;
   CaliParamConfigSection *caliParamSec;
   RoutingCaliParamConfigSection *routingCaliParamSec;
   SnowCaliParamConfigSection *snowCaliParamSec;
   LakeCaliParamConfigSection *lakeCaliParamSec;
   OBJECTIVES objectiveFunc;
   GaugeConfigSection *caliGauge;
+  std::vector<GaugeConfigSection *> caliGauges;
+  std::vector<float> caliWeights;
+  std::vector<std::vector<float> > obsQGauges;
+  std::vector<float *> caliWBParamsList, caliRParamsList, caliSParamsList;
+  int caliBlockSize;
+  GaugeConfigSection *caliGaugeOverride;
+  CaliWorkerPool *workerPool;
+  std::vector<long> cascadeInflowNodes;
+  std::vector<std::vector<float> *> cascadeInflows;
   float *caliWBParams;
   float *caliRParams;
   float *caliSParams;
@@ -3,7 +3,7 @@
 #include <cstdio>
 #include <zlib.h>
 
-FloatGrid *ReadFloatTRMMRTGrid(char *file, FloatGrid *grid) {
+FloatGrid *ReadFloatTRMMRTGrid(char *file, GridPool *pool) {
 
   gzFile fileH;
 
@@ -16,36 +16,20 @@ FloatGrid *ReadFloatTRMMRTGrid(char *file, FloatGrid *grid) {
 
   gzread(fileH, unprocessed, 2880);
 
+  FloatGrid *grid = NewFloatGrid(pool, 1440, 480);
   if (!grid) {
-    grid = new FloatGrid();
-    grid->numCols = 1440;
-    grid->numRows = 480;
-    grid->cellSize = 0.25;
-    grid->extent.bottom = -60.0;
-    grid->extent.left = -180.0;
-    grid->data = new float *[grid->numRows]();
-    if (!grid->data) {
-      WARNING_LOGF("TRMMRT file %s too large (out of memory) with %li rows",
-                   file, grid->numRows);
-      delete grid;
-      gzclose(fileH);
-      return NULL;
-    }
-    for (long i = 0; i < grid->numRows; i++) {
-      grid->data[i] = new float[grid->numCols]();
-      if (!grid->data[i]) {
-        WARNING_LOGF("TRMMRT file %s too large (out of memory) with %li colums",
-                     file, grid->numCols);
-        delete grid;
-        gzclose(fileH);
-        return NULL;
-      }
-    }
+    WARNING_LOGF("TRMMRT file %s too large (out of memory)", file);
+    gzclose(fileH);
+    return NULL;
   }
+  grid->cellSize = 0.25;
+  grid->extent.bottom = -60.0;
+  grid->extent.left = -180.0;
+  grid->geoSet = false;
   unsigned short *shortData = new unsigned short[grid->numCols];
   if (!shortData) {
     WARNING_LOGF("TRMMRT file %s too large (out of memory)", file);
-    delete grid;
+    FreeFloatGrid(pool, grid);
     gzclose(fileH);
     return NULL;
   }
@@ -55,7 +39,7 @@ FloatGrid *ReadFloatTRMMRTGrid(char *file, FloatGrid *grid) {
                (unsigned int)(sizeof(short) * grid->numCols)) !=
         (int)sizeof(short) * grid->numCols) {
       WARNING_LOGF("TRMMRT file %s corrupt?", file);
-      delete grid;
+      FreeFloatGrid(pool, grid);
       delete[] shortData;
       gzclose(fileH);
       return NULL;
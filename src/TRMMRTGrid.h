@@ -2,8 +2,9 @@
 #define TRMMRT_GRID_H
 
 #include "Grid.h"
+#include "GridPool.h"
 
-FloatGrid *ReadFloatTRMMRTGrid(char *file, FloatGrid *grid);
+FloatGrid *ReadFloatTRMMRTGrid(char *file, GridPool *pool);
 FloatGrid *ReadFloatTRMMRTGrid(char *file);
 
 #endif
@@ -27,6 +27,9 @@ TaskConfigSection::TaskConfigSection(const char *nameVal) {
   routingParamsSet = false;
   snowParamsSet = false;
   inundationParamsSet = false;
+  inundationTolerance = 0.0;
+  wbIdleThreshold = 0.0;
+  routeIdleThreshold = 0.0;
 
   lakeCaliParamSet = false;
   lakeModuleSet = false;
@@ -51,6 +54,8 @@ TaskConfigSection::TaskConfigSection(const char *nameVal) {
   caliParamLake = NULL;
   obsSurface[0] = 0;
   obsSubsurface[0] = 0;
+  checkpointFile[0] = 0;
+  resumeCheckpoint = false;
   stdGrid[0] = 0;
   avgGrid[0] = 0;
   scGrid[0] = 0;
@@ -79,6 +84,7 @@ char *TaskConfigSection::GetName() { return name; }
 char *TaskConfigSection::GetOutput() { return output; }
 char *TaskConfigSection::GetObsSurface() { return obsSurface; }
 char *TaskConfigSection::GetObsSubsurface() { return obsSubsurface; }
+char *TaskConfigSection::GetCheckpointFile() { return checkpointFile; }
 
 char *TaskConfigSection::GetState() { return state; }
 
@@ -213,7 +219,8 @@ CONFIG_SEC_RET TaskConfigSection::ProcessKeyValue(char *name, char *value) {
     }
     ERROR_LOGF("Unknown run style option \"%s\"!", value);
     INFO_LOGF("Valid run style options are \"%s\"", "SIMU, SIMU_RP, CALI_ARS, "
-                                                    "CALI_DREAM, CLIP_BASIN, "
+                                                    "CALI_DREAM, CALI_CASCADE, "
+                                                    "CLIP_BASIN, "
                                                     "CLIP_GAUGE, BASIN_AVG");
     return INVALID_RESULT;
   } else if (!strcasecmp(name, "model")) {
@@ -264,6 +271,26 @@ CONFIG_SEC_RET TaskConfigSection::ProcessKeyValue(char *name, char *value) {
     INFO_LOGF("Valid inundation options are \"%s\"",
               "SIMPLEINUNDATION, VCINUNDATION");
     return INVALID_RESULT;
+  } else if (!strcasecmp(name, "inundation_tolerance")) {
+    char *end;
+    inundationTolerance = strtod(value, &end);
+    if (end == value || *end || inundationTolerance < 0.0) {
+      ERROR_LOGF("Invalid inundation tolerance \"%s\"!", value);
+      return INVALID_RESULT;
+    }
+  } else if (!strcasecmp(name, "wb_idle_threshold") ||
+             !strcasecmp(name, "route_idle_threshold")) {
+    char *end;
+    float threshold = strtod(value, &end);
+    if (end == value || *end || threshold < 0.0) {
+      ERROR_LOGF("Invalid idle threshold \"%s\"!", value);
+      return INVALID_RESULT;
+    }
+    if (!strcasecmp(name, "wb_idle_threshold")) {
+      wbIdleThreshold = threshold;
+    } else {
+      routeIdleThreshold = threshold;
+    }
   } else if (!strcasecmp(name, "basin")) {
     TOLOWER(value);
     std::map<std::string, BasinConfigSection *>::iterator itr =
@@ -398,6 +425,18 @@ CONFIG_SEC_RET TaskConfigSection::ProcessKeyValue(char *name, char *value) {
     strcpy(obsSurface, value);
   } else if (!strcasecmp(name, "obs_subsurface")) {
     strcpy(obsSubsurface, value);
+  } else if (!strcasecmp(name, "checkpoint_file")) {
+    strcpy(checkpointFile, value);
+  } else if (!strcasecmp(name, "resume")) {
+    if (!strcasecmp(value, "true")) {
+      resumeCheckpoint = true;
+    } else if (!strcasecmp(value, "false")) {
+      resumeCheckpoint = false;
+    } else {
+      ERROR_LOGF("Invalid resume value \"%s\"! Must be 'true' or 'false'",
+                 value);
+      return INVALID_RESULT;
+    }
   } else if (!strcasecmp(name, "output")) {
     strcpy(output, value);
     outputSet = true;
@@ -648,6 +687,9 @@ CONFIG_SEC_RET TaskConfigSection::ValidateSection() {
   } else if (!timeEndSet) {
     ERROR_LOG("The ending time was not specified");
     return INVALID_RESULT;
+  } else if (resumeCheckpoint && !checkpointFile[0]) {
+    ERROR_LOG("Resuming a calibration requires a checkpoint_file");
+    return INVALID_RESULT;
   } else if (snowSet && !snowParamsSet) {
     ERROR_LOG("The snow parameter set was not specified");
     return INVALID_RESULT;
@@ -680,6 +722,12 @@ CONFIG_SEC_RET TaskConfigSection::ValidateSection() {
       return INVALID_RESULT;
     }
 
+    // Frozen upstream outflows are injected as kinematic wave channel inflow
+    if (style == STYLE_CALI_CASCADE && routing != ROUTE_KINEMATIC) {
+      ERROR_LOG("Cascade calibration requires kinematic wave routing");
+      return INVALID_RESULT;
+    }
+
     char *gaugeWB = caliParam->GetGauge()->GetName();
     char *gaugeR = caliParamRouting->GetGauge()->GetName();
     char *gaugeS = NULL;
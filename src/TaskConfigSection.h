@@ -51,6 +51,9 @@ public:
   // DatedName tokens) for STYLE_CALI_DREAM_PIXEL. Empty if unset.
   char *GetObsSurface();
   char *GetObsSubsurface();
+  // Calibration checkpoint file (empty if unset) and whether to resume from it
+  char *GetCheckpointFile();
+  bool ResumeCheckpoint() { return resumeCheckpoint; }
   TimeVar *GetTimeBegin();
   std::vector<TimeVar*> *GetTimeBegins();  
   TimeVar *GetTimeWarmEnd();
@@ -66,6 +69,7 @@ public:
   TempConfigSection *GetTempSec();
   TempConfigSection *GetTempFSec();
   BasinConfigSection *GetBasinSec();
+  void SetBasinSec(BasinConfigSection *newBasin) { basin = newBasin; }
   ParamSetConfigSection *GetParamsSec();
   CaliParamConfigSection *GetCaliParamSec();
   RoutingParamSetConfigSection *GetRoutingParamsSec();
@@ -88,6 +92,9 @@ public:
   CONFIG_SEC_RET ProcessKeyValue(char *name, char *value);
   CONFIG_SEC_RET ValidateSection();
   int GetGriddedOutputs() { return griddedOutputs; }
+  float GetInundationTolerance() { return inundationTolerance; }
+  float GetWBIdleThreshold() { return wbIdleThreshold; }
+  float GetRouteIdleThreshold() { return routeIdleThreshold; }
   
 
   static bool IsDuplicate(char *name);
@@ -102,6 +109,7 @@ private:
   bool lakeCaliParamSet;
   bool lakeModuleSet, lakeModuleEnabled;
   bool timeBeginLRSet, timestepLRSet;
+  bool resumeCheckpoint;
   char output[CONFIG_MAX_LEN], state[CONFIG_MAX_LEN];
   char name[CONFIG_MAX_LEN];
   char stdGrid[CONFIG_MAX_LEN], avgGrid[CONFIG_MAX_LEN], scGrid[CONFIG_MAX_LEN];
@@ -114,6 +122,7 @@ private:
   char coFile[CONFIG_MAX_LEN];
   char obsSurface[CONFIG_MAX_LEN];
   char obsSubsurface[CONFIG_MAX_LEN];
+  char checkpointFile[CONFIG_MAX_LEN];
   MODELS model;
   ROUTES routing;
   SNOWS snow;
@@ -142,6 +151,8 @@ private:
   TimeVar timeState;
   TimeVar timeBeginLR;
   int griddedOutputs;
+  float inundationTolerance;
+  float wbIdleThreshold, routeIdleThreshold;
 
   bool LoadGriddedOutputs(char *value);
   std::vector<TimeVar*> timeBegins;
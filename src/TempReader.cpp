@@ -9,7 +9,7 @@
 #include <cstdio>
 #include <cstring>
 #include "DatedName.h"
-#include <map>
+#include <algorithm>
 
 void TempReader::ReadDEM(char *file) {
   tempDEM = ReadFloatTifGrid(file);
@@ -29,38 +29,62 @@ void TempReader::EnsureElevationCorrection(FloatGrid *tempGrid, std::vector<Grid
   temModCols = tempGrid->numCols;
   temModRows = tempGrid->numRows;
 
-  // Compute minimum DEM elevation only for tempGrid pixels overlapping the basin
-  std::map<long long, float> minElevByPixel;
+  // Compute minimum DEM elevation only for tempGrid pixels overlapping the
+  // basin, in a dense table over the bounding box of those pixels
+  size_t numNodes = nodes->size();
+  std::vector<long> pixelX(numNodes, -1), pixelY(numNodes, -1);
+  long minX = tempGrid->numCols, minY = tempGrid->numRows, maxX = -1, maxY = -1;
 
   GridLoc pt;
-  for (size_t i = 0; i < nodes->size(); i++) {
+  for (size_t i = 0; i < numNodes; i++) {
     GridNode *node = &(nodes->at(i));
     if (tempGrid->GetGridLoc(node->refLoc.x, node->refLoc.y, &pt)) {
-      long long key = (((long long)pt.y) << 32) | (unsigned long)pt.x;
+      pixelX[i] = pt.x;
+      pixelY[i] = pt.y;
+      if (pt.x < minX) {
+        minX = pt.x;
+      }
+      if (pt.x > maxX) {
+        maxX = pt.x;
+      }
+      if (pt.y < minY) {
+        minY = pt.y;
+      }
+      if (pt.y > maxY) {
+        maxY = pt.y;
+      }
+    }
+  }
+
+  if (maxX < 0) {
+    std::fill(temMod.begin(), temMod.end(), 0.0f);
+    elevCorrInitialized = true;
+    return;
+  }
+
+  long width = maxX - minX + 1;
+  std::vector<float> minElevByPixel(width * (maxY - minY + 1), HUGE_VALF);
+  for (size_t i = 0; i < numNodes; i++) {
+    if (pixelX[i] >= 0) {
+      GridNode *node = &(nodes->at(i));
       float elev = g_DEM->data[node->y][node->x];
-      std::map<long long, float>::iterator it = minElevByPixel.find(key);
-      if (it == minElevByPixel.end()) {
-        minElevByPixel.insert(std::make_pair(key, elev));
-      } else if (elev < it->second) {
-        it->second = elev;
+      float *minElev =
+          &(minElevByPixel[(pixelY[i] - minY) * width + pixelX[i] - minX]);
+      if (elev < *minElev) {
+        *minElev = elev;
       }
     }
   }
 
   // Build per-node temperature modifier: -0.0065 * (elev - minElev(pixel))
-  for (size_t i = 0; i < nodes->size(); i++) {
-    GridNode *node = &(nodes->at(i));
-    if (tempGrid->GetGridLoc(node->refLoc.x, node->refLoc.y, &pt)) {
-      long long key = (((long long)pt.y) << 32) | (unsigned long)pt.x;
+  for (size_t i = 0; i < numNodes; i++) {
+    if (pixelX[i] >= 0) {
+      GridNode *node = &(nodes->at(i));
       float elev = g_DEM->data[node->y][node->x];
-      std::map<long long, float>::iterator it = minElevByPixel.find(key);
-      if (it != minElevByPixel.end()) {
-        float baseElev = it->second;
-        float diffHeight = elev - baseElev; // meters
-        temMod[i] = -0.0065f * diffHeight;
-      } else {
-        temMod[i] = 0.0f;
-      }
+      float baseElev =
+          minElevByPixel[(pixelY[i] - minY) * width + pixelX[i] - minX];
+      float diffHeight = elev - baseElev; // meters
+      temMod[i] = -0.0065f * diffHeight;
     } else {
       temMod[i] = 0.0f;
     }
@@ -93,16 +117,16 @@ bool TempReader::Read(char *file, SUPPORTED_TEMP_TYPES type,
 
   switch (type) {
   case TEMP_ASCII:
-    tempGrid = ReadFloatAscGrid(file);
+    tempGrid = ReadFloatAscGrid(file, &gridPool);
     break;
   case TEMP_TIF:
-    tempGrid = ReadFloatTifGrid(file);
+    tempGrid = ReadFloatTifGrid(file, &gridPool);
     break;
   case TEMP_BIF:
-    tempGrid = ReadFloatBifGrid(file);
+    tempGrid = ReadFloatBifGrid(file, &gridPool);
     break;
   case TEMP_PQF:
-    tempGrid = ReadFloatPqfGrid(file);
+    tempGrid = ReadFloatPqfGrid(file, &gridPool);
     break;
   default:
     ERROR_LOG("Unsupported Temp format!");
@@ -183,7 +207,7 @@ bool TempReader::Read(char *file, SUPPORTED_TEMP_TYPES type,
   }
 
   // We don't actually need to keep the PET grid in memory anymore
-  delete tempGrid;
+  gridPool.Release(tempGrid);
 
   return true;
 }
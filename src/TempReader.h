@@ -3,6 +3,7 @@
 
 #include "BasicGrids.h"
 #include "Defines.h"
+#include "GridPool.h"
 #include "TempType.h"
 #include <vector>
 
@@ -21,9 +22,11 @@ public:
   void SetElevCorr(bool on) { elevCorr = on; }
   bool SaveElevCorrState(TimeVar *currentTime, char *statePath, GridWriterFull *gridWriter,
                          std::vector<GridNode> *nodes);
+  GridPool *GetGridPool() { return &gridPool; }
 
 private:
   char lastTempFile[CONFIG_MAX_LEN * 2];
+  GridPool gridPool;
   FloatGrid *tempDEM;
   bool elevCorr;
   bool elevCorrInitialized;
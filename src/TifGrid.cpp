@@ -20,18 +20,25 @@ static TIFFExtendProc TIFFParentExtender = NULL;
 static void TIFFExtenderInit();
 static void TIFFDefaultDirectory(TIFF *tif);
 
+// Grids may be read from several threads at once; installing the extender
+// twice would make it its own parent. XTIFFOpen sets up the GeoTIFF tags
+// unguarded on its first call, so that is done here too, before any open.
 static void TIFFExtenderInit() {
   static int first_time = 1;
 
-  if (!first_time) {
-    return; /* Been there. Done that. */
-  }
-  first_time = 0;
+#pragma omp critical(tiff_extender_init)
+  {
+    if (first_time) {
+      first_time = 0;
+
+      /* Grab the inherited method and install */
+      TIFFParentExtender = TIFFSetTagExtender(TIFFDefaultDirectory);
 
-  /* Grab the inherited method and install */
-  TIFFParentExtender = TIFFSetTagExtender(TIFFDefaultDirectory);
+      TIFFSetErrorHandler(NULL);
 
-  TIFFSetErrorHandler(NULL);
+      XTIFFInitialize();
+    }
+  }
 }
 
 static void TIFFDefaultDirectory(TIFF *tif) {
@@ -53,11 +60,11 @@ FloatGrid *ReadFloatTifGrid(const char *file) {
   return ReadFloatTifGrid(file, NULL);
 }
 
-FloatGrid *ReadFloatTifGrid(const char *file, FloatGrid *incGrid) {
+FloatGrid *ReadFloatTifGrid(const char *file, GridPool *pool) {
 
   TIFFExtenderInit();
 
-  FloatGrid *grid = incGrid;
+  FloatGrid *grid = NULL;
   TIFF *tif = NULL;
   GTIF *gtif = NULL;
 
@@ -102,33 +109,14 @@ FloatGrid *ReadFloatTifGrid(const char *file, FloatGrid *incGrid) {
   TIFFGetField(tif, TIFFTAG_GEOTIEPOINTS, &tiepointsize, &tiepoints);
   TIFFGetField(tif, TIFFTAG_GEOPIXELSCALE, &pixscalesize, &pixscale);
 
-  if (!grid || grid->numCols != width || grid->numRows != height) {
-    if (grid) {
-      delete grid;
-    }
-    grid = new FloatGrid();
-    grid->numCols = width;
-    grid->numRows = height;
-    grid->data = new float *[grid->numRows]();
-    if (!grid->data) {
-      WARNING_LOGF("TIF file %s too large (out of memory) with %li rows", file,
-                   grid->numRows);
-      delete grid;
-      GTIFFree(gtif);
-      XTIFFClose(tif);
-      return NULL;
-    }
-    for (long i = 0; i < grid->numRows; i++) {
-      grid->data[i] = new float[grid->numCols]();
-      if (!grid->data[i]) {
-        WARNING_LOGF("TIF file %s too large (out of memory) with %li columns",
-                     file, grid->numCols);
-        delete grid;
-        GTIFFree(gtif);
-        XTIFFClose(tif);
-        return NULL;
-      }
-    }
+  grid = NewFloatGrid(pool, width, height);
+  if (!grid) {
+    WARNING_LOGF("TIF file %s too large (out of memory) with %i rows and "
+                 "%i columns",
+                 file, height, width);
+    GTIFFree(gtif);
+    XTIFFClose(tif);
+    return NULL;
   }
 
   char *noData = NULL;
@@ -255,7 +243,7 @@ LongGrid *ReadLongTifGrid(const char *file) {
   TIFF *tif = NULL;
   GTIF *gtif = NULL;
 
-  TIFFSetErrorHandler(NULL);
+  TIFFExtenderInit();
 
   tif = XTIFFOpen(file, "r");
   if (!tif) {
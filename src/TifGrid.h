@@ -2,9 +2,10 @@
 #define TIF_GRID_H
 
 #include "Grid.h"
+#include "GridPool.h"
 
 FloatGrid *ReadFloatTifGrid(const char *file);
-FloatGrid *ReadFloatTifGrid(const char *file, FloatGrid *incGrid);
+FloatGrid *ReadFloatTifGrid(const char *file, GridPool *pool);
 void WriteFloatTifGrid(const char *file, FloatGrid *grid,
                        const char *artist = NULL, const char *datetime = NULL,
                        const char *copyright = NULL);
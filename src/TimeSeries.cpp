@@ -84,3 +84,24 @@ float TimeSeries::GetValueNearTime(TimeVar *wantTime, time_t diff) {
 
   return std::numeric_limits<float>::quiet_NaN();
 }
+
+// The points are in time order, as GetValueAtTime also assumes, so one pass
+// over both lists lines them up
+void TimeSeries::AlignToSteps(const std::vector<time_t> &stepTimes,
+                              std::vector<float> *values,
+                              std::vector<unsigned char> *present) {
+  values->assign(stepTimes.size(), std::numeric_limits<float>::quiet_NaN());
+  present->assign(stepTimes.size(), 0);
+  size_t pt = 0;
+  for (size_t i = 0; i < stepTimes.size(); i++) {
+    while (pt < timeSeries.size() &&
+           timeSeries[pt]->time.currentTimeSec < stepTimes[i]) {
+      pt++;
+    }
+    if (pt < timeSeries.size() &&
+        timeSeries[pt]->time.currentTimeSec == stepTimes[i]) {
+      (*values)[i] = timeSeries[pt]->value;
+      (*present)[i] = 1;
+    }
+  }
+}
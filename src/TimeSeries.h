@@ -17,6 +17,10 @@ public:
   void PutValueAtTime(char *timeBuffer, float dataValue);
   float GetValueAtTime(TimeVar *wantTime);
   float GetValueNearTime(TimeVar *wantTime, time_t diff);
+  // Looks up every simulation step once, present is 0 where there is no obs
+  void AlignToSteps(const std::vector<time_t> &stepTimes,
+                    std::vector<float> *values,
+                    std::vector<unsigned char> *present);
   size_t GetNumberOfObs() { return timeSeries.size(); }
 
 private:
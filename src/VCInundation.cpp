@@ -1,13 +1,39 @@
 #include "VCInundation.h"
+#include "BasicConfigSection.h"
+#include "CacheHash.h"
 #include "DatedName.h"
+#include "Messages.h"
 #include <algorithm>
 #include <cmath>
 #include <cstdio>
 #include <cstring>
-#include <stack>
+#include <limits>
+#if _OPENMP
+#include <omp.h>
+#endif
 
-static bool TestUpstream(long nextX, long nextY, FLOW_DIR dir, GridLoc *loc);
-static bool SortByHeight(GridNode *d1, GridNode *d2);
+#define VCI_CACHE_MAGIC 0x56434931 // "VCI1"
+
+// Channel nodes handed to a thread at a time while building the layers
+#define VCI_LAYER_BLOCK 256
+
+// Orders hillslope cells by elevation, ties by node index
+struct VCIHeightOrder {
+  const float *elevation;
+  bool operator()(unsigned long n1, unsigned long n2) const {
+    if (elevation[n1] == elevation[n2]) {
+      return n1 < n2;
+    }
+    return elevation[n1] < elevation[n2];
+  }
+};
+
+// The layers of one run of channel nodes, built by one thread
+struct VCILayerBlock {
+  std::vector<unsigned long> numLayers, numGrids;
+  std::vector<float> volume, area, height;
+  std::vector<unsigned long> to, grids;
+};
 
 VCInundation::VCInundation() {}
 
@@ -22,136 +48,356 @@ bool VCInundation::InitializeModel(
   if (iNodes.size() != nodes->size()) {
     iNodes.resize(nodes->size());
   }
+  if (!nodeIndex) {
+    ownNodeIndex.Build(nodes);
+    nodeIndex = &ownNodeIndex;
+  }
 
   // Fill in modelIndex in the gridNodes
   size_t numNodes = nodes->size();
   for (size_t i = 0; i < numNodes; i++) {
-    GridNode *node = &nodes->at(i);
-    node->modelIndex = i;
-    if (node->channelGridCell) {
-      ComputeLayers(i, node, &(iNodes[i]));
+    nodes->at(i).modelIndex = i;
+  }
+
+  // The layers only depend on the basin, so with TOPOCACHE set they are
+  // stored next to the topology and reused while it stays the same
+  char *cacheDir = g_basicConfig->GetTopoCache();
+  char cacheFile[CONFIG_MAX_LEN * 2];
+  unsigned long long key = 0;
+  bool loaded = false;
+  if (cacheDir[0]) {
+    key = LayerKey();
+    sprintf(cacheFile, "%s/vcilayers.%016llx.bin", cacheDir, key);
+    loaded = LoadLayers(cacheFile, key);
+  }
+  if (!loaded) {
+    BuildLayers();
+    if (cacheDir[0]) {
+      SaveLayers(cacheFile, key);
     }
   }
+  nodeDepth.clear();
 
   InitializeParameters(paramSettings, paramGrids);
 
   return true;
 }
 
-void VCInundation::ComputeLayers(size_t nodeIndex, GridNode *node,
-                                 VCInundationGridNode *cNode) {
-  std::vector<GridNode *> upstreamNodes;
-  std::stack<GridNode *> walkNodes;
-
-  walkNodes.push(node);
+// Each channel node floods the non-channel cells that drain into it. Those
+// hillslopes do not overlap, so the channel nodes are done in parallel
+// blocks which are then appended in node order.
+void VCInundation::BuildLayers() {
+  size_t numNodes = nodes->size();
+  std::vector<float> elevation(numNodes);
+  for (size_t i = 0; i < numNodes; i++) {
+    GridNode *node = &nodes->at(i);
+    elevation[i] = g_DEM->data[node->y][node->x];
+  }
+  VCIHeightOrder order;
+  order.elevation = numNodes ? &(elevation[0]) : NULL;
 
-  while (!walkNodes.empty()) {
+  long numBlocks = (long)((numNodes + VCI_LAYER_BLOCK - 1) / VCI_LAYER_BLOCK);
+  std::vector<VCILayerBlock> blocks(numBlocks);
 
-    // Get the next node to check off the stack
-    GridNode *currentN = walkNodes.top();
-    walkNodes.pop();
+#if _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+  for (long b = 0; b < numBlocks; b++) {
+    VCILayerBlock *block = &(blocks[b]);
+    size_t first = b * VCI_LAYER_BLOCK;
+    size_t last = std::min(first + VCI_LAYER_BLOCK, numNodes);
+    block->numLayers.assign(last - first, 0);
+    block->numGrids.assign(last - first, 0);
+    std::vector<unsigned long> walkNodes, upstreamNodes;
 
-    upstreamNodes.push_back(currentN);
+    for (size_t n = first; n < last; n++) {
+      if (!nodes->at(n).channelGridCell) {
+        continue;
+      }
 
-    // Lets figure out what flows into this node
-    for (int i = 1; i < FLOW_QTY; i++) {
-      GridLoc nextNode;
-      if (TestUpstream(currentN->x, currentN->y, (FLOW_DIR)i, &nextNode)) {
-        GridNode *nextN = NULL;
-        for (size_t nodeI = currentN->index; nodeI < nodes->size(); nodeI++) {
-          if (nodes->at(nodeI).x == nextNode.x &&
-              nodes->at(nodeI).y == nextNode.y) {
-            nextN = &nodes->at(nodeI);
-            break;
+      upstreamNodes.clear();
+      walkNodes.push_back(n);
+      while (!walkNodes.empty()) {
+        unsigned long current = walkNodes.back();
+        walkNodes.pop_back();
+        upstreamNodes.push_back(current);
+        unsigned long numUp = nodeIndex->GetNumUpstream(current);
+        const unsigned long *up = nodeIndex->GetUpstream(current);
+        for (unsigned long u = 0; u < numUp; u++) {
+          if (!nodes->at(up[u]).channelGridCell) {
+            walkNodes.push_back(up[u]);
           }
         }
-        if (nextN && !nextN->channelGridCell) {
-          walkNodes.push(nextN);
+      }
+
+      std::sort(upstreamNodes.begin(), upstreamNodes.end(), order);
+
+      size_t numLayers = block->volume.size();
+      int upstreamCount = (int)(upstreamNodes.size()) - 1;
+      for (int i = 0; i < upstreamCount; i++) {
+        GridNode *current = &nodes->at(upstreamNodes[i]);
+        float heightDiff =
+            elevation[upstreamNodes[i + 1]] - elevation[upstreamNodes[i]];
+        if (heightDiff <= 0.01) {
+          continue;
         }
+        float layerVolume = current->area * (i + 1) * heightDiff * 1000000.0;
+        block->volume.push_back(layerVolume);
+        block->area.push_back(current->area * (i + 1) * 1000000.0);
+        block->height.push_back(heightDiff);
+        block->to.push_back(i + 1);
       }
+
+      GridNode *lowest = &nodes->at(upstreamNodes[0]);
+      float layerVolume =
+          lowest->area * (upstreamNodes.size()) * 1000.0 * 1000000.0;
+      block->volume.push_back(layerVolume);
+      block->area.push_back(lowest->area * (upstreamNodes.size()) * 1000000.0);
+      block->height.push_back(1000.0);
+      block->to.push_back(upstreamNodes.size());
+      block->grids.insert(block->grids.end(), upstreamNodes.begin(),
+                          upstreamNodes.end());
+
+      block->numLayers[n - first] = block->volume.size() - numLayers;
+      block->numGrids[n - first] = upstreamNodes.size();
     }
   }
 
-  std::sort(upstreamNodes.begin(), upstreamNodes.end(), SortByHeight);
-
-  int upstreamCount = (int)(upstreamNodes.size()) - 1;
-  // printf("Found %i upstream cells for node %i, FAM is %f\n", upstreamCount,
-  // (int)nodeIndex, g_FAM->data[node->y][node->x]);
-  cNode->layers.reserve(upstreamNodes.size());
-  for (int i = 0; i < upstreamCount; i++) {
-    GridNode *current = upstreamNodes[i];
-    GridNode *up = upstreamNodes[i + 1];
-    if (nodeIndex == 54) {
-      printf("%i, %f\n", i, g_DEM->data[current->y][current->x]);
+  layerStart.assign(numNodes + 1, 0);
+  gridStart.assign(numNodes + 1, 0);
+  layerVolume.clear();
+  layerArea.clear();
+  layerHeight.clear();
+  layerTo.clear();
+  gridIndices.clear();
+  for (long b = 0; b < numBlocks; b++) {
+    VCILayerBlock *block = &(blocks[b]);
+    size_t first = b * VCI_LAYER_BLOCK;
+    for (size_t n = 0; n < block->numLayers.size(); n++) {
+      layerStart[first + n + 1] = layerStart[first + n] + block->numLayers[n];
+      gridStart[first + n + 1] = gridStart[first + n] + block->numGrids[n];
     }
-    float heightDiff =
-        g_DEM->data[up->y][up->x] - g_DEM->data[current->y][current->x];
-    if (heightDiff <= 0.01) {
-      continue;
-      // heightDiff = 0.01;
-    }
-    float layerVolume = current->area * (i + 1) * heightDiff * 1000000.0;
-    VCILayer *layer = new VCILayer;
-    layer->totalVolume = layerVolume;
-    layer->totalArea = current->area * (i + 1) * 1000000.0;
-    layer->height = heightDiff;
-    layer->toIndex = i + 1;
-    cNode->layers.push_back(layer);
+    layerVolume.insert(layerVolume.end(), block->volume.begin(),
+                       block->volume.end());
+    layerArea.insert(layerArea.end(), block->area.begin(), block->area.end());
+    layerHeight.insert(layerHeight.end(), block->height.begin(),
+                       block->height.end());
+    layerTo.insert(layerTo.end(), block->to.begin(), block->to.end());
+    gridIndices.insert(gridIndices.end(), block->grids.begin(),
+                       block->grids.end());
+    // Give the block's memory back as soon as it is copied
+    *block = VCILayerBlock();
+  }
+}
+
+// Covers everything the layers are built from: the carved network, the
+// channel cells and the elevations
+unsigned long long VCInundation::LayerKey() {
+  unsigned long long hash = CACHE_HASH_BASIS;
+  size_t numNodes = nodes->size();
+  HashBytes(&hash, &numNodes, sizeof(numNodes));
+  for (size_t i = 0; i < numNodes; i++) {
+    GridNode *node = &nodes->at(i);
+    HashBytes(&hash, &(node->x), sizeof(node->x));
+    HashBytes(&hash, &(node->y), sizeof(node->y));
+    HashBytes(&hash, &(node->downStreamNode), sizeof(node->downStreamNode));
+    HashBytes(&hash, &(node->area), sizeof(node->area));
+    HashBytes(&hash, &(g_DEM->data[node->y][node->x]), sizeof(float));
+    unsigned char channel = node->channelGridCell ? 1 : 0;
+    HashBytes(&hash, &channel, sizeof(channel));
+  }
+  return hash;
+}
+
+bool VCInundation::SaveLayers(const char *file, unsigned long long key) {
+  char tmpFile[CONFIG_MAX_LEN * 2];
+  sprintf(tmpFile, "%s.tmp", file);
+  FILE *fp = fopen(tmpFile, "wb");
+  if (!fp) {
+    WARNING_LOGF("Failed to write inundation layer cache %s", tmpFile);
+    return false;
+  }
+
+  int magic = VCI_CACHE_MAGIC;
+  unsigned long counts[3] = {(unsigned long)nodes->size(),
+                             (unsigned long)layerVolume.size(),
+                             (unsigned long)gridIndices.size()};
+  bool ok = (fwrite(&magic, sizeof(int), 1, fp) == 1 &&
+             fwrite(&key, sizeof(key), 1, fp) == 1 &&
+             fwrite(counts, sizeof(unsigned long), 3, fp) == 3 &&
+             fwrite(&(layerStart[0]), sizeof(unsigned long), counts[0] + 1,
+                    fp) == counts[0] + 1 &&
+             fwrite(&(gridStart[0]), sizeof(unsigned long), counts[0] + 1,
+                    fp) == counts[0] + 1);
+  if (ok && counts[1] > 0) {
+    ok = (fwrite(&(layerVolume[0]), sizeof(float), counts[1], fp) ==
+              counts[1] &&
+          fwrite(&(layerArea[0]), sizeof(float), counts[1], fp) == counts[1] &&
+          fwrite(&(layerHeight[0]), sizeof(float), counts[1], fp) ==
+              counts[1] &&
+          fwrite(&(layerTo[0]), sizeof(unsigned long), counts[1], fp) ==
+              counts[1]);
+  }
+  if (ok && counts[2] > 0) {
+    ok = (fwrite(&(gridIndices[0]), sizeof(unsigned long), counts[2], fp) ==
+          counts[2]);
+  }
+
+  if (fclose(fp) != 0 || !ok) {
+    WARNING_LOGF("Failed to write inundation layer cache %s", tmpFile);
+    remove(tmpFile);
+    return false;
+  }
+#ifdef _WIN32
+  // rename does not replace an existing file on Windows
+  remove(file);
+#endif
+  if (rename(tmpFile, file) != 0) {
+    WARNING_LOGF("Failed to move inundation layer cache into place at %s",
+                 file);
+    remove(tmpFile);
+    return false;
+  }
+  INFO_LOGF("Saved inundation layers (%lu layers) to %s", counts[1], file);
+  return true;
+}
+
+// Returns false, leaving the tables untouched, if the file is missing, stale
+// or unreadable
+bool VCInundation::LoadLayers(const char *file, unsigned long long key) {
+  FILE *fp = fopen(file, "rb");
+  if (!fp) {
+    return false;
+  }
+
+  int magic;
+  unsigned long long fileKey;
+  unsigned long counts[3];
+  if (fread(&magic, sizeof(int), 1, fp) != 1 || magic != VCI_CACHE_MAGIC ||
+      fread(&fileKey, sizeof(fileKey), 1, fp) != 1 || fileKey != key ||
+      fread(counts, sizeof(unsigned long), 3, fp) != 3 ||
+      counts[0] != nodes->size()) {
+    fclose(fp);
+    return false;
   }
 
-  float layerVolume =
-      upstreamNodes[0]->area * (upstreamNodes.size()) * 1000.0 * 1000000.0;
-  VCILayer *layer = new VCILayer;
-  layer->totalVolume = layerVolume;
-  layer->totalArea =
-      upstreamNodes[0]->area * (upstreamNodes.size()) * 1000000.0;
-  layer->height = 1000.0;
-  layer->toIndex = upstreamNodes.size();
-  upstreamCount = (int)(upstreamNodes.size());
-  cNode->gridIndicies.reserve(upstreamCount);
-  for (int gi = 0; gi < upstreamCount; gi++) {
-    cNode->gridIndicies.push_back(upstreamNodes[gi]->index);
+  std::vector<unsigned long> newLayerStart(counts[0] + 1),
+      newGridStart(counts[0] + 1), newLayerTo(counts[1]),
+      newGridIndices(counts[2]);
+  std::vector<float> newVolume(counts[1]), newArea(counts[1]),
+      newHeight(counts[1]);
+  bool ok = (fread(&(newLayerStart[0]), sizeof(unsigned long), counts[0] + 1,
+                   fp) == counts[0] + 1 &&
+             fread(&(newGridStart[0]), sizeof(unsigned long), counts[0] + 1,
+                   fp) == counts[0] + 1);
+  if (ok && counts[1] > 0) {
+    ok = (fread(&(newVolume[0]), sizeof(float), counts[1], fp) == counts[1] &&
+          fread(&(newArea[0]), sizeof(float), counts[1], fp) == counts[1] &&
+          fread(&(newHeight[0]), sizeof(float), counts[1], fp) == counts[1] &&
+          fread(&(newLayerTo[0]), sizeof(unsigned long), counts[1], fp) ==
+              counts[1]);
   }
-  cNode->layers.push_back(layer);
+  if (ok && counts[2] > 0) {
+    ok = (fread(&(newGridIndices[0]), sizeof(unsigned long), counts[2], fp) ==
+          counts[2]);
+  }
+  fclose(fp);
+  ok = ok && newLayerStart[counts[0]] == counts[1] &&
+       newGridStart[counts[0]] == counts[2];
+  for (unsigned long i = 0; ok && i < counts[2]; i++) {
+    ok = (newGridIndices[i] < counts[0]);
+  }
+  if (!ok) {
+    WARNING_LOGF("Ignoring unreadable inundation layer cache %s", file);
+    return false;
+  }
+
+  layerStart.swap(newLayerStart);
+  gridStart.swap(newGridStart);
+  layerVolume.swap(newVolume);
+  layerArea.swap(newArea);
+  layerHeight.swap(newHeight);
+  layerTo.swap(newLayerTo);
+  gridIndices.swap(newGridIndices);
+  INFO_LOGF("Loaded inundation layers (%lu layers) from %s", counts[1], file);
+  return true;
 }
 
+// A hillslope cell drains to exactly one channel node, so every channel
+// node writes only its own cells and they are filled in parallel without a
+// reduction. Channel nodes whose discharge is within the tolerance of the
+// one their depths were computed for keep them.
 bool VCInundation::Inundation(std::vector<float> *discharge,
                               std::vector<float> *depth) {
 
-  size_t numNodes = nodes->size();
-
-  for (size_t i = 0; i < numNodes; i++) {
-    depth->at(i) = 0.0;
+  long numNodes = (long)nodes->size();
+  if ((long)nodeDepth.size() != numNodes) {
+    nodeDepth.assign(numNodes, 0.0);
+    depthDischarge.assign(numNodes, std::numeric_limits<float>::quiet_NaN());
+    layerFill.assign(layerVolume.size(), 0.0);
   }
 
-  for (size_t i = 0; i < numNodes; i++) {
-    GridNode *node = &nodes->at(i);
-    if (node->channelGridCell) {
-      VCInundationGridNode *cNode = &(iNodes[i]);
-      float dischargeLeft = discharge->at(i) * node->horLen;
-      int layerCount = (int)(cNode->layers.size());
-      for (int layerI = 0; layerI < layerCount; layerI++) {
-        VCILayer *layer = cNode->layers[layerI];
-        float volumeUsed = 0.0;
-        if (dischargeLeft >= layer->totalVolume) {
-          volumeUsed = layer->totalVolume;
-          dischargeLeft -= layer->totalVolume;
-        } else {
-          volumeUsed = dischargeLeft;
-          dischargeLeft = 0.0;
-        }
-        float height = volumeUsed / layer->totalArea;
-        int gridCount = (int)(layer->toIndex);
-        for (int gi = 0; gi < gridCount; gi++) {
-          depth->at(cNode->gridIndicies[gi]) += height;
-        }
-      }
+#if _OPENMP
+#pragma omp parallel for schedule(dynamic, VCI_LAYER_BLOCK)
+#endif
+  for (long i = 0; i < numNodes; i++) {
+    if (!nodes->at(i).channelGridCell) {
+      continue;
     }
+    float nodeDischarge = discharge->at(i);
+    // Never true for the first call, the last discharge is still NaN
+    if (fabsf(nodeDischarge - depthDischarge[i]) <=
+        dischargeTolerance * fabsf(depthDischarge[i])) {
+      continue;
+    }
+    depthDischarge[i] = nodeDischarge;
+    FillLayers(i, nodeDischarge);
   }
 
+  std::copy(nodeDepth.begin(), nodeDepth.end(), depth->begin());
+
   return true;
 }
 
+// Pours the discharge into the layers from the bottom up, then gives each of
+// the node's cells the summed height of the wet layers that cover it
+void VCInundation::FillLayers(size_t nodeNum, float discharge) {
+  unsigned long firstLayer = layerStart[nodeNum];
+  unsigned long endLayer = layerStart[nodeNum + 1];
+  float dischargeLeft = discharge * nodes->at(nodeNum).horLen;
+  unsigned long wetEnd = firstLayer;
+  for (unsigned long layerI = firstLayer; layerI < endLayer; layerI++) {
+    float volumeUsed = 0.0;
+    if (dischargeLeft >= layerVolume[layerI]) {
+      volumeUsed = layerVolume[layerI];
+      dischargeLeft -= layerVolume[layerI];
+    } else {
+      volumeUsed = dischargeLeft;
+      dischargeLeft = 0.0;
+    }
+    layerFill[layerI] = volumeUsed / layerArea[layerI];
+    if (volumeUsed != 0.0) {
+      wetEnd = layerI + 1;
+    }
+  }
+
+  // layerTo grows from layer to layer, so the layers covering a cell are
+  // always the ones from some first layer on
+  unsigned long numGrids = gridStart[nodeNum + 1] - gridStart[nodeNum];
+  const unsigned long *grids = &(gridIndices[gridStart[nodeNum]]);
+  unsigned long coverLayer = firstLayer;
+  for (unsigned long gi = 0; gi < numGrids; gi++) {
+    while (layerTo[coverLayer] <= gi) {
+      coverLayer++;
+    }
+    float height = 0.0;
+    for (unsigned long layerI = coverLayer; layerI < wetEnd; layerI++) {
+      height += layerFill[layerI];
+    }
+    nodeDepth[grids[gi]] = height;
+  }
+}
+
 void VCInundation::InitializeParameters(
     std::map<GaugeConfigSection *, float *> *paramSettings,
     std::vector<FloatGrid *> *paramGrids) {
@@ -191,68 +437,3 @@ void VCInundation::InitializeParameters(
     }
   }
 }
-
-bool SortByHeight(GridNode *d1, GridNode *d2) {
-  if (g_DEM->data[d1->y][d1->x] == g_DEM->data[d2->y][d2->x]) {
-    return d1->index < d2->index;
-  }
-  return g_DEM->data[d1->y][d1->x] < g_DEM->data[d2->y][d2->x];
-}
-
-bool TestUpstream(long nextX, long nextY, FLOW_DIR dir, GridLoc *loc) {
-  FLOW_DIR wantDir;
-
-  // unsigned long currentFAC = g_FAM->data[nextY][nextX];
-
-  switch (dir) {
-  case FLOW_NORTH:
-    nextY--;
-    wantDir = FLOW_SOUTH;
-    break;
-  case FLOW_NORTHEAST:
-    nextY--;
-    nextX++;
-    wantDir = FLOW_SOUTHWEST;
-    break;
-  case FLOW_EAST:
-    nextX++;
-    wantDir = FLOW_WEST;
-    break;
-  case FLOW_SOUTHEAST:
-    nextY++;
-    nextX++;
-    wantDir = FLOW_NORTHWEST;
-    break;
-  case FLOW_SOUTH:
-    nextY++;
-    wantDir = FLOW_NORTH;
-    break;
-  case FLOW_SOUTHWEST:
-    nextY++;
-    nextX--;
-    wantDir = FLOW_NORTHEAST;
-    break;
-  case FLOW_WEST:
-    nextX--;
-    wantDir = FLOW_EAST;
-    break;
-  case FLOW_NORTHWEST:
-    nextX--;
-    nextY--;
-    wantDir = FLOW_SOUTHEAST;
-    break;
-  default:
-    return false;
-  }
-
-  if (nextX >= 0 && nextY >= 0 && nextX < g_DDM->numCols &&
-      nextY < g_DDM->numRows &&
-      g_DDM->data[nextY][nextX] ==
-          wantDir) { // && g_FAM->data[nextY][nextX] <= currentFAC) {
-    loc->x = nextX;
-    loc->y = nextY;
-    return true;
-  }
-
-  return false;
-}
@@ -3,17 +3,8 @@
 
 #include "ModelBase.h"
 
-struct VCILayer {
-  float totalVolume;
-  float totalArea;
-  float height;
-  size_t toIndex;
-};
-
 struct VCInundationGridNode : BasicGridNode {
   float params[PARAM_VCI_QTY];
-  std::vector<long> gridIndicies;
-  std::vector<VCILayer *> layers;
 };
 
 class VCInundation : public InundationModel {
@@ -31,11 +22,27 @@ private:
   void
   InitializeParameters(std::map<GaugeConfigSection *, float *> *paramSettings,
                        std::vector<FloatGrid *> *paramGrids);
-  void ComputeLayers(size_t nodeIndex, GridNode *node,
-                     VCInundationGridNode *cNode);
+  void BuildLayers();
+  void FillLayers(size_t nodeNum, float discharge);
+  unsigned long long LayerKey();
+  bool SaveLayers(const char *file, unsigned long long key);
+  bool LoadLayers(const char *file, unsigned long long key);
 
   std::vector<GridNode> *nodes;
   std::vector<VCInundationGridNode> iNodes;
+  NodeIndex ownNodeIndex;
+
+  // The layers of channel node i are layerStart[i] up to layerStart[i + 1] - 1
+  // and fill its hillslope cells from the bottom up. The cells are
+  // gridIndices[gridStart[i]] onwards sorted by elevation, a layer covers the
+  // first layerTo of them. Non-channel nodes have no layers.
+  std::vector<unsigned long> layerStart, gridStart;
+  std::vector<float> layerVolume, layerArea, layerHeight;
+  std::vector<unsigned long> layerTo, gridIndices;
+
+  // What the last Inundation call left: the depth of every node, the
+  // discharge each channel node's depths are for and the water in each layer
+  std::vector<float> nodeDepth, depthDischarge, layerFill;
 };
 
 #endif
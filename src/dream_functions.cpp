@@ -9,9 +9,9 @@
 #include <cstring>
 
 #ifdef WIN32
-#define UNIFORM_RAND ((float)(rand()) / (float)(RAND_MAX))
+#define UNIFORM_RAND(rng) ((float)(rand()) / (float)(RAND_MAX))
 #else
-#define UNIFORM_RAND (drand48())
+#define UNIFORM_RAND(rng) (erand48(rng))
 #endif
 
 void InitVar(struct DREAM_Parameters *pstPar, struct DREAM_Variables **pstRUN,
@@ -122,7 +122,8 @@ void GenCR(struct DREAM_Parameters **ppPar, float ***pppCR, float ****ptCR) {
   ptL = &L[0];
   ptr = &r[0];
   // How many candidate points for each crossover value?
-  multrnd(&ptL, (*ppPar)->seq * (*ppPar)->steps, pppCR, (*ppPar)->nCR, 1);
+  multrnd(&ptL, (*ppPar)->seq * (*ppPar)->steps, pppCR, (*ppPar)->nCR, 1,
+          (*ppPar)->rng);
   sumL = 0;
   for (i = 0; i < ((*ppPar)->nCR + 1); i++) {
     if (i != 0) {
@@ -132,7 +133,7 @@ void GenCR(struct DREAM_Parameters **ppPar, float ***pppCR, float ****ptCR) {
     L2[i] = sumL;
   }
   // Then select which candidate points are selected with what CR
-  randperm(&ptr, (*ppPar)->seq * (*ppPar)->steps);
+  randperm(&ptr, (*ppPar)->seq * (*ppPar)->steps, (*ppPar)->rng);
   // Then generate CR values for each chain
   for (zz = 0; zz < (*ppPar)->nCR; zz++) {
     i_start = L2[zz];
@@ -155,7 +156,8 @@ void GenCR(struct DREAM_Parameters **ppPar, float ***pppCR, float ****ptCR) {
   }
 }
 
-void multrnd(int **X, int n, float ***p, int ncols, int m) {
+void multrnd(int **X, int n, float ***p, int ncols, int m,
+             unsigned short *rng) {
   // MULTRND Multinomial random sequence of m simulations of k outcomes with p
   // probabiltites
   // in n trials.
@@ -167,8 +169,8 @@ void multrnd(int **X, int n, float ***p, int ncols, int m) {
   for (i = 0; i < m; i++) {
     for (in = 0; in < n; in++) {
       o[in] = 1;            // assign 1 to every element of array o
-      r[in] = UNIFORM_RAND; // generate Uniformly distributed pseudorandom
-                            // numbers [0 1)
+      r[in] = UNIFORM_RAND(rng); // generate Uniformly distributed
+                                 // pseudorandom numbers [0 1)
     }
     // cumulative sum
     for (in = 0; in < ncols; in++) {
@@ -199,20 +201,21 @@ void multrnd(int **X, int n, float ***p, int ncols, int m) {
   }
 }
 
-void LHSU(float ***s, int nvar, float *xmax, float *xmin, int nsample) {
+void LHSU(float ***s, int nvar, float *xmax, float *xmin, int nsample,
+          unsigned short *rng) {
   int i, j, *pidx, idx[nsample];
   float P[nsample], ran[nsample][nvar];
   float nsamplef = (float)(nsample);
   // Initialize array ran with random numbers
   for (i = 0; i < nsample; i++) {
     for (j = 0; j < nvar; j++) {
-      ran[i][j] = UNIFORM_RAND;
+      ran[i][j] = UNIFORM_RAND(rng);
     }
   }
   // Now fill s
   pidx = &idx[0];
   for (j = 0; j < nvar; j++) {
-    randperm(&pidx, nsample);
+    randperm(&pidx, nsample, rng);
     for (i = 0; i < nsample; i++) {
       P[i] = ((float)(idx[i]) - ran[i][j]) / nsamplef;
       (*s)[i][j] = xmin[j] + P[i] * (xmax[j] - xmin[j]);
@@ -365,7 +368,7 @@ void DEStrategy(int *DEversion, struct DREAM_Parameters *MCMCPar) {
   Z = (float *)malloc(MCMCPar->seq * sizeof(float));
   MEMORYCHECK(Z, "ERROR at DEStrategy: Out of Memory!! Z not allocated.\n");
   for (i = 0; i < MCMCPar->seq; i++) {
-    Z[i] = UNIFORM_RAND;
+    Z[i] = UNIFORM_RAND(MCMCPar->rng);
   }
   // Select number of pairs
   for (qq = 0; qq < MCMCPar->seq; qq++) {
@@ -398,7 +401,7 @@ void offde(float **x_new, float **x_old, float **X, float **CR,
 
   // Generate ergodicity term
   allocate2D(&eps, MCMC->seq, MCMC->n);
-  nrandn(eps, MCMC->seq, MCMC->n);
+  nrandn(eps, MCMC->seq, MCMC->n, MCMC->rng);
   for (i = 0; i < MCMC->seq; i++) {
     for (j = 0; j < MCMC->n; j++) {
       eps[i][j] =
@@ -406,10 +409,10 @@ void offde(float **x_new, float **x_old, float **X, float **CR,
           eps[i][j]; // * (Input->ParRangeMax[j] - Input->ParRangeMin[j]);
       // Generate uniform random numbers for each chain to determine which
       // dimension to update
-      D[i][j] = UNIFORM_RAND;
+      D[i][j] = UNIFORM_RAND(MCMC->rng);
 
       // Ergodicity for each individual chain
-      noise_x[i][j] = MCMC->eps * (2 * UNIFORM_RAND - 1);
+      noise_x[i][j] = MCMC->eps * (2 * UNIFORM_RAND(MCMC->rng) - 1);
 
       // Initialize the delta update to zero
       delta_x[i][j] = 0;
@@ -430,7 +433,7 @@ void offde(float **x_new, float **x_old, float **X, float **CR,
     MEMORYCHECK(permarray,
                 "ERROR at offde: Out of Memory!! permarray not allocated.\n");
     for (i = 0; i < MCMC->seq; i++) {
-      randperm(&permarray, MCMC->seq - 1);
+      randperm(&permarray, MCMC->seq - 1, MCMC->rng);
       for (j = 0; j < MCMC->seq - 1; j++) {
         tt[j][i] = permarray[j] - 1;
       }
@@ -469,12 +472,12 @@ void offde(float **x_new, float **x_old, float **X, float **CR,
       // Update at least one dimension
       if (NrDim == 0) {
         pp_i = &p_i[0];
-        randperm(&pp_i, MCMC->n);
+        randperm(&pp_i, MCMC->n, MCMC->rng);
         NrDim = 1;
       }
 
       // Determine the associated JumpRate and compute the jump
-      rndnum = UNIFORM_RAND;
+      rndnum = UNIFORM_RAND(MCMC->rng);
       if (rndnum < 0.8) {
         // Lookup Table
         Jump_Rate = Table_JumpRate[NrDim - 1][DEversion[qq] - 1];
@@ -526,7 +529,7 @@ void offde(float **x_new, float **x_old, float **X, float **CR,
 
   // Do boundary handling -- what to do when points fall outside bound
   if (strcmp(BHandling, "Reflect") == 0) {
-    ReflectBounds(x_new, Input, MCMC->seq, MCMC->n);
+    ReflectBounds(x_new, Input, MCMC->seq, MCMC->n, MCMC->rng);
   }
 
   if (strcmp(BHandling, "Bound") == 0) {
@@ -545,7 +548,7 @@ void offde(float **x_new, float **x_old, float **X, float **CR,
 }
 
 void ReflectBounds(float **x_new, struct Model_Input *Input, int nmbOfIndivs,
-                   int Dim) {
+                   int Dim, unsigned short *rng) {
   // Checks the bounds of the parameters
   int i, j;
   // Now check whether points are within bond
@@ -561,15 +564,15 @@ void ReflectBounds(float **x_new, struct Model_Input *Input, int nmbOfIndivs,
 
       // Now double check if all elements are within bounds
       if (x_new[i][j] < Input->ParRangeMin[j]) {
-        x_new[i][j] =
-            Input->ParRangeMin[j] +
-            UNIFORM_RAND * (Input->ParRangeMax[j] - Input->ParRangeMin[j]);
+        x_new[i][j] = Input->ParRangeMin[j] +
+                      UNIFORM_RAND(rng) *
+                          (Input->ParRangeMax[j] - Input->ParRangeMin[j]);
       }
 
       if (x_new[i][j] > Input->ParRangeMax[j]) {
-        x_new[i][j] =
-            Input->ParRangeMin[j] +
-            UNIFORM_RAND * (Input->ParRangeMax[j] - Input->ParRangeMin[j]);
+        x_new[i][j] = Input->ParRangeMin[j] +
+                      UNIFORM_RAND(rng) *
+                          (Input->ParRangeMax[j] - Input->ParRangeMin[j]);
       }
     }
   }
@@ -638,7 +641,7 @@ void metrop(float **newgen, float *alpha, float *accept, float **x, float **p_x,
 
   // Generate random numbers
   for (i = 0; i < NrChains; i++) {
-    Z = UNIFORM_RAND;
+    Z = UNIFORM_RAND(pointerMCMC->rng);
     // printf("a %f %f %i\n", Z, alpha[i], i);
     if (Z < alpha[i]) // Find which alpha's are greater than Z
     {
@@ -9,8 +9,10 @@ void CalcCbWb(float *beta, float *pCb, float *pWb);
 void InitVar(struct DREAM_Parameters *pstPar, struct DREAM_Variables **ptRUN,
              struct DREAM_Output **pstOutput);
 void GenCR(struct DREAM_Parameters **ppPar, float ***pppCR, float ****ptCR);
-void multrnd(int **X, int n, float ***p, int ncols, int m);
-void LHSU(float ***s, int nvar, float *xmax, float *xmin, int nsample);
+void multrnd(int **X, int n, float ***p, int ncols, int m,
+             unsigned short *rng);
+void LHSU(float ***s, int nvar, float *xmax, float *xmin, int nsample,
+          unsigned short *rng);
 void InitSequences(float **X, float ***Sequences,
                    struct DREAM_Parameters *MCMCPar);
 void Gelman(float **R_Stat, int R_Stat_Index, float ***Sequences,
@@ -23,7 +25,7 @@ void offde(float **x_new, float **x_old, float **X, float **CR,
            const char *DR);
 void DEStrategy(int *DEversion, struct DREAM_Parameters *MCMCPar);
 void ReflectBounds(float **x_new, struct Model_Input *Input, int nmbOfIndivs,
-                   int Dim);
+                   int Dim, unsigned short *rng);
 void metrop(float **newgen, float *alpha, float *accept, float **x, float **p_x,
             float *log_p_x, float **x_old, float *p_old, float *log_p_old,
             struct Model_Input *pointerInput,
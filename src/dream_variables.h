@@ -19,6 +19,7 @@ struct DREAM_Parameters {
   char outlierTest[10];
   float Cb;
   float Wb;
+  unsigned short *rng; // erand48 state of the owning optimizer
 };
 struct DREAM_Variables {
   int Nelem;
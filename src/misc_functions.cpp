@@ -8,9 +8,9 @@
 #include <time.h>
 
 #ifdef WIN32
-#define UNIFORM_RAND (((float)rand()) / RAND_MAX)
+#define UNIFORM_RAND(rng) (((float)rand()) / RAND_MAX)
 #else
-#define UNIFORM_RAND (drand48())
+#define UNIFORM_RAND(rng) (erand48(rng))
 #endif
 
 static void siftDown(float **numbers, int sort_col, int nc, int root,
@@ -59,14 +59,14 @@ void deallocate2D(float ***array, int nrows) {
   *array = NULL;
 }
 
-void randperm(int **array, int n) {
+void randperm(int **array, int n, unsigned short *rng) {
   int i, j, rnum, key = 1;
   float nf = (float)(n);
   for (i = 0; i < n; i++) {
-    rnum = rintf(UNIFORM_RAND * nf);
+    rnum = rintf(UNIFORM_RAND(rng) * nf);
     if (i == 0) {
       while (rnum == 0) {
-        rnum = ceilf(UNIFORM_RAND * nf);
+        rnum = ceilf(UNIFORM_RAND(rng) * nf);
       }
     } else {
       key = 1;
@@ -76,7 +76,7 @@ void randperm(int **array, int n) {
       for (j = 0; j < i; j++) {
         if (rnum == (*array)[j] || rnum == 0) {
           key = key + 1;
-          rnum = ceilf(UNIFORM_RAND * nf);
+          rnum = ceilf(UNIFORM_RAND(rng) * nf);
         }
       }
     }
@@ -84,7 +84,7 @@ void randperm(int **array, int n) {
   }
 }
 
-void nrandn(float **pArray, int nrows, int ncols) {
+void nrandn(float **pArray, int nrows, int ncols, unsigned short *rng) {
   // Based on algorithm by Dr. Everett (Skip) Carter, Jr.
   // from http://www.taygeta.com/random/gaussian.html
 
@@ -93,8 +93,8 @@ void nrandn(float **pArray, int nrows, int ncols) {
   for (i = 0; i < nrows; i++) {
     for (j = 0; j < ncols; j++) {
       do {
-        x1 = 2.0 * UNIFORM_RAND - 1.0;
-        x2 = 2.0 * UNIFORM_RAND - 1.0;
+        x1 = 2.0 * UNIFORM_RAND(rng) - 1.0;
+        x2 = 2.0 * UNIFORM_RAND(rng) - 1.0;
         w = x1 * x1 + x2 * x2;
       } while (w >= 1.0);
       w = sqrt((-2.0 * log(w)) / w);
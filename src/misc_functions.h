@@ -5,9 +5,9 @@ enum MVOPS { MVOP_MEAN, MVOP_VAR, MVOP_STD, MVOP_MAX, MVOP_MIN };
 
 void allocate2D(float ***array, int nrows, int ncols);
 void deallocate2D(float ***array, int nrows);
-void nrandn(float **pArray, int nrows, int ncols);
+void nrandn(float **pArray, int nrows, int ncols, unsigned short *rng);
 float sumarray(float *array, int nrows, int ncols);
-void randperm(int **array, int n);
+void randperm(int **array, int n, unsigned short *rng);
 void reshape(float **oldarray, int m0, int n0, float ***newarray, int m, int n);
 float meanvar(float *arr, int no, MVOPS option);
 void transp(float **oldarray, int m0, int n0, float ***newarray,